@@ -0,0 +1,137 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ArchRegistry.h"
+#include "TrainingTaskGA.h"
+#include "TrainingTaskRES.h"
+#include "SweepArchs.h"
+
+//==================================================================
+// archsweep - trains networks of several architectures, one after the
+// other, and compares them
+// Usage: archsweep <ga|res> <generations> [architectures...]
+// The architectures are layers sizes (e.g. 10x12x12x3), from the ones
+// built in (NNL_SWEEP_ARCHS in CMakeLists.txt), all of them by default.
+// Training is the same as in lander04 (ga) and lander05 (res), headless.
+//==================================================================
+
+using SweepArchs = ArchRegistry<float, SWEEP_ARCHS>;
+
+// GA options (see lander04)
+static const size_t POPULATION_SIZE = 200;
+static const double MUTATION_RATE = 0.1;
+static const double MUTATION_STRENGTH = 0.3;
+// REINFORCE-ES options (see lander05)
+static const double SIGMA = 0.5;
+static const double ALPHA = 0.40;
+static const size_t NUM_PERTURBATIONS = 100;
+// Both
+static const uint32_t COARSE_SUBSTEPS_N = 4;
+static const size_t COARSE_PLATEAU_GENS_N = 15;
+static const uint32_t SEED = 1234;
+
+//==================================================================
+static std::unique_ptr<AnyTrainingTask<float>> makeTask(const ArchDesc& arch, bool isGA, size_t generationsN)
+{
+    SimRunOptions ro;
+    ro.EARLY_TERMINATION = true;
+
+    if (isGA)
+    {
+        return SweepArchs::MakeTask(arch, [&]<NetArch auto netArch>() {
+            return std::make_unique<TrainingTaskGA<float, netArch>>(
+                SimParams{}, generationsN, POPULATION_SIZE, MUTATION_RATE, MUTATION_STRENGTH, SEED, ro);
+        });
+    }
+
+    TrainingTaskRESParams par;
+    par.maxGenerations = generationsN;
+    par.sigma = SIGMA;
+    par.alpha = ALPHA;
+    par.numPerturbations = NUM_PERTURBATIONS;
+    par.seed = SEED;
+    return SweepArchs::MakeTask(arch, [&]<NetArch auto netArch>() {
+        return std::make_unique<TrainingTaskRES<float, netArch>>(par, SimParams{}, ro);
+    });
+}
+
+//==================================================================
+int main(int argc, char** argv)
+{
+    const auto printUsage = []() {
+        printf("Usage: archsweep <ga|res> <generations> [architectures...]\n");
+        printf("Built in architectures:");
+        for (const auto& arch : SweepArchs::GetArchs())
+            printf(" %s", ArchToString(arch).c_str());
+        printf("\n");
+    };
+
+    if (argc < 3 || (std::string(argv[1]) != "ga" && std::string(argv[1]) != "res") || atoi(argv[2]) <= 0)
+    {
+        printUsage();
+        return 1;
+    }
+    const bool isGA = std::string(argv[1]) == "ga";
+    const size_t generationsN = (size_t)atoi(argv[2]);
+
+    std::vector<ArchDesc> archs;
+    for (int i=3; i < argc; ++i)
+    {
+        ArchDesc arch;
+        if (!ParseArch(argv[i], arch))
+        {
+            printf("Invalid architecture %s\n", argv[i]);
+            printUsage();
+            return 1;
+        }
+        if (!SweepArchs::Has(arch))
+        {
+            SweepArchs::PrintNotBuiltIn(arch);
+            return 1;
+        }
+        archs.push_back(arch);
+    }
+    if (archs.empty())
+        archs = SweepArchs::GetArchs();
+
+    struct Result
+    {
+        ArchDesc arch;
+        size_t   paramsN = 0;
+        double   bestScore = 0;
+        double   seconds = 0;
+    };
+    std::vector<Result> results;
+
+    for (const auto& arch : archs)
+    {
+        auto pTask = makeTask(arch, isGA, generationsN);
+        pTask->SetCoarseFidelity(COARSE_SUBSTEPS_N, COARSE_PLATEAU_GENS_N);
+
+        const auto startTime = std::chrono::steady_clock::now();
+        while (!pTask->IsTrainingComplete())
+        {
+            pTask->RunIteration(true);
+            printf("\r%s: generation %zu/%zu, best score %.2f", ArchToString(arch).c_str(),
+                   pTask->GetCurrentGeneration(), generationsN, pTask->GetBestScore());
+            fflush(stdout);
+        }
+        printf("\n");
+
+        Result res;
+        res.arch = arch;
+        res.paramsN = pTask->GetBestNetwork()->GetTotalParameterCount();
+        res.bestScore = pTask->GetBestScore();
+        res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        results.push_back(res);
+    }
+
+    printf("\n%-20s %8s %12s %10s %12s\n", "Architecture", "Params", "Best score", "Time (s)", "ms/gen");
+    for (const auto& res : results)
+        printf("%-20s %8zu %12.2f %10.2f %12.2f\n", ArchToString(res.arch).c_str(), res.paramsN,
+               res.bestScore, res.seconds, 1000.0 * res.seconds / (double)generationsN);
+    return 0;
+}
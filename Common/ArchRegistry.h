@@ -0,0 +1,332 @@
+#ifndef ARCH_REGISTRY_H
+#define ARCH_REGISTRY_H
+
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "ScenarioBank.h"
+#include "SimpleNeuralNet.h"
+
+//==================================================================
+// Architecture registry
+// Networks and trainers take their architecture as a template argument,
+// so that all their sizes are known at compile time. An ArchRegistry
+// instantiates them for a list of architectures given at build time,
+// and picks one at runtime, from the layers sizes:
+// - Dispatch() calls a generic function with the matching compile-time
+//   architecture: all the code it calls stays static
+// - MakeNet() and MakeTask() give objects behind the AnyNeuralNet and
+//   AnyTrainingTask interfaces. These are thin: a virtual call runs a
+//   whole feed forward, or training iteration, in the instantiation for
+//   the architecture, so the hot loops are the same as without them.
+// Each architecture in the list adds a copy of the code it instantiates.
+//==================================================================
+
+// Architecture as a runtime value: the layers sizes, e.g. {10, 12, 12, 3}
+using ArchDesc = std::vector<int>;
+
+template<NetArch auto netArch>
+ArchDesc MakeArchDesc()
+{
+    ArchDesc arch(netArch.size());
+    for (size_t i=0; i < netArch.size(); ++i)
+        arch[i] = netArch[i];
+    return arch;
+}
+
+// As "10x12x12x3"
+inline std::string ArchToString(const ArchDesc& arch)
+{
+    std::string s;
+    for (size_t i=0; i < arch.size(); ++i)
+        s += (i ? "x" : "") + std::to_string(arch[i]);
+    return s;
+}
+
+// From "10x12x12x3", returns false if it's not an architecture
+inline bool ParseArch(const std::string& str, ArchDesc& out)
+{
+    ArchDesc arch;
+    size_t pos = 0;
+    while (pos <= str.size())
+    {
+        auto end = str.find('x', pos);
+        if (end == std::string::npos)
+            end = str.size();
+
+        int n = 0;
+        if (end == pos || end - pos > 6)
+            return false;
+        for (size_t i=pos; i < end; ++i)
+        {
+            if (str[i] < '0' || str[i] > '9')
+                return false;
+            n = n * 10 + (str[i] - '0');
+        }
+        if (n <= 0)
+            return false;
+        arch.push_back(n);
+        pos = end + 1;
+    }
+    if (arch.size() < 2)
+        return false;
+    out = std::move(arch);
+    return true;
+}
+
+//==================================================================
+// AnyNeuralNet - a SimpleNeuralNet of any architecture
+//==================================================================
+template<std::floating_point T>
+class AnyNeuralNet
+{
+public:
+    virtual ~AnyNeuralNet() = default;
+
+    virtual const ArchDesc& GetArch() const = 0;
+    virtual size_t GetTotalParameterCount() const = 0;
+    // Flat parameters (see SimpleNeuralNet)
+    virtual void CopyParametersTo(T* pFlatParams) const = 0;
+    virtual void SetParametersFrom(const T* pFlatParams) = 0;
+    virtual void InitializeRandomParameters(uint32_t seed) = 0;
+    // GetArch().front() inputs -> net -> GetArch().back() outputs
+    virtual void FeedForward(const T* pInputs, T* pOutputs) const = 0;
+};
+
+template<std::floating_point T, NetArch auto netArch>
+class AnyNeuralNetImpl final : public AnyNeuralNet<T>
+{
+public:
+    using NeuralNet = SimpleNeuralNet<T, netArch>;
+
+private:
+    NeuralNet mNet;
+
+public:
+    AnyNeuralNetImpl() = default;
+    explicit AnyNeuralNetImpl(const NeuralNet& net) : mNet(net) {}
+
+    const ArchDesc& GetArch() const override
+    {
+        static const ArchDesc arch = MakeArchDesc<netArch>();
+        return arch;
+    }
+    size_t GetTotalParameterCount() const override { return NeuralNet::CalcTotalParameters(); }
+    void CopyParametersTo(T* pFlatParams) const override { mNet.CopyParametersTo(pFlatParams); }
+    void SetParametersFrom(const T* pFlatParams) override { mNet.SetParametersFrom(pFlatParams); }
+    void InitializeRandomParameters(uint32_t seed) override { mNet.InitializeRandomParameters(seed); }
+
+    void FeedForward(const T* pInputs, T* pOutputs) const override
+    {
+        const typename NeuralNet::Inputs inputs = Eigen::Map<const typename NeuralNet::Inputs>(pInputs);
+        typename NeuralNet::Outputs outputs;
+        mNet.FeedForward(inputs, outputs);
+        Eigen::Map<typename NeuralNet::Outputs> outputsMap(pOutputs);
+        outputsMap = outputs;
+    }
+
+    // The network itself, for static code
+    NeuralNet& GetNet() { return mNet; }
+    const NeuralNet& GetNet() const { return mNet; }
+};
+
+//==================================================================
+// AnyTrainingTask - a trainer (TrainingTaskGA, TrainingTaskRES) of any
+// architecture
+//==================================================================
+template<std::floating_point T>
+class AnyTrainingTask
+{
+public:
+    virtual ~AnyTrainingTask() = default;
+
+    virtual const ArchDesc& GetArch() const = 0;
+    virtual void startTraining(bool useThread) = 0;
+    virtual void RunIteration(bool useThread) = 0;
+    virtual bool IsTrainingComplete() const = 0;
+    virtual size_t GetCurrentGeneration() const = 0;
+    virtual size_t GetMaxGenerations() const = 0;
+    virtual double GetBestScore() = 0;
+    // Copy of the best network: the best individual for GA, the
+    // central network for ES
+    virtual std::unique_ptr<AnyNeuralNet<T>> GetBestNetwork() = 0;
+
+    virtual bool SaveCheckpoint(const std::string& path) = 0;
+    virtual bool LoadCheckpoint(const std::string& path) = 0;
+    virtual void SetCheckpointFile(const std::string& path, size_t everyGensN) = 0;
+    virtual void SetCoarseFidelity(uint32_t subStepsN, size_t plateauGensN) = 0;
+    virtual void SetScenarioBank(std::shared_ptr<const ScenarioBank> scenarios) = 0;
+};
+
+template<typename TrainingTask>
+class AnyTrainingTaskImpl final : public AnyTrainingTask<typename TrainingTask::NeuralNet::Inputs::Scalar>
+{
+public:
+    using NeuralNet = typename TrainingTask::NeuralNet;
+    using T = typename NeuralNet::Inputs::Scalar;
+
+private:
+    std::unique_ptr<TrainingTask> mpTask; // Trainers can't be moved
+
+public:
+    explicit AnyTrainingTaskImpl(std::unique_ptr<TrainingTask> pTask) : mpTask(std::move(pTask)) {}
+
+    const ArchDesc& GetArch() const override
+    {
+        static const ArchDesc arch = MakeArchDesc<TrainingTask::NET_ARCH>();
+        return arch;
+    }
+    void startTraining(bool useThread) override { mpTask->startTraining(useThread); }
+    void RunIteration(bool useThread) override { mpTask->RunIteration(useThread); }
+    bool IsTrainingComplete() const override { return mpTask->IsTrainingComplete(); }
+    size_t GetCurrentGeneration() const override { return mpTask->GetCurrentGeneration(); }
+    size_t GetMaxGenerations() const override { return mpTask->GetMaxGenerations(); }
+    double GetBestScore() override { return mpTask->GetBestScore(); }
+
+    std::unique_ptr<AnyNeuralNet<T>> GetBestNetwork() override
+    {
+        using NetImpl = AnyNeuralNetImpl<T, TrainingTask::NET_ARCH>;
+        if constexpr (requires { mpTask->GetBestIndividualNetwork(); })
+            return std::make_unique<NetImpl>(mpTask->GetBestIndividualNetwork());
+        else
+            return std::make_unique<NetImpl>(mpTask->GetCentralNetwork());
+    }
+
+    bool SaveCheckpoint(const std::string& path) override { return mpTask->SaveCheckpoint(path); }
+    bool LoadCheckpoint(const std::string& path) override { return mpTask->LoadCheckpoint(path); }
+    void SetCheckpointFile(const std::string& path, size_t everyGensN) override { mpTask->SetCheckpointFile(path, everyGensN); }
+    void SetCoarseFidelity(uint32_t subStepsN, size_t plateauGensN) override { mpTask->SetCoarseFidelity(subStepsN, plateauGensN); }
+    void SetScenarioBank(std::shared_ptr<const ScenarioBank> scenarios) override { mpTask->SetScenarioBank(std::move(scenarios)); }
+
+    // The trainer itself, for static code
+    TrainingTask& GetTask() { return *mpTask; }
+};
+
+//==================================================================
+// ArchRegistry class - the architectures built in, for networks of T
+// e.g. ArchRegistry<float, std::array{10, 12, 3}, std::array{10, 16, 16, 3}>
+//==================================================================
+template<std::floating_point T, NetArch auto... netArchs>
+class ArchRegistry
+{
+    static_assert(sizeof...(netArchs) > 0, "At least one architecture");
+
+    template<NetArch auto netArch>
+    static bool isArch(const ArchDesc& arch)
+    {
+        if (arch.size() != netArch.size())
+            return false;
+        for (size_t i=0; i < arch.size(); ++i)
+            if (arch[i] != netArch[i])
+                return false;
+        return true;
+    }
+
+public:
+    // The first one of the list, e.g. a default
+    static constexpr auto FIRST_ARCH = std::get<0>(std::tuple{netArchs...});
+
+    static std::vector<ArchDesc> GetArchs() { return {MakeArchDesc<netArchs>()...}; }
+
+    static void PrintNotBuiltIn(const ArchDesc& arch)
+    {
+        printf("The architecture %s is not built in, the available ones are:", ArchToString(arch).c_str());
+        for (const auto& a : GetArchs())
+            printf(" %s", ArchToString(a).c_str());
+        printf("\n");
+    }
+
+    static bool Has(const ArchDesc& arch) { return (isArch<netArchs>(arch) || ...); }
+
+    // The built in architecture with the fewest parameters that can hold
+    // a network of architecture "minArch": the same inputs, outputs and
+    // depth, hidden layers at least as wide (e.g. for a pruned network,
+    // see NetPruning). Returns false if there's none
+    static bool FindFit(const ArchDesc& minArch, ArchDesc& out)
+    {
+        const auto calcParams = [](const ArchDesc& arch) {
+            size_t n = 0;
+            for (size_t i=1; i < arch.size(); ++i)
+                n += (size_t)(arch[i - 1] + 1) * arch[i];
+            return n;
+        };
+        const auto fits = [&](const ArchDesc& arch) {
+            if (arch.size() != minArch.size() || arch.front() != minArch.front() || arch.back() != minArch.back())
+                return false;
+            for (size_t i=1; i + 1 < arch.size(); ++i)
+                if (arch[i] < minArch[i])
+                    return false;
+            return true;
+        };
+
+        bool found = false;
+        for (const auto& arch : GetArchs())
+        {
+            if (fits(arch) && (!found || calcParams(arch) < calcParams(out)))
+            {
+                out = arch;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // Call "func.template operator()<netArch>()" for the architecture
+    // "arch", e.g. with a lambda: []<NetArch auto netArch>() { ... }
+    // Returns false if the architecture is not built in
+    static bool Dispatch(const ArchDesc& arch, auto&& func)
+    {
+        return ((isArch<netArchs>(arch) && (func.template operator()<netArchs>(), true)) || ...);
+    }
+
+    // A network with random parameters, nullptr if the architecture is
+    // not built in
+    static std::unique_ptr<AnyNeuralNet<T>> MakeNet(const ArchDesc& arch, uint32_t seed)
+    {
+        std::unique_ptr<AnyNeuralNet<T>> pNet;
+        const auto found = Dispatch(arch, [&]<NetArch auto netArch>() {
+            pNet = std::make_unique<AnyNeuralNetImpl<T, netArch>>();
+            pNet->InitializeRandomParameters(seed);
+        });
+        if (!found)
+            PrintNotBuiltIn(arch);
+        return pNet;
+    }
+
+    // A trainer, made by "makeTask" for the architecture, e.g.:
+    //   [&]<NetArch auto netArch>() { return std::make_unique<TrainingTaskGA<float, netArch>>(...); }
+    // nullptr if the architecture is not built in
+    static std::unique_ptr<AnyTrainingTask<T>> MakeTask(const ArchDesc& arch, auto&& makeTask)
+    {
+        std::unique_ptr<AnyTrainingTask<T>> pTask;
+        const auto found = Dispatch(arch, [&]<NetArch auto netArch>() {
+            auto pImpl = makeTask.template operator()<netArch>();
+            using TrainingTask = typename decltype(pImpl)::element_type;
+            pTask = std::make_unique<AnyTrainingTaskImpl<TrainingTask>>(std::move(pImpl));
+        });
+        if (!found)
+            PrintNotBuiltIn(arch);
+        return pTask;
+    }
+};
+
+//==================================================================
+// The architectures built in the landers, and in the tools that load
+// their networks (e.g. policydistill), for "inputsN" inputs: the
+// simulation state, and the raycast sensors if any (see SimRaySensors).
+// The first one is the landers' default
+//==================================================================
+template<int inputsN = SIM_BRAINSTATE_N>
+using LanderArchRegistry = ArchRegistry<float,
+    std::array<int, 4>{inputsN, (int)((double)SIM_BRAINSTATE_N*1.25), (int)((double)SIM_BRAINSTATE_N*1.25), SIM_BRAINACTION_N},
+    std::array<int, 3>{inputsN, 8, SIM_BRAINACTION_N},
+    std::array<int, 3>{inputsN, 16, SIM_BRAINACTION_N},
+    std::array<int, 4>{inputsN, 16, 16, SIM_BRAINACTION_N},
+    std::array<int, 4>{inputsN, 24, 24, SIM_BRAINACTION_N},
+    std::array<int, 5>{inputsN, 16, 16, 16, SIM_BRAINACTION_N}>;
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef BATCHEVALUATOR_H
+#define BATCHEVALUATOR_H
+
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+#include "Utils.h"
+
+//==================================================================
+// Result of the evaluation of one network on one variant
+struct BatchEvalResult
+{
+    double   score = 0.0;
+    uint32_t stepsN = 0; // Simulation steps taken, as a measure of the cost
+};
+
+//==================================================================
+// BatchEvaluator class - evaluates a batch of networks over a set of
+// simulation variants, in parallel.
+// The work is split in chunks of (networks range, variants range):
+// - with many networks, a chunk covers several networks and all the
+//   variants
+// - with few networks, a network's variants are split over several
+//   chunks, so that all the threads stay busy
+// Chunks are submitted longest-expected-first (LPT scheduling), so
+// that a long chunk doesn't end up alone at the tail of the batch.
+// The expected cost of a chunk comes from the estimated cost of its
+// networks (given by the caller) and of its variants (measured by
+// previous batches).
+// The partial scores of each chunk are then reduced to one mean score
+// per network, always in the same order, so the result doesn't depend
+// on how the chunks were scheduled.
+//==================================================================
+class BatchEvaluator
+{
+    ParallelTasks& mPllTasks;
+
+    // Number of chunks to aim for, per thread (some slack helps balance
+    // chunks that take longer than others)
+    static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+    struct Chunk
+    {
+        size_t orderStart = 0;   // Range of networks, in mOrder
+        size_t orderEnd = 0;
+        size_t variantStart = 0; // Range of variants
+        size_t variantEnd = 0;
+        size_t chunkIdx = 0;     // Index of the chunk within a network
+        double expectedCost = 0;
+    };
+    std::vector<Chunk>    mChunks;
+    std::vector<uint32_t> mOrder; // Networks, by decreasing expected cost
+
+    // Sum of scores and steps of each chunk, as [net][chunk]
+    std::vector<double>   mPartialScores;
+    std::vector<uint32_t> mPartialSteps;
+    // Sum of steps of each variant, as [networks range][variant]
+    std::vector<uint64_t> mPartialVariantSteps;
+
+    // Mean steps taken on each variant, measured by the last batch
+    std::vector<float>    mVariantCosts;
+
+public:
+    explicit BatchEvaluator(ParallelTasks& pllTasks)
+        : mPllTasks(pllTasks)
+    {}
+
+    //==================================================================
+    // Evaluate "netsN" networks over "variantsN" variants
+    // - "evalFn(netIdx, variantIdx)" returns the BatchEvalResult of one
+    //   network on one variant, and must be safe to call from multiple
+    //   threads
+    // - "pOutScores[netIdx]" receives the mean score of each network
+    // - "pNetCostsEst[netIdx]" is the optional expected cost of each
+    //   network (e.g. steps measured in a previous generation)
+    // - "pOutNetCosts[netIdx]" optionally receives the mean steps taken
+    //   by each network (can be the same array as pNetCostsEst)
+    //==================================================================
+    template<typename EvalFn>
+    void Evaluate(
+        size_t netsN,
+        size_t variantsN,
+        const EvalFn& evalFn,
+        double* pOutScores,
+        bool useThread = true,
+        const float* pNetCostsEst = nullptr,
+        float* pOutNetCosts = nullptr)
+    {
+        if (netsN == 0 || variantsN == 0)
+            return;
+
+        // Decide the chunk size, based on the available parallelism
+        const size_t targetChunksN = useThread ? mPllTasks.GetThreadsN() * CHUNKS_PER_THREAD : 1;
+
+        const size_t splitsPerNet = std::clamp<size_t>((targetChunksN + netsN - 1) / netsN, 1, variantsN);
+        const size_t variantsPerChunk = (variantsN + splitsPerNet - 1) / splitsPerNet;
+        const size_t chunksPerNet = (variantsN + variantsPerChunk - 1) / variantsPerChunk;
+        // When a network isn't split, group several of them in one chunk
+        const size_t netsPerChunk = chunksPerNet > 1 ? 1 : std::max<size_t>(1, netsN / targetChunksN);
+        const size_t netGroupsN = (netsN + netsPerChunk - 1) / netsPerChunk;
+
+        mPartialScores.resize(netsN * chunksPerNet);
+        mPartialSteps.resize(netsN * chunksPerNet);
+        mPartialVariantSteps.assign(netGroupsN * variantsN, 0);
+        if (mVariantCosts.size() != variantsN)
+            mVariantCosts.assign(variantsN, 1.0f);
+
+        // Order the networks by decreasing expected cost, so that the
+        // most expensive ones are grouped in the first chunks
+        // (ties keep their order, std::stable_sort would allocate)
+        mOrder.resize(netsN);
+        std::iota(mOrder.begin(), mOrder.end(), 0);
+        if (pNetCostsEst)
+        {
+            std::sort(mOrder.begin(), mOrder.end(), [&](uint32_t a, uint32_t b) {
+                if (pNetCostsEst[a] != pNetCostsEst[b])
+                    return pNetCostsEst[a] > pNetCostsEst[b];
+                return a < b;
+            });
+        }
+
+        // Build the chunks, with their expected cost
+        mChunks.clear();
+        for (size_t orderStart = 0; orderStart < netsN; orderStart += netsPerChunk)
+        {
+            Chunk chunk;
+            chunk.orderStart = orderStart;
+            chunk.orderEnd = std::min(orderStart + netsPerChunk, netsN);
+
+            double netsCost = 0;
+            for (size_t i = chunk.orderStart; i < chunk.orderEnd; ++i)
+                netsCost += pNetCostsEst ? (double)pNetCostsEst[mOrder[i]] : 1.0;
+
+            for (size_t chunkIdx = 0; chunkIdx < chunksPerNet; ++chunkIdx)
+            {
+                chunk.chunkIdx = chunkIdx;
+                chunk.variantStart = chunkIdx * variantsPerChunk;
+                chunk.variantEnd = std::min(chunk.variantStart + variantsPerChunk, variantsN);
+
+                double variantsCost = 0;
+                for (size_t v = chunk.variantStart; v < chunk.variantEnd; ++v)
+                    variantsCost += (double)mVariantCosts[v];
+
+                chunk.expectedCost = netsCost * variantsCost;
+                mChunks.push_back(chunk);
+            }
+        }
+
+        // Longest-expected-first (ties keep their order)
+        std::sort(mChunks.begin(), mChunks.end(), [](const Chunk& a, const Chunk& b) {
+            if (a.expectedCost != b.expectedCost)
+                return a.expectedCost > b.expectedCost;
+            if (a.orderStart != b.orderStart)
+                return a.orderStart < b.orderStart;
+            return a.chunkIdx < b.chunkIdx;
+        });
+
+        // Chunks are picked by the threads in order. Nothing here
+        // allocates, so that a steady-state batch never touches the heap.
+        const auto runChunk = [this, &evalFn, chunksPerNet, netsPerChunk, variantsN](size_t chunkOrderIdx)
+        {
+            const Chunk& chunk = mChunks[chunkOrderIdx];
+            uint64_t* pVariantSteps = &mPartialVariantSteps[(chunk.orderStart / netsPerChunk) * variantsN];
+            for (size_t i = chunk.orderStart; i < chunk.orderEnd; ++i)
+            {
+                const size_t netIdx = mOrder[i];
+                double sum = 0.0;
+                uint32_t stepsN = 0;
+                for (size_t variantIdx = chunk.variantStart; variantIdx < chunk.variantEnd; ++variantIdx)
+                {
+                    const BatchEvalResult res = evalFn(netIdx, variantIdx);
+                    sum += res.score;
+                    stepsN += res.stepsN;
+                    pVariantSteps[variantIdx] += res.stepsN;
+                }
+
+                mPartialScores[netIdx * chunksPerNet + chunk.chunkIdx] = sum;
+                mPartialSteps[netIdx * chunksPerNet + chunk.chunkIdx] = stepsN;
+            }
+        };
+        if (useThread)
+        {
+            mPllTasks.ForEach(mChunks.size(), runChunk);
+        }
+        else
+        {
+            for (size_t i = 0; i < mChunks.size(); ++i)
+                runChunk(i);
+        }
+
+        // Reduce the partial scores to the mean score of each network
+        for (size_t netIdx = 0; netIdx < netsN; ++netIdx)
+        {
+            double sum = 0.0;
+            uint32_t stepsN = 0;
+            for (size_t chunkIdx = 0; chunkIdx < chunksPerNet; ++chunkIdx)
+            {
+                sum += mPartialScores[netIdx * chunksPerNet + chunkIdx];
+                stepsN += mPartialSteps[netIdx * chunksPerNet + chunkIdx];
+            }
+
+            pOutScores[netIdx] = sum / (double)variantsN;
+            if (pOutNetCosts)
+                pOutNetCosts[netIdx] = (float)stepsN / (float)variantsN;
+        }
+
+        // Update the measured cost of each variant, for the next batches
+        for (size_t v = 0; v < variantsN; ++v)
+        {
+            uint64_t stepsN = 0;
+            for (size_t g = 0; g < netGroupsN; ++g)
+                stepsN += mPartialVariantSteps[g * variantsN + v];
+
+            mVariantCosts[v] = (float)((double)stepsN / (double)netsN);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include "MappedFile.h"
+#include "SimpleNeuralNet.h"
+
+//==================================================================
+// Checkpoint files
+// A checkpoint is a set of named sections of raw bytes: trained network
+// parameters, or the whole state of a trainer, to resume training
+// exactly where it stopped.
+// File layout:
+// - FileHeader
+// - a SectionEntry for each section (tag, offset, size)
+// - the sections data, each one at an offset multiple of DATA_ALIGN
+// Sections are stored as they are in memory, so a file can be mapped
+// and its sections used in place, with nothing to parse (see
+// CheckpointReader). Files are only meant to be read back by the same
+// build. FILE_VERSION is for the layout of the file and of the network
+// sections; a trainer versions its own state section (see
+// TrainingTaskGA::STATE_VERSION).
+//==================================================================
+namespace Checkpoint
+{
+    static constexpr uint32_t FILE_VERSION = 3; // 3: "net_act" required
+    static constexpr size_t   DATA_ALIGN = 64; // Sections can be used with SIMD loads
+    static constexpr size_t   TAG_SIZE = 16;
+
+    struct FileHeader
+    {
+        char     magic[8] {'N','N','L','C','K','P','T','\0'};
+        uint32_t version = FILE_VERSION;
+        uint32_t sectionsN = 0;
+        uint64_t fileSize = 0;
+    };
+
+    struct SectionEntry
+    {
+        char     tag[TAG_SIZE] {};
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    inline size_t AlignUp(size_t n) { return (n + DATA_ALIGN - 1) & ~(DATA_ALIGN - 1); }
+}
+
+//==================================================================
+// CheckpointWriter class - collects the sections, then writes them
+//==================================================================
+class CheckpointWriter
+{
+    struct Section
+    {
+        Checkpoint::SectionEntry entry;
+        const void*              pData = nullptr;
+    };
+    std::vector<Section>                mSections;
+    std::vector<std::vector<std::byte>> mOwnData; // For AllocSection
+
+public:
+    // Add a section, the data is referenced (not copied), so it must
+    // stay valid until SaveToFile
+    void AddSection(const char* pTag, const void* pData, size_t size)
+    {
+        assert(strlen(pTag) < Checkpoint::TAG_SIZE);
+        Section sec;
+        strncpy(sec.entry.tag, pTag, Checkpoint::TAG_SIZE - 1);
+        sec.entry.size = size;
+        sec.pData = pData;
+        mSections.push_back(sec);
+    }
+
+    template<typename T>
+    void AddArray(const char* pTag, const T* pData, size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Sections are stored as raw bytes");
+        AddSection(pTag, pData, count * sizeof(T));
+    }
+
+    template<typename T>
+    void AddValue(const char* pTag, const T& value) { AddArray(pTag, &value, 1); }
+
+    // Add a section owned by the writer, returns where to write its data
+    std::byte* AllocSection(const char* pTag, size_t size)
+    {
+        auto& data = mOwnData.emplace_back(size);
+        AddSection(pTag, data.data(), size);
+        return data.data();
+    }
+
+    //==================================================================
+    // Write the file, returns false on failure
+    // The data goes to a temporary file first, which then replaces the
+    // destination, so a crash while saving never leaves a broken file
+    bool SaveToFile(const std::string& path)
+    {
+        Checkpoint::FileHeader header;
+        header.sectionsN = (uint32_t)mSections.size();
+
+        // Sections offsets
+        auto offset = Checkpoint::AlignUp(sizeof(header) + mSections.size() * sizeof(Checkpoint::SectionEntry));
+        for (auto& sec : mSections)
+        {
+            sec.entry.offset = offset;
+            offset = Checkpoint::AlignUp(offset + (size_t)sec.entry.size);
+        }
+        header.fileSize = offset;
+
+        const auto tmpPath = path + ".tmp";
+        FILE* pFile = fopen(tmpPath.c_str(), "wb");
+        if (!pFile)
+        {
+            printf("Could not write the checkpoint file %s\n", tmpPath.c_str());
+            return false;
+        }
+
+        bool ok = fwrite(&header, sizeof(header), 1, pFile) == 1;
+        for (const auto& sec : mSections)
+            ok = ok && fwrite(&sec.entry, sizeof(sec.entry), 1, pFile) == 1;
+
+        // Data, padded to the next section
+        const char padding[Checkpoint::DATA_ALIGN] {};
+        auto pos = sizeof(header) + mSections.size() * sizeof(Checkpoint::SectionEntry);
+        for (const auto& sec : mSections)
+        {
+            ok = ok && fwrite(padding, 1, (size_t)sec.entry.offset - pos, pFile) == (size_t)sec.entry.offset - pos;
+            if (sec.entry.size)
+                ok = ok && fwrite(sec.pData, 1, (size_t)sec.entry.size, pFile) == (size_t)sec.entry.size;
+            pos = (size_t)(sec.entry.offset + sec.entry.size);
+        }
+        ok = ok && fwrite(padding, 1, (size_t)header.fileSize - pos, pFile) == (size_t)header.fileSize - pos;
+
+        ok = fclose(pFile) == 0 && ok;
+        if (ok)
+        {
+            std::remove(path.c_str()); // rename() doesn't replace files on Windows
+            ok = std::rename(tmpPath.c_str(), path.c_str()) == 0;
+        }
+        if (!ok)
+        {
+            printf("Could not write the checkpoint file %s\n", path.c_str());
+            std::remove(tmpPath.c_str());
+        }
+        return ok;
+    }
+};
+
+//==================================================================
+// CheckpointReader class - maps a checkpoint file
+// Sections are returned as pointers in the mapped file, valid for the
+// lifetime of the reader
+//==================================================================
+class CheckpointReader
+{
+    MappedFile mFile;
+    const Checkpoint::SectionEntry* mpEntries = nullptr;
+    size_t mSectionsN = 0;
+
+public:
+    // Map a file, returns false on failure
+    bool LoadFromFile(const std::string& path)
+    {
+        MappedFile file;
+        if (!file.Open(path) || file.GetSize() < sizeof(Checkpoint::FileHeader))
+        {
+            printf("Could not open the checkpoint file %s\n", path.c_str());
+            return false;
+        }
+
+        Checkpoint::FileHeader header;
+        std::memcpy(&header, file.GetData(), sizeof(header));
+
+        const Checkpoint::FileHeader expected;
+        auto isCompatible =
+            std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+            header.version == expected.version &&
+            header.fileSize == file.GetSize() &&
+            sizeof(header) + header.sectionsN * sizeof(Checkpoint::SectionEntry) <= file.GetSize();
+
+        const auto* pEntries = (const Checkpoint::SectionEntry*)(file.GetData() + sizeof(header));
+        for (size_t i=0; isCompatible && i < header.sectionsN; ++i)
+            isCompatible = pEntries[i].offset % Checkpoint::DATA_ALIGN == 0 &&
+                           pEntries[i].offset + pEntries[i].size <= header.fileSize;
+
+        if (!isCompatible)
+        {
+            printf("Incompatible checkpoint file %s\n", path.c_str());
+            return false;
+        }
+
+        mFile = std::move(file);
+        mpEntries = (const Checkpoint::SectionEntry*)(mFile.GetData() + sizeof(header));
+        mSectionsN = header.sectionsN;
+        return true;
+    }
+
+    // Get a section, or nullptr if it's missing or not of the given size
+    const void* FindSection(const char* pTag, size_t size) const
+    {
+        for (size_t i=0; i < mSectionsN; ++i)
+        {
+            const auto& entry = mpEntries[i];
+            if (strncmp(entry.tag, pTag, Checkpoint::TAG_SIZE) == 0)
+                return entry.size == size ? mFile.GetData() + entry.offset : nullptr;
+        }
+        return nullptr;
+    }
+
+    // Get a section of any size, or nullptr if it's missing
+    const void* FindSectionAnySize(const char* pTag, size_t& outSize) const
+    {
+        for (size_t i=0; i < mSectionsN; ++i)
+        {
+            const auto& entry = mpEntries[i];
+            if (strncmp(entry.tag, pTag, Checkpoint::TAG_SIZE) == 0)
+            {
+                outSize = (size_t)entry.size;
+                return mFile.GetData() + entry.offset;
+            }
+        }
+        return nullptr;
+    }
+
+    template<typename T>
+    const T* FindArray(const char* pTag, size_t count) const
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Sections are stored as raw bytes");
+        return (const T*)FindSection(pTag, count * sizeof(T));
+    }
+
+    // Copy a value, returns false if it's missing
+    template<typename T>
+    bool ReadValue(const char* pTag, T& out) const
+    {
+        const auto* p = FindArray<T>(pTag, 1);
+        if (p)
+            std::memcpy((void*)&out, p, sizeof(T));
+        return p != nullptr;
+    }
+};
+
+//==================================================================
+// Networks in checkpoints
+// A network is stored as three sections: "net_arch" (the size of its
+// parameters type, then its layers sizes), "net_params" (its flat
+// parameters, see SimpleNeuralNet) and "net_act" (the ID of each
+// layer's activation, see Activations.h). Trainers store their best
+// network the same way, so a viewer can load it from a training
+// checkpoint.
+//==================================================================
+namespace Checkpoint
+{
+    template<std::floating_point T, NetArch auto netArch>
+    auto MakeNetArchDesc()
+    {
+        std::array<uint32_t, netArch.size() + 1> desc {};
+        desc[0] = (uint32_t)sizeof(T);
+        for (size_t i=0; i < netArch.size(); ++i)
+            desc[i + 1] = (uint32_t)netArch[i];
+        return desc;
+    }
+
+    template<std::floating_point T, NetArch auto netArch, typename Acts>
+    void AddNetwork(CheckpointWriter& writer, const SimpleNeuralNet<T, netArch, Acts>& net)
+    {
+        using NeuralNet = SimpleNeuralNet<T, netArch, Acts>;
+        const auto desc = MakeNetArchDesc<T, netArch>();
+        std::memcpy(writer.AllocSection("net_arch", sizeof(desc)), desc.data(), sizeof(desc));
+        net.CopyParametersTo((T*)writer.AllocSection("net_params", NeuralNet::CalcTotalParameters() * sizeof(T)));
+        std::memcpy(writer.AllocSection("net_act", sizeof(NeuralNet::ACTIVATION_IDS)),
+                    NeuralNet::ACTIVATION_IDS.data(), sizeof(NeuralNet::ACTIVATION_IDS));
+    }
+
+    // Returns false if the network is missing, or has another architecture
+    // or other activations
+    template<std::floating_point T, NetArch auto netArch, typename Acts>
+    bool ReadNetwork(const CheckpointReader& reader, SimpleNeuralNet<T, netArch, Acts>& net)
+    {
+        using NeuralNet = SimpleNeuralNet<T, netArch, Acts>;
+        const auto desc = MakeNetArchDesc<T, netArch>();
+        const auto* pDesc = reader.FindArray<uint32_t>("net_arch", desc.size());
+        const auto* pParams = reader.FindArray<T>("net_params", NeuralNet::CalcTotalParameters());
+        if (!pDesc || !pParams || std::memcmp(pDesc, desc.data(), sizeof(desc)) != 0)
+            return false;
+
+        const auto& actIds = NeuralNet::ACTIVATION_IDS;
+        const auto* pActs = reader.FindArray<uint32_t>("net_act", actIds.size());
+        if (!pActs || std::memcmp(pActs, actIds.data(), sizeof(actIds)) != 0)
+            return false;
+
+        net.SetParametersFrom(pParams);
+        return true;
+    }
+
+    // Save a network alone, returns false on failure
+    template<std::floating_point T, NetArch auto netArch, typename Acts>
+    bool SaveNetworkToFile(const std::string& path, const SimpleNeuralNet<T, netArch, Acts>& net)
+    {
+        CheckpointWriter writer;
+        AddNetwork(writer, net);
+        return writer.SaveToFile(path);
+    }
+
+    // Load a network, from a network file or a training checkpoint
+    template<std::floating_point T, NetArch auto netArch, typename Acts>
+    bool LoadNetworkFromFile(const std::string& path, SimpleNeuralNet<T, netArch, Acts>& net)
+    {
+        CheckpointReader reader;
+        if (!reader.LoadFromFile(path))
+            return false;
+
+        if (!ReadNetwork(reader, net))
+        {
+            printf("No compatible network in the checkpoint file %s\n", path.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+
+#endif
@@ -74,8 +74,8 @@ inline void DrawUITrainingStatus(bool isTrainingComplete, int fsize)
 
 //==================================================================
 // Draws the neural network structure and connection weights.
-template<std::floating_point T, NetArch auto netArch>
-inline void DrawNeuralNetwork(const SimpleNeuralNet<T, netArch>& net)
+template<std::floating_point T, NetArch auto netArch, typename Acts>
+inline void DrawNeuralNetwork(const SimpleNeuralNet<T, netArch, Acts>& net)
 {
     //const float screenW = (float)GetScreenWidth();
     //const float screenH = (float)GetScreenHeight();
@@ -0,0 +1,51 @@
+#ifndef FIXED_BRAIN_H
+#define FIXED_BRAIN_H
+
+#include "Simulation.h"
+
+//==================================================================
+// This is a simple rule-based brain that operates based on
+// predeternined rules implemented the programmer based on
+// observation of the simulation.
+// It flies lander02, and it's the teacher of the networks cloned from
+// it (see CloneFixedBrain), to start the trainers from
+//==================================================================
+inline void GetFixedBrainActions(const Eigen::Vector<float, SIM_BRAINSTATE_N>& in_simState, Eigen::Vector<float, SIM_BRAINACTION_N>& out_actions)
+{
+    // Copy the simulation state variables to more readable names
+    const auto landerX  = in_simState[SIM_BRAINSTATE_LANDER_X];
+    const auto landerY  = in_simState[SIM_BRAINSTATE_LANDER_Y];
+    const auto landerVX = in_simState[SIM_BRAINSTATE_LANDER_VX];
+    const auto landerVY = in_simState[SIM_BRAINSTATE_LANDER_VY];
+    const auto padX     = in_simState[SIM_BRAINSTATE_PAD_X];
+    const auto padY     = in_simState[SIM_BRAINSTATE_PAD_Y];
+    const auto padWidth = in_simState[SIM_BRAINSTATE_PAD_WIDTH];
+
+    // No thrust, unless a rule below asks for it
+    out_actions.setZero();
+
+    // Try to keep the lander centered on the pad by applying lateral
+    // thrusts if the lander is too far from the center of the pad
+    const auto tolerance = padWidth / 4.0f;
+    const auto isLanderTooFarLeft = landerX > padX + tolerance;
+    const auto isLanderTooFarRight = landerX < padX - tolerance;
+    const auto isLanderMovingLeft = landerVX < -0.5f;
+    const auto isLanderMovingRight = landerVX > 0.5f;
+
+    if (isLanderTooFarLeft && !isLanderMovingLeft)
+        out_actions[SIM_BRAINACTION_LEFT] = 1.0f; // Apply LEFT thrust
+    else if (isLanderTooFarRight && !isLanderMovingRight)
+        out_actions[SIM_BRAINACTION_RIGHT] = 1.0f; // Apply RIGHT thrust
+
+    // Try to keep the lander from crashing by selectively applying
+    // vertical thrust when somewhat close to the pad and the lander
+    // is dropping too fast
+    const auto minEngageHeight = padWidth * 3; // OK to fall below this height
+
+    const auto isLanderDroppingTooFast = landerVY < -1.0f;
+    const auto isLanderTooCloseToPad = landerY < minEngageHeight - padY;
+    if (isLanderDroppingTooFast && isLanderTooCloseToPad)
+        out_actions[SIM_BRAINACTION_UP] = 1.0f; // Apply UP thrust
+}
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <utility>
+
+#if defined(_WIN32)
+// Avoid <windows.h> here, it clashes with raylib's names
+// (files are read in memory instead, see MappedFile::Open)
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+//==================================================================
+// MappedFile class - read-only view of a whole file
+// On POSIX systems the file is memory-mapped, so opening it costs
+// nothing until the data is touched, and the pages are shared between
+// processes. Elsewhere the file is read in memory.
+//==================================================================
+class MappedFile
+{
+    const std::byte* mpData = nullptr;
+    size_t           mSize = 0;
+#if defined(_WIN32)
+    std::vector<std::max_align_t> mBuffer;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Close();
+            std::swap(mpData, other.mpData);
+            std::swap(mSize, other.mSize);
+#if defined(_WIN32)
+            std::swap(mBuffer, other.mBuffer);
+#endif
+        }
+        return *this;
+    }
+
+    ~MappedFile() { Close(); }
+
+    // Open a file, returns false on failure
+    bool Open(const std::string& path)
+    {
+        Close();
+#if defined(_WIN32)
+        FILE* pFile = fopen(path.c_str(), "rb");
+        if (!pFile)
+            return false;
+        fseek(pFile, 0, SEEK_END);
+        const auto size = (size_t)ftell(pFile);
+        fseek(pFile, 0, SEEK_SET);
+        mBuffer.resize((size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t));
+        const auto readSize = fread(mBuffer.data(), 1, size, pFile);
+        fclose(pFile);
+        if (readSize != size)
+        {
+            mBuffer.clear();
+            return false;
+        }
+        mpData = (const std::byte*)mBuffer.data();
+        mSize = size;
+#else
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            close(fd);
+            return false;
+        }
+
+        void* pMap = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd); // The mapping stays valid after closing
+        if (pMap == MAP_FAILED)
+            return false;
+
+        mpData = (const std::byte*)pMap;
+        mSize = (size_t)st.st_size;
+#endif
+        return true;
+    }
+
+    void Close()
+    {
+#if defined(_WIN32)
+        mBuffer.clear();
+#else
+        if (mpData)
+            munmap((void*)mpData, mSize);
+#endif
+        mpData = nullptr;
+        mSize = 0;
+    }
+
+    const std::byte* GetData() const { return mpData; }
+    size_t GetSize() const { return mSize; }
+    bool IsOpen() const { return mpData != nullptr; }
+};
+
+#endif
@@ -0,0 +1,538 @@
+#ifndef NET_PRUNING_H
+#define NET_PRUNING_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <vector>
+#include "ArchRegistry.h"
+#include "SimpleNeuralNet.h"
+#include "TinyGemv.h"
+
+//==================================================================
+// Pruning of trained networks
+// Trained controllers are larger than they need to be, pruning removes
+// parameters while keeping what the network computes close, without a
+// retrain:
+// - PruneWeights(): magnitude pruning, zeroes the smallest weights of
+//   each layer (the biases stay). PruneWeightBlocks() is the same by
+//   blocks of weights, the ones SparseNeuralNet skips
+// - PruneNeurons(): structured pruning, removes whole hidden neurons:
+//   the ones whose outputs vary the least on calibration inputs, scaled
+//   by their outgoing weights. A removed neuron is replaced by its mean
+//   output, folded into the next layer's biases
+// - FoldConstantNeurons(): removes the neurons left with no incoming
+//   weights, exactly: their output is a constant, folded the same way
+// A removed neuron stays in place, with all its weights at zero. To run
+// faster, the network is then either:
+// - compacted by CompactNet() to a network of a smaller architecture:
+//   its hidden layers must be at least the live neurons (CalcLiveArch(),
+//   and ArchRegistry::FindFit() to pick a built in one). It's exact, up
+//   to the order of the sums, and the fastest
+// - or run by SparseNeuralNet, for the irregular zeros left by
+//   PruneWeights() and PruneWeightBlocks(): the layers sparse enough
+//   run block-sparse
+// All of these work on the flat parameters (see SimpleNeuralNet).
+//==================================================================
+namespace NetPruning
+{
+    // A layer in the flat parameters: an (O x I+1) column-major matrix,
+    // the bias in the last column
+    template<typename T>
+    struct LayerParams
+    {
+        T*  p = nullptr;
+        int I = 0;
+        int O = 0;
+
+        T& W(int r, int c) const { return p[(size_t)c * O + r]; }
+        T& B(int r) const { return p[(size_t)I * O + r]; }
+    };
+
+    template<NetArch auto netArch, typename T>
+    LayerParams<T> GetLayer(std::vector<T>& params, size_t l)
+    {
+        return { params.data() + SimpleNeuralNet<T, netArch>::CalcLayerOffset(l), netArch[l], netArch[l + 1] };
+    }
+
+    template<std::floating_point T, NetArch auto netArch, typename Acts>
+    std::vector<T> GetParams(const SimpleNeuralNet<T, netArch, Acts>& net)
+    {
+        std::vector<T> params(net.GetTotalParameterCount());
+        net.CopyParametersTo(params.data());
+        return params;
+    }
+
+    // The activation of layer "l" on "x", a scalar or an Eigen array
+    template<typename NeuralNet>
+    void Activate(size_t l, auto& x)
+    {
+        [&]<size_t... Ls>(std::index_sequence<Ls...>) {
+            (void)((l == Ls && (x = NeuralNet::template LayerActivation<Ls>::Apply(x), true)) || ...);
+        }(std::make_index_sequence<NeuralNet::LAYERS_N>{});
+    }
+
+    //==================================================================
+    // Hidden neuron "n" of layer "h" (1 to LAYERS_N - 1 in netArch) is
+    // row n of the parameters of layer h - 1, and takes column n of layer h
+    template<typename T>
+    bool IsNeuronLive(const LayerParams<T>& next, int n)
+    {
+        for (int r=0; r < next.O; ++r)
+            if (next.W(r, n) != T(0))
+                return true;
+        return false;
+    }
+
+    // Replace the neuron by a constant output "value"
+    template<typename T>
+    void RemoveNeuron(const LayerParams<T>& prev, const LayerParams<T>& next, int n, T value)
+    {
+        for (int r=0; r < next.O; ++r)
+        {
+            next.B(r) += next.W(r, n) * value;
+            next.W(r, n) = T(0);
+        }
+        for (int c=0; c < prev.I; ++c)
+            prev.W(n, c) = T(0);
+        prev.B(n) = T(0);
+    }
+
+    //==================================================================
+    // Live neurons of each layer: the hidden ones that feed the next
+    // layer, all of the inputs and outputs
+    template<std::floating_point T, NetArch auto netArch, typename Acts>
+    ArchDesc CalcLiveArch(const SimpleNeuralNet<T, netArch, Acts>& net)
+    {
+        using NeuralNet = SimpleNeuralNet<T, netArch, Acts>;
+        auto params = GetParams(net);
+        auto arch = MakeArchDesc<netArch>();
+        for (size_t h=1; h < NeuralNet::LAYERS_N; ++h)
+        {
+            const auto next = GetLayer<netArch>(params, h);
+            arch[h] = 0;
+            for (int n=0; n < netArch[h]; ++n)
+                arch[h] += IsNeuronLive(next, n);
+        }
+        return arch;
+    }
+
+    //==================================================================
+    // Rows of the blocks of weights of each layer for SparseNeuralNet:
+    // a SIMD register, as for TinyGemv's ColumnsKernel
+    template<std::floating_point T, NetArch auto netArch>
+    constexpr auto CalcBlockRows()
+    {
+        return []<size_t... Ls>(std::index_sequence<Ls...>) {
+            return std::array<int, sizeof...(Ls)>{ TinyGemv::CalcLanes<T, netArch[Ls + 1]>()... };
+        }(std::make_index_sequence<netArch.size() - 1>{});
+    }
+
+    // Zero the "fraction" blocks of weights (blockRows[l] rows of a
+    // column) of each layer with the smallest norm
+    template<std::floating_point T, NetArch auto netArch, typename Acts>
+    size_t PruneBlocks(SimpleNeuralNet<T, netArch, Acts>& net, double fraction, const auto& blockRows)
+    {
+        using NeuralNet = SimpleNeuralNet<T, netArch, Acts>;
+        auto params = GetParams(net);
+        size_t zerosN = 0;
+        struct Block
+        {
+            T   norm2;
+            int row;
+            int col;
+        };
+        std::vector<Block> blocks;
+        for (size_t l=0; l < NeuralNet::LAYERS_N; ++l)
+        {
+            const auto layer = GetLayer<netArch>(params, l);
+            const int R = blockRows[l];
+            blocks.clear();
+            for (int c=0; c < layer.I; ++c)
+            {
+                for (int r0=0; r0 < layer.O; r0 += R)
+                {
+                    T norm2 = 0;
+                    for (int r=r0; r < std::min(r0 + R, layer.O); ++r)
+                        norm2 += layer.W(r, c) * layer.W(r, c);
+                    blocks.push_back({norm2, r0, c});
+                }
+            }
+
+            const auto pruneN = (size_t)std::lround(std::clamp(fraction, 0.0, 1.0) * (double)blocks.size());
+            std::stable_sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) { return a.norm2 < b.norm2; });
+            for (size_t i=0; i < pruneN; ++i)
+            {
+                for (int r=blocks[i].row; r < std::min(blocks[i].row + R, layer.O); ++r)
+                {
+                    layer.W(r, blocks[i].col) = T(0);
+                    ++zerosN;
+                }
+            }
+        }
+        net.SetParametersFrom(params.data());
+        return zerosN;
+    }
+
+    // Zero the "fraction" smallest weights, by magnitude, of each layer
+    // (the biases stay). Returns the number of weights zeroed
+    template<std::floating_point T, NetArch auto netArch, typename Acts>
+    size_t PruneWeights(SimpleNeuralNet<T, netArch, Acts>& net, double fraction)
+    {
+        std::array<int, netArch.size() - 1> blockRows;
+        blockRows.fill(1);
+        return PruneBlocks(net, fraction, blockRows);
+    }
+
+    // The same, by whole blocks of SparseNeuralNet, the ones it skips
+    template<std::floating_point T, NetArch auto netArch, typename Acts>
+    size_t PruneWeightBlocks(SimpleNeuralNet<T, netArch, Acts>& net, double fraction)
+    {
+        return PruneBlocks(net, fraction, CalcBlockRows<T, netArch>());
+    }
+
+    //==================================================================
+    // Remove the hidden neurons with no incoming weights: their output is
+    // the activation of their bias, the same for any input
+    // Returns the number of neurons removed
+    template<std::floating_point T, NetArch auto netArch, typename Acts>
+    size_t FoldConstantNeurons(SimpleNeuralNet<T, netArch, Acts>& net)
+    {
+        using NeuralNet = SimpleNeuralNet<T, netArch, Acts>;
+        auto params = GetParams(net);
+        size_t removedN = 0;
+        // In order, removing a layer's neurons can leave some of the next
+        // layer's ones without inputs
+        for (size_t h=1; h < NeuralNet::LAYERS_N; ++h)
+        {
+            const auto prev = GetLayer<netArch>(params, h - 1);
+            const auto next = GetLayer<netArch>(params, h);
+            for (int n=0; n < netArch[h]; ++n)
+            {
+                if (!IsNeuronLive(next, n))
+                    continue;
+
+                bool hasInputs = false;
+                for (int c=0; c < prev.I && !hasInputs; ++c)
+                    hasInputs = prev.W(n, c) != T(0);
+                if (hasInputs)
+                    continue;
+
+                T value = prev.B(n);
+                Activate<NeuralNet>(h - 1, value);
+                RemoveNeuron(prev, next, n, value);
+                ++removedN;
+            }
+        }
+        net.SetParametersFrom(params.data());
+        return removedN;
+    }
+
+    //==================================================================
+    // Remove neurons of each hidden layer, keeping "1 - fraction" of its
+    // size (at least one)
+    // "pCalibInputs" are "calibN" inputs representative of the network's
+    // use (as for QuantizedNeuralNet). The neurons removed first are the
+    // ones with the smallest standard deviation of their output, times
+    // the norm of their outgoing weights: replacing the output by its
+    // mean changes the next layer's sums the least. Layers are pruned in
+    // order, each one seeing the changes to the previous ones.
+    // Without calibration inputs there's nothing to rank the neurons by,
+    // and none are removed.
+    // Returns the number of neurons removed
+    template<std::floating_point T, NetArch auto netArch, typename Acts>
+    size_t PruneNeurons(SimpleNeuralNet<T, netArch, Acts>& net,
+                        const typename SimpleNeuralNet<T, netArch, Acts>::Inputs* pCalibInputs, size_t calibN,
+                        double fraction)
+    {
+        using NeuralNet = SimpleNeuralNet<T, netArch, Acts>;
+        using MatrixX = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+        if (!calibN)
+            return 0;
+
+        auto params = GetParams(net);
+        size_t removedN = 0;
+
+        // Outputs of the layers for the calibration inputs, one column per input
+        MatrixX acts(netArch[0], (Eigen::Index)calibN);
+        for (size_t i=0; i < calibN; ++i)
+            acts.col((Eigen::Index)i) = pCalibInputs[i];
+
+        for (size_t h=1; h < NeuralNet::LAYERS_N; ++h)
+        {
+            const auto prev = GetLayer<netArch>(params, h - 1);
+            const auto next = GetLayer<netArch>(params, h);
+
+            const Eigen::Map<const MatrixX> prevParams(prev.p, prev.O, prev.I + 1);
+            Eigen::Array<T, Eigen::Dynamic, Eigen::Dynamic> sums =
+                ((prevParams.leftCols(prev.I) * acts).colwise() + prevParams.col(prev.I)).array();
+            Activate<NeuralNet>(h - 1, sums);
+            acts = sums.matrix();
+
+            std::vector<int> liveNeurons;
+            for (int n=0; n < netArch[h]; ++n)
+                if (IsNeuronLive(next, n))
+                    liveNeurons.push_back(n);
+
+            const auto keepN = std::max<size_t>(1, (size_t)std::lround((1.0 - std::clamp(fraction, 0.0, 1.0)) * netArch[h]));
+            if (liveNeurons.size() <= keepN)
+                continue;
+
+            std::vector<T> means(netArch[h], T(0));
+            std::vector<T> scores(netArch[h], T(0));
+            for (int n : liveNeurons)
+            {
+                const auto outs = acts.row(n).array();
+                means[n] = outs.mean();
+                const T var = (outs - means[n]).square().mean();
+                T outNorm2 = 0;
+                for (int r=0; r < next.O; ++r)
+                    outNorm2 += next.W(r, n) * next.W(r, n);
+                scores[n] = std::sqrt(var * outNorm2);
+            }
+            std::stable_sort(liveNeurons.begin(), liveNeurons.end(), [&](int a, int b) { return scores[a] < scores[b]; });
+
+            for (size_t i=0; i < liveNeurons.size() - keepN; ++i)
+            {
+                const int n = liveNeurons[i];
+                RemoveNeuron(prev, next, n, means[n]);
+                ++removedN;
+            }
+        }
+        net.SetParametersFrom(params.data());
+        return removedN;
+    }
+
+    //==================================================================
+    // Copy the live neurons of "src" to "dst", a network with the same
+    // inputs, outputs and depth, and hidden layers at least as wide as
+    // the live ones (see CalcLiveArch()), after folding the constant
+    // neurons. dst's extra neurons are left with no weights.
+    // Returns false if dst is too small
+    template<std::floating_point T, NetArch auto srcArch, NetArch auto dstArch, typename Acts>
+    bool CompactNet(const SimpleNeuralNet<T, srcArch, Acts>& src, SimpleNeuralNet<T, dstArch, Acts>& dst)
+    {
+        using DstNet = SimpleNeuralNet<T, dstArch, Acts>;
+
+        auto folded = src;
+        FoldConstantNeurons(folded);
+        const auto liveArch = CalcLiveArch(folded);
+
+        bool fits = srcArch.size() == dstArch.size();
+        for (size_t i=0; fits && i < srcArch.size(); ++i)
+        {
+            const bool isHidden = i > 0 && i + 1 < srcArch.size();
+            fits = isHidden ? dstArch[i] >= liveArch[i] : dstArch[i] == srcArch[i];
+        }
+        if (!fits)
+        {
+            printf("Can't compact a network of live architecture %s to %s\n",
+                   ArchToString(liveArch).c_str(), ArchToString(MakeArchDesc<dstArch>()).c_str());
+            return false;
+        }
+
+        auto srcParams = GetParams(folded);
+        // Source index of each neuron of dst's layers
+        std::array<std::vector<int>, srcArch.size()> srcNeurons;
+        for (size_t i=0; i < srcArch.size(); ++i)
+        {
+            const bool isHidden = i > 0 && i + 1 < srcArch.size();
+            for (int n=0; n < srcArch[i]; ++n)
+                if (!isHidden || IsNeuronLive(GetLayer<srcArch>(srcParams, i), n))
+                    srcNeurons[i].push_back(n);
+        }
+
+        std::vector<T> dstParams(DstNet::CalcTotalParameters(), T(0));
+        for (size_t l=0; l < DstNet::LAYERS_N; ++l)
+        {
+            const auto s = GetLayer<srcArch>(srcParams, l);
+            const auto d = GetLayer<dstArch>(dstParams, l);
+            for (size_t r=0; r < srcNeurons[l + 1].size(); ++r)
+            {
+                for (size_t c=0; c < srcNeurons[l].size(); ++c)
+                    d.W((int)r, (int)c) = s.W(srcNeurons[l + 1][r], srcNeurons[l][c]);
+                d.B((int)r) = s.B(srcNeurons[l + 1][r]);
+            }
+        }
+        dst.SetParametersFrom(dstParams.data());
+        return true;
+    }
+}
+
+//==================================================================
+// SparseNeuralNet class - inference of a pruned network
+// The weights of a layer are in blocks of a column of the layer, rows
+// in one SIMD register, as in TinyGemv's ColumnsKernel (see
+// NetPruning::CalcBlockRows()). Layers with at most MAX_SPARSE_DENSITY
+// of their blocks non zero run block-sparse: only those blocks, each one
+// a multiply-add of a register with an input. Others run dense, as in
+// SimpleNeuralNet.
+// At these sizes, the loop over the blocks costs more than the math, and
+// per weight sparse formats (CSR) are slower than the dense kernels
+// until very high sparsities (see FeedForward_benchmark). Blocks keep
+// the multiply-adds vectorized: zeros in them are computed, so the
+// weights are best pruned by blocks (NetPruning::PruneWeightBlocks()).
+//==================================================================
+template<std::floating_point T, NetArch auto netArch, typename Activations = Activation::Layers<Activation::ReLU>>
+class SparseNeuralNet
+{
+public:
+    using NeuralNet = SimpleNeuralNet<T, netArch, Activations>;
+    using Inputs = typename NeuralNet::Inputs;
+    using Outputs = typename NeuralNet::Outputs;
+    static constexpr size_t LAYERS_N = NeuralNet::LAYERS_N;
+
+    // Below it, the block-sparse kernel beats the dense one
+    static constexpr double MAX_SPARSE_DENSITY = 0.6;
+
+private:
+    static constexpr auto BLOCK_ROWS = NetPruning::CalcBlockRows<T, netArch>();
+
+    static constexpr int calcRowBlocks(size_t l) { return (netArch[l + 1] + BLOCK_ROWS[l] - 1) / BLOCK_ROWS[l]; }
+
+    // Offsets of the layers, in blocks and in row blocks
+    static constexpr auto BLOCK_OFFS = []() {
+        std::array<size_t, LAYERS_N + 1> offs {};
+        for (size_t l=0; l < LAYERS_N; ++l)
+            offs[l + 1] = offs[l] + (size_t)calcRowBlocks(l) * netArch[l];
+        return offs;
+    }();
+    static constexpr auto VALUE_OFFS = []() {
+        std::array<size_t, LAYERS_N + 1> offs {};
+        for (size_t l=0; l < LAYERS_N; ++l)
+            offs[l + 1] = offs[l] + (size_t)calcRowBlocks(l) * netArch[l] * BLOCK_ROWS[l];
+        return offs;
+    }();
+    static constexpr auto ROW_BLOCK_OFFS = []() {
+        std::array<size_t, LAYERS_N + 1> offs {};
+        for (size_t l=0; l < LAYERS_N; ++l)
+            offs[l + 1] = offs[l] + (size_t)calcRowBlocks(l) + 1;
+        return offs;
+    }();
+
+    // Dense parameters (the biases of the sparse layers too)
+    alignas(64) std::array<T, NeuralNet::CalcTotalParameters()> mParams {};
+    // Block k of layer l: BLOCK_ROWS[l] values at VALUE_OFFS[l] + k * BLOCK_ROWS[l],
+    // its input at mBlockCols[BLOCK_OFFS[l] + k]. The blocks of row block b
+    // are from mBlockStarts[ROW_BLOCK_OFFS[l] + b], to the next one
+    alignas(64) std::array<T, VALUE_OFFS[LAYERS_N]> mBlockValues {};
+    std::array<uint16_t, BLOCK_OFFS[LAYERS_N]>        mBlockCols {};
+    std::array<uint32_t, ROW_BLOCK_OFFS[LAYERS_N]>    mBlockStarts {};
+    std::array<bool, LAYERS_N>                        mIsSparse {};
+    size_t                                            mNonZerosN = 0;
+
+public:
+    SparseNeuralNet() = default;
+    explicit SparseNeuralNet(const NeuralNet& net) { Build(net); }
+
+    void Build(const NeuralNet& net)
+    {
+        static_assert(*std::max_element(netArch.begin(), netArch.end()) <= UINT16_MAX, "Blocks inputs are 16 bits");
+
+        std::vector<T> params(NeuralNet::CalcTotalParameters());
+        net.CopyParametersTo(params.data());
+        std::copy(params.begin(), params.end(), mParams.begin());
+
+        mBlockValues.fill(T(0));
+        mNonZerosN = 0;
+        for (size_t l=0; l < LAYERS_N; ++l)
+        {
+            const auto layer = NetPruning::GetLayer<netArch>(params, l);
+            const int R = BLOCK_ROWS[l];
+            size_t k = 0;
+            for (int b=0; b < calcRowBlocks(l); ++b)
+            {
+                mBlockStarts[ROW_BLOCK_OFFS[l] + b] = (uint32_t)k;
+                const int rowsN = std::min(R, layer.O - b * R);
+                for (int c=0; c < layer.I; ++c)
+                {
+                    int nonZerosN = 0;
+                    for (int r=0; r < rowsN; ++r)
+                        nonZerosN += layer.W(b * R + r, c) != T(0);
+                    if (!nonZerosN)
+                        continue;
+
+                    for (int r=0; r < rowsN; ++r)
+                        mBlockValues[VALUE_OFFS[l] + k * R + r] = layer.W(b * R + r, c);
+                    mBlockCols[BLOCK_OFFS[l] + k] = (uint16_t)c;
+                    mNonZerosN += nonZerosN;
+                    ++k;
+                }
+            }
+            mBlockStarts[ROW_BLOCK_OFFS[l] + calcRowBlocks(l)] = (uint32_t)k;
+            mIsSparse[l] = (double)k <= MAX_SPARSE_DENSITY * (double)(BLOCK_OFFS[l + 1] - BLOCK_OFFS[l]);
+        }
+    }
+
+    void FeedForward(const Inputs& inputs, Outputs& outputs) const
+    {
+        feedLayer<0>(inputs, outputs);
+    }
+
+    size_t GetNonZeroWeightsN() const { return mNonZerosN; }
+    bool IsLayerSparse(size_t l) const { return mIsSparse[l]; }
+
+private:
+    template<size_t L, int I>
+    void feedLayer(const Eigen::Vector<T, I>& inputs, Outputs& outputs) const
+    {
+        Eigen::Vector<T, netArch[L + 1]> layerOuts;
+        // Separate functions: GCC stops inlining Eigen's unrolled loops in
+        // a function with both
+        if (mIsSparse[L])
+            feedSparseLayer<L>(inputs, layerOuts);
+        else
+            feedDenseLayer<L>(inputs, layerOuts);
+
+        if constexpr (L + 1 == LAYERS_N)
+            outputs = layerOuts;
+        else
+            feedLayer<L + 1>(layerOuts, outputs);
+    }
+
+    template<size_t L>
+    static auto activate(const auto& x) { return NeuralNet::template LayerActivation<L>::Apply(x); }
+
+    template<size_t L, int I, int O>
+    void feedDenseLayer(const Eigen::Vector<T, I>& inputs, Eigen::Vector<T, O>& outputs) const
+    {
+        const T* pLayer = mParams.data() + NeuralNet::CalcLayerOffset(L);
+        TinyGemv::SelectKernel<T, I, O>::Run(pLayer, inputs.data(), outputs.data(),
+                                              [](const auto& x) { return activate<L>(x); });
+    }
+
+    template<size_t L, int I, int O>
+    TGV_FLATTEN void feedSparseLayer(const Eigen::Vector<T, I>& inputs, Eigen::Vector<T, O>& outputs) const
+    {
+        constexpr int R = BLOCK_ROWS[L];
+        constexpr int RB = calcRowBlocks(L);
+        using Block = Eigen::Array<T, R, 1>;
+        const T* pValues = mBlockValues.data() + VALUE_OFFS[L];
+        const uint16_t* pCols = mBlockCols.data() + BLOCK_OFFS[L];
+        const uint32_t* pStarts = mBlockStarts.data() + ROW_BLOCK_OFFS[L];
+
+        Eigen::Array<T, RB * R, 1> sums;
+        for (int b=0; b < RB; ++b)
+        {
+            // Two sums, to halve the dependency chains
+            Block s = Block::Zero();
+            Block t = Block::Zero();
+            uint32_t k = pStarts[b];
+            for (; k + 1 < pStarts[b + 1]; k += 2)
+            {
+                s += Eigen::Map<const Block>(pValues + k * R) * inputs[pCols[k]];
+                t += Eigen::Map<const Block>(pValues + (k + 1) * R) * inputs[pCols[k + 1]];
+            }
+            if (k < pStarts[b + 1])
+                s += Eigen::Map<const Block>(pValues + k * R) * inputs[pCols[k]];
+            sums.template segment<R>(b * R) = s + t;
+        }
+        const Eigen::Map<const Eigen::Array<T, O, 1>> bias(mParams.data() + NeuralNet::CalcLayerOffset(L) + I * O);
+        outputs = activate<L>(sums.template head<O>() + bias).matrix();
+    }
+};
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef PARAMSTORAGE_H
+#define PARAMSTORAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <concepts>
+
+#if defined(__F16C__)
+    #include <immintrin.h>
+#endif
+
+//==================================================================
+// 16 bit storage for network parameters
+// Trainers keep whole populations of flat parameters (see
+// SimpleNeuralNet), and evaluating them is bound by memory bandwidth
+// once they don't fit in the caches. Storing them in 16 bits halves
+// that, at the cost of precision:
+// - Float16: IEEE half, 11 bits of mantissa, range +/-65504
+// - BFloat16: the top half of a float, 8 bits of mantissa, the range
+//   of a float
+// Values are converted with round-to-nearest-even, and are only ever
+// computed with as float (see LoadParams).
+//==================================================================
+struct Float16
+{
+    uint16_t bits = 0;
+
+    static Float16 FromFloat(float x)
+    {
+        uint32_t u;
+        std::memcpy(&u, &x, sizeof(u));
+        const uint32_t sign = (u >> 16) & 0x8000;
+        u &= 0x7fffffff;
+
+        Float16 h;
+        if (u >= (127 + 16) << 23) // Overflow, inf and NaN
+        {
+            h.bits = (uint16_t)(sign | (u > (255u << 23) ? 0x7e00 : 0x7c00));
+        }
+        else
+        if (u < (127 - 14) << 23) // Subnormal or zero: let the FPU round
+        {
+            const uint32_t magicU = ((127 - 15) + (23 - 10) + 1) << 23;
+            float magic, f;
+            std::memcpy(&magic, &magicU, sizeof(magic));
+            std::memcpy(&f, &u, sizeof(f));
+            f += magic;
+            std::memcpy(&u, &f, sizeof(u));
+            h.bits = (uint16_t)(sign | (u - magicU));
+        }
+        else
+        {
+            // Rebias the exponent, round the mantissa to nearest even
+            const uint32_t mantOdd = (u >> 13) & 1;
+            u += ((uint32_t)(15 - 127) << 23) + 0xfff + mantOdd;
+            h.bits = (uint16_t)(sign | (u >> 13));
+        }
+        return h;
+    }
+
+    float ToFloat() const
+    {
+        constexpr uint32_t SHIFTED_EXP = 0x7c00u << 13;
+        uint32_t u = (uint32_t)(bits & 0x7fff) << 13;
+        const uint32_t exp = u & SHIFTED_EXP;
+        u += (uint32_t)(127 - 15) << 23;
+
+        float f;
+        if (exp == SHIFTED_EXP) // Inf and NaN
+        {
+            u += (uint32_t)(128 - 16) << 23;
+            std::memcpy(&f, &u, sizeof(f));
+        }
+        else
+        if (exp == 0) // Subnormal or zero: renormalize
+        {
+            const uint32_t magicU = 113u << 23;
+            float magic;
+            std::memcpy(&magic, &magicU, sizeof(magic));
+            u += 1u << 23;
+            std::memcpy(&f, &u, sizeof(f));
+            f -= magic;
+        }
+        else
+        {
+            std::memcpy(&f, &u, sizeof(f));
+        }
+        return (bits & 0x8000) ? -f : f;
+    }
+};
+
+struct BFloat16
+{
+    uint16_t bits = 0;
+
+    static BFloat16 FromFloat(float x)
+    {
+        uint32_t u;
+        std::memcpy(&u, &x, sizeof(u));
+        BFloat16 b;
+        if ((u & 0x7fffffff) > (255u << 23)) // NaN stays a (quiet) NaN
+            b.bits = (uint16_t)((u >> 16) | 0x40);
+        else
+            b.bits = (uint16_t)((u + 0x7fff + ((u >> 16) & 1)) >> 16);
+        return b;
+    }
+
+    float ToFloat() const
+    {
+        const uint32_t u = (uint32_t)bits << 16;
+        float f;
+        std::memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+};
+
+// Types to store the parameters of a network of type T
+template<typename S, typename T>
+concept ParamStorageFor = std::same_as<S, T> || std::same_as<S, Float16> || std::same_as<S, BFloat16>;
+
+// Identifies the storage type in files (bits, 0xbf16 for BFloat16)
+template<typename S>
+constexpr uint32_t GetParamStorageId()
+{
+    if constexpr (std::same_as<S, Float16>)
+        return 16;
+    else
+    if constexpr (std::same_as<S, BFloat16>)
+        return 0xbf16;
+    else
+        return (uint32_t)sizeof(S) * 8;
+}
+
+//==================================================================
+// Conversions
+//==================================================================
+template<std::floating_point T, typename S>
+inline T LoadParam(S s)
+{
+    if constexpr (std::floating_point<S>)
+        return (T)s;
+    else
+        return (T)s.ToFloat();
+}
+
+template<typename S, std::floating_point T>
+inline S StoreParam(T x)
+{
+    if constexpr (std::floating_point<S>)
+        return (S)x;
+    else
+        return S::FromFloat((float)x);
+}
+
+// Convert "n" stored parameters to T
+// This is the conversion on the evaluation path: it's done once per
+// rollout, to a buffer that stays in L1, and the network runs on that
+template<std::floating_point T, typename S>
+inline void LoadParams(const S* pSrc, T* pDst, size_t n)
+{
+    size_t i = 0;
+#if defined(__F16C__)
+    if constexpr (std::same_as<S, Float16> && std::same_as<T, float>)
+    {
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(pDst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(pSrc + i))));
+    }
+#endif
+    for (; i < n; ++i)
+        pDst[i] = LoadParam<T>(pSrc[i]);
+}
+
+template<typename S, std::floating_point T>
+inline void StoreParams(const T* pSrc, S* pDst, size_t n)
+{
+    for (size_t i=0; i < n; ++i)
+        pDst[i] = StoreParam<S>(pSrc[i]);
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef POLICY_SAMPLES_H
+#define POLICY_SAMPLES_H
+
+#include <cstdint>
+#include <vector>
+#include "ScenarioBank.h"
+#include "SimRollout.h"
+
+//==================================================================
+// Policies as the simulation sees them
+// A policy is anything that can drive a simulation: a callable
+// (state, actions), e.g. a lambda calling a network's FeedForward. The
+// simulation thresholds its outputs (> 0.5), so all that matters of a
+// policy is the set of actions it takes in a state: one of 8.
+// - CollectPolicySamples() records states met when running a policy,
+//   with the actions taken there by another one (or the same), to fit a
+//   policy to another one (see PolicyTree)
+// - MeasurePolicyAgreement() compares two policies, on the states met
+//   by the first one, and on the outcomes of their runs
+// Runs are SimRollouts on the scenarios of a bank, at full fidelity.
+//==================================================================
+using PolicyState = Eigen::Vector<float, SIM_BRAINSTATE_N>;
+using PolicyActions = Eigen::Vector<float, SIM_BRAINACTION_N>;
+
+// Bits of the actions taken (1 << SIM_BRAINACTION_*)
+inline uint8_t CalcActionBits(const PolicyActions& actions)
+{
+    uint8_t bits = 0;
+    for (int i=0; i < SIM_BRAINACTION_N; ++i)
+        bits |= actions[i] > 0.5f ? (uint8_t)(1 << i) : 0;
+    return bits;
+}
+
+struct PolicySample
+{
+    PolicyState state;
+    uint8_t     actions = 0; // Bits
+};
+
+//==================================================================
+// Run "runPolicy" on all the scenarios, and add each state it's queried
+// on to "samples", with the actions of "labelPolicy" in that state.
+// Labeling the states met by a student with the actions of its teacher
+// is how a student learns to recover from its own mistakes (DAgger).
+template<typename RunPolicy, typename LabelPolicy>
+void CollectPolicySamples(const SimRolloutContext& ctx, const ScenarioBank& scenarios,
+                          const RunPolicy& runPolicy, const LabelPolicy& labelPolicy,
+                          std::vector<PolicySample>& samples)
+{
+    for (size_t i=0; i < scenarios.GetSize(); ++i)
+    {
+        SimRollout sim(ctx, scenarios.GetScenario(i));
+        while (!sim.IsSimulationComplete() && !sim.IsTimeOut())
+        {
+            sim.AnimateSim([&](const PolicyState& state, PolicyActions& actions) {
+                PolicyActions labels;
+                labelPolicy(state, labels);
+                samples.push_back({state, CalcActionBits(labels)});
+                runPolicy(state, actions);
+            });
+        }
+    }
+}
+
+//==================================================================
+struct PolicyAgreement
+{
+    size_t statesN = 0;
+    double statesAgreeRate = 0; // Same actions, on the states met by A
+    double landedRateA = 0;
+    double landedRateB = 0;
+    double sameOutcomeRate = 0; // Both landed, crashed, or timed out
+    double meanScoreA = 0;
+    double meanScoreB = 0;
+};
+
+template<typename PolicyA, typename PolicyB>
+PolicyAgreement MeasurePolicyAgreement(const SimRolloutContext& ctx, const ScenarioBank& scenarios,
+                                       const PolicyA& policyA, const PolicyB& policyB)
+{
+    PolicyAgreement res;
+    size_t agreeN = 0;
+    size_t sameOutcomesN = 0;
+    for (size_t i=0; i < scenarios.GetSize(); ++i)
+    {
+        SimRollout simA(ctx, scenarios.GetScenario(i));
+        while (!simA.IsSimulationComplete() && !simA.IsTimeOut())
+        {
+            simA.AnimateSim([&](const PolicyState& state, PolicyActions& actions) {
+                PolicyActions actionsB;
+                policyA(state, actions);
+                policyB(state, actionsB);
+                agreeN += CalcActionBits(actions) == CalcActionBits(actionsB);
+                ++res.statesN;
+            });
+        }
+        SimRollout simB(ctx, scenarios.GetScenario(i));
+        while (!simB.IsSimulationComplete() && !simB.IsTimeOut())
+            simB.AnimateSim(policyB);
+
+        res.landedRateA += simA.IsLanded();
+        res.landedRateB += simB.IsLanded();
+        res.meanScoreA += simA.CalculateScore();
+        res.meanScoreB += simB.CalculateScore();
+        sameOutcomesN += simA.IsLanded() == simB.IsLanded() && simA.IsCrashed() == simB.IsCrashed();
+    }
+
+    const auto scenariosN = (double)std::max<size_t>(scenarios.GetSize(), 1);
+    res.statesAgreeRate = (double)agreeN / (double)std::max<size_t>(res.statesN, 1);
+    res.landedRateA /= scenariosN;
+    res.landedRateB /= scenariosN;
+    res.meanScoreA /= scenariosN;
+    res.meanScoreB /= scenariosN;
+    res.sameOutcomeRate = (double)sameOutcomesN / scenariosN;
+    return res;
+}
+
+#endif
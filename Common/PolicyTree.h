@@ -0,0 +1,353 @@
+#ifndef POLICY_TREE_H
+#define POLICY_TREE_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <queue>
+#include <string>
+#include <vector>
+#include "Checkpoint.h"
+#include "PolicySamples.h"
+
+//==================================================================
+// PolicyTree class - a policy as a decision tree
+// A trained network only ever takes one of 8 sets of actions, so its
+// policy can be distilled into a lookup structure: a tree of axis
+// aligned splits of the state, each leaf holding the actions to take.
+// The tree is fit to samples of the network's actions (see
+// CollectPolicySamples), and refines the state space only where the
+// network's decisions change: it's a multi-resolution grid, with cells
+// sized to the policy instead of to the state ranges.
+// A lookup is a few compares and loads, instead of a feed forward.
+// Besides the state, splits can test the position of the pad relative
+// to the lander, which the network gets as a difference of inputs, and
+// a tree could only approximate as a staircase.
+// Building:
+// - the features are binned at their quantiles (MAX_BINS_N bins), so
+//   finding the best split of a node is one pass over its samples
+// - the leaf with the best split (Gini impurity of the 8 action sets)
+//   is split next, until maxLeavesN leaves, or no split helps
+// - sibling leaves with the same actions are merged back
+// Nodes are stored in preorder, in 8 bytes: a node's left child is the
+// next one, and the right child is stored with the feature.
+//==================================================================
+struct PolicyTreeParams
+{
+    size_t maxLeavesN = 4096;
+    size_t minLeafSamplesN = 8; // Samples in a leaf, at least
+    int    maxDepth = 32;
+};
+
+class PolicyTree
+{
+public:
+    static constexpr int FEATURE_PAD_DX = SIM_BRAINSTATE_N; // Pad - lander
+    static constexpr int FEATURE_PAD_DY = SIM_BRAINSTATE_N + 1;
+    static constexpr int FEATURES_N = SIM_BRAINSTATE_N + 2;
+    static constexpr int ACTION_SETS_N = 1 << SIM_BRAINACTION_N;
+    static constexpr size_t MAX_BINS_N = 256;
+
+    using Inputs = PolicyState;
+    using Outputs = PolicyActions;
+
+private:
+    struct Node
+    {
+        float    threshold = 0; // Left if feature < threshold
+        uint32_t info = 0;      // Feature (low 8 bits), right child or actions
+    };
+    static_assert(sizeof(Node) == 8);
+    static constexpr uint32_t LEAF = 0xff;
+    static constexpr uint32_t MAX_NODES_N = 1u << 24;
+    static constexpr uint32_t FILE_VERSION = 1;
+
+    std::vector<Node> mNodes {{0, LEAF}}; // No actions
+
+    struct BuildNode
+    {
+        size_t  begin = 0; // Range of the node's samples
+        size_t  end = 0;
+        int     depth = 0;
+        uint8_t actions = 0;
+        // Best split, then the children once split
+        int     feature = -1;
+        int     cut = 0;
+        double  gain = 0;
+        int     left = -1;
+        int     right = -1;
+    };
+
+    static void calcFeatures(const float* pState, float* pFeats)
+    {
+        for (int i=0; i < SIM_BRAINSTATE_N; ++i)
+            pFeats[i] = pState[i];
+        pFeats[FEATURE_PAD_DX] = pState[SIM_BRAINSTATE_PAD_X] - pState[SIM_BRAINSTATE_LANDER_X];
+        pFeats[FEATURE_PAD_DY] = pState[SIM_BRAINSTATE_PAD_Y] - pState[SIM_BRAINSTATE_LANDER_Y];
+    }
+
+    // Bottom up: a split of two leaves with the same actions is a leaf
+    static void mergeSameLeaves(std::vector<BuildNode>& nodes, int i)
+    {
+        auto& node = nodes[i];
+        if (node.left < 0)
+            return;
+        mergeSameLeaves(nodes, node.left);
+        mergeSameLeaves(nodes, node.right);
+        const auto& l = nodes[node.left];
+        const auto& r = nodes[node.right];
+        if (l.left < 0 && r.left < 0 && l.actions == r.actions)
+        {
+            node.actions = l.actions;
+            node.left = node.right = -1;
+        }
+    }
+
+    void flatten(const std::vector<BuildNode>& nodes, const std::array<std::vector<float>, FEATURES_N>& cuts, int i)
+    {
+        const auto& node = nodes[i];
+        if (node.left < 0)
+        {
+            mNodes.push_back({0, LEAF | ((uint32_t)node.actions << 8)});
+            return;
+        }
+        const auto nodeIdx = mNodes.size();
+        mNodes.push_back({cuts[node.feature][node.cut], (uint32_t)node.feature});
+        flatten(nodes, cuts, node.left);
+        mNodes[nodeIdx].info |= (uint32_t)mNodes.size() << 8;
+        flatten(nodes, cuts, node.right);
+    }
+
+public:
+    PolicyTree() = default;
+
+    // Actions bits in a state (1 << SIM_BRAINACTION_*)
+    uint8_t GetActions(const float* pState) const
+    {
+        float feats[FEATURES_N];
+        calcFeatures(pState, feats);
+
+        const Node* pNodes = mNodes.data();
+        uint32_t i = 0;
+        while ((pNodes[i].info & 0xff) != LEAF)
+        {
+            const auto& node = pNodes[i];
+            i = feats[node.info & 0xff] < node.threshold ? i + 1 : node.info >> 8;
+        }
+        return (uint8_t)(pNodes[i].info >> 8);
+    }
+
+    // As a network: 1 for the actions to take, 0 for the others
+    void FeedForward(const Inputs& inputs, Outputs& outputs) const
+    {
+        const auto bits = GetActions(inputs.data());
+        for (int i=0; i < SIM_BRAINACTION_N; ++i)
+            outputs[i] = (bits >> i) & 1 ? 1.0f : 0.0f;
+    }
+
+    size_t GetNodesN() const { return mNodes.size(); }
+    size_t GetLeavesN() const { return (mNodes.size() + 1) / 2; }
+
+    int CalcDepth(uint32_t i = 0) const
+    {
+        const auto& node = mNodes[i];
+        if ((node.info & 0xff) == LEAF)
+            return 0;
+        return 1 + std::max(CalcDepth(i + 1), CalcDepth(node.info >> 8));
+    }
+
+    //==================================================================
+    void Build(const std::vector<PolicySample>& samples, const PolicyTreeParams& par = {})
+    {
+        mNodes.assign(1, {0, LEAF});
+        if (samples.empty())
+            return;
+
+        const size_t samplesN = samples.size();
+        std::vector<std::array<float, FEATURES_N>> feats(samplesN);
+        for (size_t i=0; i < samplesN; ++i)
+            calcFeatures(samples[i].state.data(), feats[i].data());
+
+        // Bins at the quantiles of each feature: bin b holds the values
+        // in [cuts[b-1], cuts[b])
+        std::array<std::vector<float>, FEATURES_N> cuts;
+        std::vector<uint8_t> bins(samplesN * FEATURES_N);
+        {
+            std::vector<float> vals(samplesN);
+            for (int f=0; f < FEATURES_N; ++f)
+            {
+                for (size_t i=0; i < samplesN; ++i)
+                    vals[i] = feats[i][f];
+                std::sort(vals.begin(), vals.end());
+                // Each cut is between two distinct values, at or after the
+                // quantile, so runs of the same value are never split
+                for (size_t b=1; b < MAX_BINS_N; ++b)
+                {
+                    const auto q = std::max<size_t>(b * samplesN / MAX_BINS_N, 1);
+                    const auto next = std::upper_bound(vals.begin(), vals.end(), vals[q - 1]) - vals.begin();
+                    if (next == (ptrdiff_t)samplesN)
+                        break;
+                    const auto cut = vals[next - 1] + 0.5f * (vals[next] - vals[next - 1]);
+                    if (cuts[f].empty() || cut > cuts[f].back())
+                        cuts[f].push_back(cut);
+                }
+                for (size_t i=0; i < samplesN; ++i)
+                {
+                    const auto it = std::upper_bound(cuts[f].begin(), cuts[f].end(), feats[i][f]);
+                    bins[i * FEATURES_N + f] = (uint8_t)(it - cuts[f].begin());
+                }
+            }
+        }
+
+        std::vector<BuildNode> nodes;
+        std::vector<uint32_t> order(samplesN);
+        for (size_t i=0; i < samplesN; ++i)
+            order[i] = (uint32_t)i;
+
+        const auto calcImpurity = [](const uint32_t* pCounts, uint32_t n) {
+            double sumSq = 0;
+            for (int c=0; c < ACTION_SETS_N; ++c)
+                sumSq += (double)pCounts[c] * pCounts[c];
+            return n ? (double)n - sumSq / n : 0.0;
+        };
+
+        // Majority actions, and the best split of a node
+        std::vector<std::array<uint32_t, ACTION_SETS_N>> hist(MAX_BINS_N);
+        const auto evalNode = [&](BuildNode& node) {
+            const auto n = (uint32_t)(node.end - node.begin);
+            std::array<uint32_t, ACTION_SETS_N> counts {};
+            for (size_t i=node.begin; i < node.end; ++i)
+                ++counts[samples[order[i]].actions];
+            node.actions = (uint8_t)(std::max_element(counts.begin(), counts.end()) - counts.begin());
+
+            const auto impurity = calcImpurity(counts.data(), n);
+            node.feature = -1;
+            node.gain = 0;
+            if (impurity <= 0 || n < 2 * par.minLeafSamplesN || node.depth >= par.maxDepth)
+                return;
+
+            for (int f=0; f < FEATURES_N; ++f)
+            {
+                const auto binsN = cuts[f].size() + 1;
+                if (binsN < 2)
+                    continue;
+                std::fill(hist.begin(), hist.begin() + binsN, std::array<uint32_t, ACTION_SETS_N>{});
+                for (size_t i=node.begin; i < node.end; ++i)
+                {
+                    const auto s = order[i];
+                    ++hist[bins[s * FEATURES_N + f]][samples[s].actions];
+                }
+
+                std::array<uint32_t, ACTION_SETS_N> left {};
+                std::array<uint32_t, ACTION_SETS_N> right = counts;
+                uint32_t leftN = 0;
+                for (size_t b=0; b + 1 < binsN; ++b)
+                {
+                    uint32_t binN = 0;
+                    for (int c=0; c < ACTION_SETS_N; ++c)
+                    {
+                        left[c] += hist[b][c];
+                        right[c] -= hist[b][c];
+                        binN += hist[b][c];
+                    }
+                    leftN += binN;
+                    if (binN == 0 || leftN < par.minLeafSamplesN || n - leftN < par.minLeafSamplesN)
+                        continue;
+
+                    const auto gain = impurity - calcImpurity(left.data(), leftN) - calcImpurity(right.data(), n - leftN);
+                    if (gain > node.gain + 1e-9)
+                    {
+                        node.gain = gain;
+                        node.feature = f;
+                        node.cut = (int)b;
+                    }
+                }
+            }
+        };
+
+        // Split the leaf with the best gain first
+        const auto cmpGain = [&](int a, int b) { return nodes[a].gain < nodes[b].gain; };
+        std::priority_queue<int, std::vector<int>, decltype(cmpGain)> leaves(cmpGain);
+        nodes.push_back({0, samplesN, 0});
+        evalNode(nodes[0]);
+        leaves.push(0);
+        size_t leavesN = 1;
+        const auto maxLeavesN = std::min<size_t>(std::max<size_t>(par.maxLeavesN, 1), MAX_NODES_N / 2);
+        while (leavesN < maxLeavesN && !leaves.empty())
+        {
+            const auto idx = leaves.top();
+            leaves.pop();
+            if (nodes[idx].feature < 0)
+                break; // The best one has no split
+
+            const auto node = nodes[idx];
+            const auto mid = std::partition(order.begin() + node.begin, order.begin() + node.end, [&](uint32_t s) {
+                return bins[s * FEATURES_N + node.feature] <= node.cut;
+            }) - order.begin();
+
+            nodes[idx].left = (int)nodes.size();
+            nodes.push_back({node.begin, (size_t)mid, node.depth + 1});
+            nodes[idx].right = (int)nodes.size();
+            nodes.push_back({(size_t)mid, node.end, node.depth + 1});
+            for (const auto child : {nodes[idx].left, nodes[idx].right})
+            {
+                evalNode(nodes[child]);
+                leaves.push(child);
+            }
+            ++leavesN;
+        }
+
+        // Merge the splits that don't change the actions, then flatten
+        mergeSameLeaves(nodes, 0);
+        mNodes.clear();
+        flatten(nodes, cuts, 0);
+    }
+
+    //==================================================================
+    bool SaveToFile(const std::string& path) const
+    {
+        const std::array<uint32_t, 3> desc {FILE_VERSION, (uint32_t)FEATURES_N, (uint32_t)mNodes.size()};
+        CheckpointWriter writer;
+        writer.AddArray("ptree_desc", desc.data(), desc.size());
+        writer.AddArray("ptree_nodes", mNodes.data(), mNodes.size());
+        return writer.SaveToFile(path);
+    }
+
+    // Returns false if the file is not a tree from this build, or is
+    // damaged: all the nodes are checked, so lookups can't go astray
+    bool LoadFromFile(const std::string& path)
+    {
+        CheckpointReader reader;
+        if (!reader.LoadFromFile(path))
+            return false;
+
+        const auto* pDesc = reader.FindArray<uint32_t>("ptree_desc", 3);
+        const auto* pNodes = pDesc ? reader.FindArray<Node>("ptree_nodes", pDesc[2]) : nullptr;
+        if (!pNodes || pDesc[0] != FILE_VERSION || pDesc[1] != FEATURES_N || pDesc[2] == 0 || pDesc[2] > MAX_NODES_N)
+        {
+            printf("No compatible policy tree in the file %s\n", path.c_str());
+            return false;
+        }
+
+        const uint32_t nodesN = pDesc[2];
+        for (uint32_t i=0; i < nodesN; ++i)
+        {
+            const auto feature = pNodes[i].info & 0xff;
+            const auto value = pNodes[i].info >> 8;
+            const auto isValid = feature == LEAF
+                ? value < (uint32_t)ACTION_SETS_N
+                : feature < (uint32_t)FEATURES_N && i + 1 < nodesN && value > i + 1 && value < nodesN;
+            if (!isValid)
+            {
+                printf("Invalid node %u in the policy tree file %s\n", i, path.c_str());
+                return false;
+            }
+        }
+        mNodes.assign(pNodes, pNodes + nodesN);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,309 @@
+#ifndef QUANTIZED_NEURAL_NET_H
+#define QUANTIZED_NEURAL_NET_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "SimpleNeuralNet.h"
+
+#if defined(__AVXVNNI__) || (defined(__AVX512VNNI__) && defined(__AVX512VL__))
+    #include <immintrin.h>
+    #define QNN_USE_VNNI 1
+#else
+    #define QNN_USE_VNNI 0
+#endif
+
+//==================================================================
+// QuantizedNeuralNet class - int8 inference of a trained SimpleNeuralNet
+// Post-training quantization:
+// - weights are int8, with one scale per row (output neuron)
+// - the activations flowing between layers are uint8, with one scale
+//   per neuron, from the ranges seen on calibration inputs (they are
+//   all positive after ReLU, so they get the whole 0..255 range)
+// - the network inputs can be negative, so they are offset by
+//   INPUT_ZERO (the offset is removed in the biases of the first layer)
+// - products accumulate in int32, starting from the bias (already in
+//   the accumulator's scale), then ReLU and the requantization to the
+//   next layer's inputs are a single clamp and multiply
+// - the last layer gives float outputs, as SimpleNeuralNet
+// The input scales are folded into the weights of each layer, so that
+// inputs of very different ranges (positions in pixels, 0/1 states)
+// all use the full 8 bits.
+//
+// Weights are laid out for an outer product: for each group of 4
+// inputs, the 4 weights of each row are together, and rows are padded
+// to blocks of 8. With AVX-VNNI, a group of inputs is broadcast and
+// multiplied with a block of rows in one instruction, accumulating in
+// the 8 int32 lanes of a register: no horizontal sums, no shuffles.
+// Without it, plain loops compute the same, bit for bit.
+// Weights take 4x less memory than in float (see GetModelSize() for
+// the whole model, with the padding and the scales).
+//==================================================================
+template<NetArch auto netArch>
+class QuantizedNeuralNet
+{
+public:
+    using FloatNet = SimpleNeuralNet<float, netArch>;
+    using Inputs = typename FloatNet::Inputs;
+    using Outputs = typename FloatNet::Outputs;
+
+private:
+    static constexpr size_t LAYERS_N = netArch.size() - 1;
+    static constexpr int    GROUP_N = 4;    // Inputs per multiply-accumulate
+    static constexpr int    BLOCK_N = 8;    // Rows per register
+    static constexpr int    QMAX_W = 127;   // Weights
+    static constexpr int    QMAX_ACT = 255; // Activations
+    static constexpr int    QMAX_IN = 127;  // Inputs, around INPUT_ZERO
+    static constexpr int    INPUT_ZERO = 128;
+
+    static constexpr int calcGroups(int n) { return (n + GROUP_N - 1) / GROUP_N; }
+    static constexpr int calcBlocks(int n) { return (n + BLOCK_N - 1) / BLOCK_N; }
+
+    // Offsets of each layer in the weights and in the per-row arrays
+    // (padded rows)
+    static constexpr auto W_OFFS = []() {
+        std::array<size_t, LAYERS_N + 1> offs {};
+        for (size_t l=0; l < LAYERS_N; ++l)
+            offs[l + 1] = offs[l] + (size_t)calcGroups(netArch[l]) * calcBlocks(netArch[l + 1]) * BLOCK_N * GROUP_N;
+        return offs;
+    }();
+    static constexpr auto ROW_OFFS = []() {
+        std::array<size_t, LAYERS_N + 1> offs {};
+        for (size_t l=0; l < LAYERS_N; ++l)
+            offs[l + 1] = offs[l] + (size_t)calcBlocks(netArch[l + 1]) * BLOCK_N;
+        return offs;
+    }();
+    // Activations buffers size (any layer, padded)
+    static constexpr int MAX_ACTS_N = []() {
+        int n = 0;
+        for (size_t l=0; l < netArch.size(); ++l)
+            n = std::max(n, calcBlocks(netArch[l]) * BLOCK_N);
+        return n;
+    }();
+
+    // Weights of layer l, group g, row r, input k of the group at
+    // W_OFFS[l] + (g * paddedRows + r) * GROUP_N + k
+    alignas(64) std::array<int8_t, W_OFFS[LAYERS_N]> mWeights {};
+    alignas(64) std::array<int32_t, ROW_OFFS[LAYERS_N]> mBiases {};
+    // Hidden layers: accumulator -> next layer's uint8 input
+    // Last layer: accumulator -> float output
+    alignas(64) std::array<float, ROW_OFFS[LAYERS_N]> mRowScales {};
+    std::array<float, netArch[0]> mInputScales {};
+
+public:
+    //==================================================================
+    // Quantize a network
+    // "pCalibInputs" are "calibN" inputs representative of its use (e.g.
+    // the states seen when running the float network on some scenarios),
+    // used to find the range of each input and neuron. Values beyond
+    // these ranges are clamped.
+    void Quantize(const FloatNet& net, const Inputs* pCalibInputs, size_t calibN)
+    {
+        std::vector<float> params(FloatNet::CalcTotalParameters());
+        net.CopyParametersTo(params.data());
+
+        // Ranges of the inputs of each layer (and of the outputs, unused)
+        std::array<std::vector<float>, LAYERS_N + 1> ranges;
+        for (size_t l=0; l <= LAYERS_N; ++l)
+            ranges[l].assign(netArch[l], 0.0f);
+
+        std::vector<float> acts;
+        std::vector<float> nextActs;
+        for (size_t i=0; i < calibN; ++i)
+        {
+            acts.assign(pCalibInputs[i].data(), pCalibInputs[i].data() + netArch[0]);
+            for (size_t l=0; l < LAYERS_N; ++l)
+            {
+                for (int c=0; c < netArch[l]; ++c)
+                    ranges[l][c] = std::max(ranges[l][c], std::abs(acts[c]));
+
+                calcFloatLayer(params.data(), l, acts, nextActs);
+                std::swap(acts, nextActs);
+            }
+        }
+
+        // Ranges never seen (always 0) get a neutral scale
+        for (auto& layerRanges : ranges)
+            for (auto& r : layerRanges)
+                r = r > 0.0f ? r : 1.0f;
+
+        for (int c=0; c < netArch[0]; ++c)
+            mInputScales[c] = (float)QMAX_IN / ranges[0][c];
+
+        mWeights.fill(0);
+        mBiases.fill(0);
+        mRowScales.fill(0.0f);
+        for (size_t l=0; l < LAYERS_N; ++l)
+        {
+            const int I = netArch[l];
+            const int O = netArch[l + 1];
+            const int paddedO = calcBlocks(O) * BLOCK_N;
+            const float* pLayer = params.data() + FloatNet::CalcLayerOffset(l);
+
+            const int inQMax = l == 0 ? QMAX_IN : QMAX_ACT;
+            const int inZero = l == 0 ? INPUT_ZERO : 0;
+            for (int r=0; r < O; ++r)
+            {
+                // Weights of the row, scaled to take quantized inputs
+                // (column-major (O x I+1) matrix, the bias is the last column)
+                float maxW = 0.0f;
+                for (int c=0; c < I; ++c)
+                    maxW = std::max(maxW, std::abs(pLayer[c * O + r] * ranges[l][c] / inQMax));
+
+                const float rowScale = maxW > 0.0f ? maxW / QMAX_W : 1.0f;
+                int32_t weightsSum = 0;
+                for (int c=0; c < I; ++c)
+                {
+                    const auto w = pLayer[c * O + r] * ranges[l][c] / inQMax;
+                    const auto wq = (int8_t)std::lround(w / rowScale);
+                    mWeights[W_OFFS[l] + ((size_t)(c / GROUP_N) * paddedO + r) * GROUP_N + c % GROUP_N] = wq;
+                    weightsSum += wq;
+                }
+
+                const double bias = std::round((double)pLayer[I * O + r] / rowScale) - (double)inZero * weightsSum;
+                mBiases[ROW_OFFS[l] + r] = (int32_t)std::clamp(bias, (double)INT32_MIN / 2, (double)INT32_MAX / 2);
+
+                const bool isLast = l + 1 == LAYERS_N;
+                mRowScales[ROW_OFFS[l] + r] = isLast ? rowScale : rowScale * QMAX_ACT / ranges[l + 1][r];
+            }
+        }
+    }
+
+    //==================================================================
+    // Feed forward, same interface as SimpleNeuralNet
+    void FeedForward(const Inputs& inputs, Outputs& outputs) const
+    {
+        alignas(64) uint8_t bufA[MAX_ACTS_N] {};
+        alignas(64) uint8_t bufB[MAX_ACTS_N] {};
+
+#if QNN_USE_VNNI
+        alignas(32) float scaledInputs[calcBlocks(netArch[0]) * BLOCK_N] {};
+        for (int c=0; c < netArch[0]; ++c)
+            scaledInputs[c] = inputs[c] * mInputScales[c];
+        for (int b=0; b < calcBlocks(netArch[0]); ++b)
+        {
+            const auto v = _mm256_max_ps(_mm256_load_ps(scaledInputs + b * BLOCK_N), _mm256_set1_ps((float)-QMAX_IN));
+            const auto q = _mm256_cvtps_epi32(_mm256_min_ps(v, _mm256_set1_ps((float)QMAX_IN)));
+            storeBytes(bufA + b * BLOCK_N, _mm256_add_epi32(q, _mm256_set1_epi32(INPUT_ZERO)));
+        }
+#else
+        for (int c=0; c < netArch[0]; ++c)
+        {
+            const auto q = std::min(std::max(inputs[c] * mInputScales[c], (float)-QMAX_IN), (float)QMAX_IN);
+            bufA[c] = (uint8_t)((float)INPUT_ZERO + std::nearbyint(q));
+        }
+#endif
+
+        // Padded inputs meet zero weights, padded rows give zeros
+        [&]<size_t... Ls>(std::index_sequence<Ls...>) {
+            ((feedLayer<Ls>(Ls % 2 ? bufB : bufA, Ls % 2 ? bufA : bufB, outputs)), ...);
+        }(std::make_index_sequence<LAYERS_N>{});
+    }
+
+    // Size of the model in bytes
+    static constexpr size_t GetModelSize()
+    {
+        return sizeof(QuantizedNeuralNet::mWeights) + sizeof(QuantizedNeuralNet::mBiases) +
+               sizeof(QuantizedNeuralNet::mRowScales) + sizeof(QuantizedNeuralNet::mInputScales);
+    }
+
+private:
+    template<size_t L>
+    void feedLayer(const uint8_t* pIn, uint8_t* pOut, Outputs& outputs) const
+    {
+        constexpr int GROUPS_N = calcGroups(netArch[L]);
+        constexpr int BLOCKS_N = calcBlocks(netArch[L + 1]);
+        constexpr int PADDED_O = BLOCKS_N * BLOCK_N;
+        const int8_t* pW = &mWeights[W_OFFS[L]];
+        const int32_t* pBias = &mBiases[ROW_OFFS[L]];
+        const float* pScale = &mRowScales[ROW_OFFS[L]];
+
+#if QNN_USE_VNNI
+        for (int b=0; b < BLOCKS_N; ++b)
+        {
+            auto acc = _mm256_load_si256((const __m256i*)(pBias + b * BLOCK_N));
+            for (int g=0; g < GROUPS_N; ++g)
+            {
+                int32_t group;
+                std::memcpy(&group, pIn + g * GROUP_N, sizeof(group));
+                const auto w = _mm256_load_si256((const __m256i*)(pW + (g * PADDED_O + b * BLOCK_N) * GROUP_N));
+    #if defined(__AVXVNNI__)
+                acc = _mm256_dpbusd_avx_epi32(acc, _mm256_set1_epi32(group), w);
+    #else
+                acc = _mm256_dpbusd_epi32(acc, _mm256_set1_epi32(group), w);
+    #endif
+            }
+            // ReLU, and scale
+            const auto v = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_max_epi32(acc, _mm256_setzero_si256())),
+                                         _mm256_load_ps(pScale + b * BLOCK_N));
+            if constexpr (L + 1 == LAYERS_N)
+            {
+                alignas(32) float values[BLOCK_N];
+                _mm256_store_ps(values, v);
+                for (int r=0; r < std::min(BLOCK_N, netArch[L + 1] - b * BLOCK_N); ++r)
+                    outputs[b * BLOCK_N + r] = values[r];
+            }
+            else
+            {
+                // Requantization (the scales include the next layer's ones)
+                storeBytes(pOut + b * BLOCK_N, _mm256_cvtps_epi32(_mm256_min_ps(v, _mm256_set1_ps((float)QMAX_ACT))));
+            }
+        }
+#else
+        alignas(64) int32_t accs[PADDED_O];
+        std::memcpy(accs, pBias, sizeof(accs));
+        for (int g=0; g < GROUPS_N; ++g)
+        {
+            const int8_t* pGroupW = pW + g * PADDED_O * GROUP_N;
+            for (int r=0; r < PADDED_O; ++r)
+                for (int k=0; k < GROUP_N; ++k)
+                    accs[r] += (int32_t)pGroupW[r * GROUP_N + k] * (int32_t)pIn[g * GROUP_N + k];
+        }
+
+        for (int r=0; r < PADDED_O; ++r)
+        {
+            // ReLU, and scale
+            const auto v = (float)std::max(accs[r], 0) * pScale[r];
+            if constexpr (L + 1 == LAYERS_N)
+            {
+                if (r < netArch[L + 1])
+                    outputs[r] = v;
+            }
+            else
+            {
+                // Requantization (the scales include the next layer's ones)
+                pOut[r] = (uint8_t)std::nearbyint(std::min(v, (float)QMAX_ACT));
+            }
+        }
+#endif
+    }
+
+#if QNN_USE_VNNI
+    // Store 8 values in [0, 255] as bytes
+    static void storeBytes(uint8_t* pDst, __m256i v)
+    {
+        const auto words = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        _mm_storel_epi64((__m128i*)pDst, _mm_packus_epi16(words, words));
+    }
+#endif
+
+    static void calcFloatLayer(const float* pParams, size_t l, const std::vector<float>& in, std::vector<float>& out)
+    {
+        const int I = netArch[l];
+        const int O = netArch[l + 1];
+        const float* pLayer = pParams + FloatNet::CalcLayerOffset(l);
+        out.assign(O, 0.0f);
+        for (int r=0; r < O; ++r)
+        {
+            float v = pLayer[I * O + r];
+            for (int c=0; c < I; ++c)
+                v += pLayer[c * O + r] * in[c];
+            out[r] = std::max(v, 0.0f);
+        }
+    }
+};
+
+#endif
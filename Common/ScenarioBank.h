@@ -0,0 +1,136 @@
+#ifndef SCENARIOBANK_H
+#define SCENARIOBANK_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include "Simulation.h"
+#include "MappedFile.h"
+
+//==================================================================
+// ScenarioBank class - a read-only set of pre-generated scenarios
+// Generating the pad and terrain of a simulation takes more than
+// stepping through a short episode, so trainers generate the layouts
+// of their variants once, and then start each rollout from one of them
+// (see Simulation's constructor from a SimScenario).
+// Once built, a bank is never modified, so it can be shared by all the
+// evaluation threads.
+// A bank can also be saved to a file, and mapped back from it, to use
+// libraries of many scenarios without generating them again.
+//==================================================================
+class ScenarioBank
+{
+    static_assert(std::is_trivially_copyable_v<SimScenario>, "Scenarios are stored as raw bytes");
+
+    // File layout: FileHeader, then the scenarios at DATA_OFFSET
+    struct FileHeader
+    {
+        char     magic[8] {'N','N','L','S','C','E','N','\0'};
+        uint32_t version = FILE_VERSION;
+        uint32_t scenarioSize = (uint32_t)sizeof(SimScenario);
+        uint32_t segmentsN = (uint32_t)Terrain::SEGMENTS_N;
+        uint32_t reserved = 0;
+        uint64_t scenariosN = 0;
+    };
+    static constexpr uint32_t FILE_VERSION = 2; // 2: terrain profile
+    static constexpr size_t   DATA_OFFSET = 64; // Keeps the scenarios aligned
+    static_assert(sizeof(FileHeader) <= DATA_OFFSET);
+
+    std::vector<SimScenario> mOwnScenarios; // When generated
+    MappedFile               mFile;         // When loaded from a file
+
+    const SimScenario* mpScenarios = nullptr;
+    size_t             mScenariosN = 0;
+
+public:
+    ScenarioBank() = default;
+
+    // Generate the scenarios for the seeds [startSeed, startSeed + count)
+    ScenarioBank(const SimParams& sp, uint64_t startSeed, size_t count)
+    {
+        mOwnScenarios.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto seed = startSeed + i;
+            mOwnScenarios[i] = Simulation(sp, seed).GetScenario();
+            mOwnScenarios[i].seed = seed;
+        }
+        mpScenarios = mOwnScenarios.data();
+        mScenariosN = mOwnScenarios.size();
+    }
+
+    ScenarioBank(const ScenarioBank&) = delete;
+    ScenarioBank& operator=(const ScenarioBank&) = delete;
+    ScenarioBank(ScenarioBank&&) = default;
+    ScenarioBank& operator=(ScenarioBank&&) = default;
+
+    size_t GetSize() const { return mScenariosN; }
+
+    const SimScenario& GetScenario(size_t idx) const
+    {
+        assert(idx < mScenariosN);
+        return mpScenarios[idx];
+    }
+
+    //==================================================================
+    // Save the scenarios to a file, returns false on failure
+    bool SaveToFile(const std::string& path) const
+    {
+        FILE* pFile = fopen(path.c_str(), "wb");
+        if (!pFile)
+            return false;
+
+        FileHeader header;
+        header.scenariosN = mScenariosN;
+
+        char headerBytes[DATA_OFFSET] {};
+        std::memcpy(headerBytes, &header, sizeof(header));
+
+        bool ok = fwrite(headerBytes, 1, DATA_OFFSET, pFile) == DATA_OFFSET;
+        if (ok && mScenariosN)
+            ok = fwrite(mpScenarios, sizeof(SimScenario), mScenariosN, pFile) == mScenariosN;
+
+        return fclose(pFile) == 0 && ok;
+    }
+
+    //==================================================================
+    // Map the scenarios of a file, returns false on failure
+    // The scenarios are used in place, nothing is parsed or copied
+    bool LoadFromFile(const std::string& path)
+    {
+        MappedFile file;
+        if (!file.Open(path) || file.GetSize() < DATA_OFFSET)
+        {
+            printf("Could not open the scenarios file %s\n", path.c_str());
+            return false;
+        }
+
+        FileHeader header;
+        std::memcpy(&header, file.GetData(), sizeof(header));
+
+        const FileHeader expected;
+        const auto isCompatible =
+            std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+            header.version == expected.version &&
+            header.scenarioSize == expected.scenarioSize &&
+            header.segmentsN == expected.segmentsN &&
+            file.GetSize() >= DATA_OFFSET + header.scenariosN * sizeof(SimScenario);
+
+        if (!isCompatible)
+        {
+            printf("Incompatible scenarios file %s\n", path.c_str());
+            return false;
+        }
+
+        mOwnScenarios.clear();
+        mFile = std::move(file);
+        mpScenarios = (const SimScenario*)(mFile.GetData() + DATA_OFFSET);
+        mScenariosN = (size_t)header.scenariosN;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,396 @@
+#ifndef SIMROLLOUT_H
+#define SIMROLLOUT_H
+
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+#include "Simulation.h"
+
+//==================================================================
+// SimRolloutContext - the constant data shared by all the rollouts of
+// a training session (parameters, options, and derived constants)
+//==================================================================
+class SimRolloutContext
+{
+public:
+    SimParams     sp;
+    SimRunOptions ro;
+
+    float    mMaxDistanceToPad = 0.0f;
+    float    mMaxAbsX = 0.0f; // Screen edges clamp of the lander
+    uint32_t mMaxStepsN = 0;  // Steps before Simulation::MAX_TIME_S
+
+    // Fidelity of the physics: number of 1/60 s steps taken by each
+    // rollout step (1 is full fidelity, see SimRolloutT::animCoarse)
+    uint32_t mSubStepsN = 1;
+
+    explicit SimRolloutContext(const SimParams& sp, const SimRunOptions& ro = {}, uint32_t subStepsN = 1)
+        : sp(sp)
+        , ro(ro)
+        , mSubStepsN(subStepsN)
+    {
+        mMaxDistanceToPad = calcMagnitude({sp.SCREEN_WIDTH, sp.SCREEN_HEIGHT});
+        mMaxAbsX = CalcMaxAbsX(sp);
+        mMaxStepsN = CalcMaxStepsN();
+
+        // Held in a byte by the rollouts, longer holds are clamped
+        this->ro.ACTION_REPEAT = std::clamp(ro.ACTION_REPEAT, 1, (int)UINT8_MAX);
+        assert(subStepsN >= 1);
+    }
+
+    bool IsFullFidelity() const { return mSubStepsN == 1; }
+
+    static constexpr float CalcMaxAbsX(const SimParams& sp) { return sp.SCREEN_WIDTH*0.6f; }
+
+    // Same count as the time accumulation of a Simulation
+    static constexpr uint32_t CalcMaxStepsN()
+    {
+        uint32_t n = 0;
+        for (double t = 0; t < Simulation::MAX_TIME_S; t += Simulation::mTimeStepS)
+            ++n;
+        return n;
+    }
+};
+
+// Marks a SimRolloutT that reads the parameters from its context at run-time
+struct SimParamsFromContext {};
+
+//==================================================================
+// SimRolloutT class - compact state of a headless simulation run
+// Equivalent to a Simulation (same steps, same score), but only the
+// lander's dynamic state is stored in the rollout. Parameters and the
+// layout are referenced from a shared context and scenario, which must
+// outlive the rollout.
+// A rollout fits a single cache line, so the working set of the
+// evaluation threads stays in L1.
+// FIXED_SP selects where the physics parameters come from:
+// - SimParamsFromContext (SimRollout): the context, at run-time
+// - a constexpr SimParams (SimRolloutFixed): the parameters are
+//   compile-time constants, folded in the step. The context must have
+//   the same parameters. It measures within noise of SimRollout (see
+//   Simulation_benchmark), the trainers use SimRollout.
+//==================================================================
+template<auto FIXED_SP = SimParamsFromContext{}>
+class alignas(64) SimRolloutT
+{
+    static constexpr bool IS_FIXED = std::is_same_v<std::remove_cv_t<decltype(FIXED_SP)>, SimParams>;
+    static_assert(IS_FIXED || std::is_same_v<std::remove_cv_t<decltype(FIXED_SP)>, SimParamsFromContext>);
+
+    const SimRolloutContext* mpCtx = nullptr;
+    const SimScenario*       mpScenario = nullptr;
+
+    // Hot state, touched at every step
+    Vector2  mPos {0.0f, 0.0f};
+    Vector2  mVel {0.0f, 0.0f};
+    float    mFuel = Lander::MAX_FUEL;
+    uint32_t mStepsN = 0;
+    uint8_t  mStateFlags = 0;
+    uint8_t  mControls = 0;         // Held brain controls
+    uint8_t  mActionHoldStepsN = 0; // Steps left before the next brain query
+
+    static constexpr uint8_t STATE_LANDED  = 1 << 0;
+    static constexpr uint8_t STATE_CRASHED = 1 << 1;
+
+    static constexpr uint8_t CONTROL_UP    = 1 << 0;
+    static constexpr uint8_t CONTROL_LEFT  = 1 << 1;
+    static constexpr uint8_t CONTROL_RIGHT = 1 << 2;
+
+    // Physics parameters, and their derived constants
+    const SimParams& getSP() const
+    {
+        if constexpr (IS_FIXED)
+            return FIXED_SP;
+        else
+            return mpCtx->sp;
+    }
+    float getMaxAbsX() const
+    {
+        if constexpr (IS_FIXED)
+        {
+            constexpr float MAX_ABS_X = SimRolloutContext::CalcMaxAbsX(FIXED_SP);
+            return MAX_ABS_X;
+        }
+        else
+            return mpCtx->mMaxAbsX;
+    }
+    uint32_t getMaxStepsN() const
+    {
+        if constexpr (IS_FIXED)
+        {
+            constexpr uint32_t MAX_STEPS_N = SimRolloutContext::CalcMaxStepsN();
+            return MAX_STEPS_N;
+        }
+        else
+            return mpCtx->mMaxStepsN;
+    }
+
+public:
+    SimRolloutT(const SimRolloutContext& ctx, const SimScenario& sc)
+        : mpCtx(&ctx)
+        , mpScenario(&sc)
+        , mPos{0.0f, ctx.sp.SCREEN_HEIGHT * 0.75f}
+    {
+        if constexpr (IS_FIXED)
+            assert(ctx.sp == FIXED_SP);
+    }
+
+    // Execute one simulation step (see Simulation::AnimateSim)
+    template<int RAYS_N = 0>
+    void AnimateSim(const GetBrainActionsFn<float, SIM_BRAINSTATE_N + RAYS_N, SIM_BRAINACTION_N> auto& getBrainActions)
+    {
+        if (IsSimulationComplete())
+            return;
+
+        ++mStepsN;
+
+        // Query the brain, or keep holding its last controls
+        const auto isBrainStep = mActionHoldStepsN == 0;
+        if (isBrainStep)
+        {
+            const SimScenario& sc = *mpScenario;
+
+            // 1. Convert the simulation variables to a eigen vector for the brain input
+            Eigen::Vector<float, SIM_BRAINSTATE_N + RAYS_N> simState;
+            simState[SIM_BRAINSTATE_LANDER_X] = mPos.x;
+            simState[SIM_BRAINSTATE_LANDER_Y] = mPos.y;
+            simState[SIM_BRAINSTATE_LANDER_VX] = mVel.x;
+            simState[SIM_BRAINSTATE_LANDER_VY] = mVel.y;
+            simState[SIM_BRAINSTATE_LANDER_FUEL] = mFuel;
+            simState[SIM_BRAINSTATE_LANDER_STATE_LANDED] = (mStateFlags & STATE_LANDED) != 0;
+            simState[SIM_BRAINSTATE_LANDER_STATE_CRASHED] = (mStateFlags & STATE_CRASHED) != 0;
+            simState[SIM_BRAINSTATE_PAD_X] = sc.padPos.x;
+            simState[SIM_BRAINSTATE_PAD_Y] = sc.padPos.y;
+            simState[SIM_BRAINSTATE_PAD_WIDTH] = sc.padWidth;
+            if constexpr (RAYS_N > 0)
+            {
+                SimRaySensors<RAYS_N>::CalcDistances(
+                    sc.terrainProfile, sc.padPos, sc.padWidth, mPos,
+                    simState.data() + SIM_BRAINSTATE_N);
+            }
+
+            // 2. Get the brain actions
+            Eigen::Vector<float, SIM_BRAINACTION_N> actions;
+            getBrainActions(simState, actions);
+
+            // 3. Convert them to controls
+            mControls = (actions[SIM_BRAINACTION_UP] > 0.5f ? CONTROL_UP : 0) |
+                        (actions[SIM_BRAINACTION_LEFT] > 0.5f ? CONTROL_LEFT : 0) |
+                        (actions[SIM_BRAINACTION_RIGHT] > 0.5f ? CONTROL_RIGHT : 0);
+
+            mActionHoldStepsN = (uint8_t)mpCtx->ro.ACTION_REPEAT;
+        }
+        mActionHoldStepsN -= 1;
+
+        if (mpCtx->IsFullFidelity())
+        {
+            animLander((mControls & CONTROL_UP) != 0,
+                       (mControls & CONTROL_LEFT) != 0,
+                       (mControls & CONTROL_RIGHT) != 0);
+            checkContacts();
+        }
+        else
+        {
+            animCoarse();
+        }
+
+        // See Simulation::checkEarlyTermination
+        if (mpCtx->ro.EARLY_TERMINATION && !IsSimulationComplete() && mFuel <= 0)
+            fastForwardBallistic();
+    }
+
+    double GetElapsedTimeS() const { return (double)mStepsN * Simulation::mTimeStepS; }
+
+    // Check if the run reached the time limit of a Simulation
+    bool IsTimeOut() const { return mStepsN >= getMaxStepsN(); }
+
+    bool IsSimulationComplete() const { return mStateFlags != 0; }
+    bool IsLanded() const { return (mStateFlags & STATE_LANDED) != 0; }
+    bool IsCrashed() const { return (mStateFlags & STATE_CRASHED) != 0; }
+
+    // Same as Simulation::CalculateScore
+    double CalculateScore() const
+    {
+        double score = 1;
+
+        const auto distanceToPad = calcMagnitude({mpScenario->padPos.x - mPos.x,
+                                                  mpScenario->padPos.y - mPos.y});
+
+        score += 1 * (1 - mapTo01(distanceToPad, 0.0f, mpCtx->mMaxDistanceToPad));
+        auto speed = calcMagnitude(mVel);
+        score += 0.1 * (1 - mapTo01(speed, 0.0f, getSP().LANDING_SAFE_SPEED));
+
+        if (mStateFlags & STATE_LANDED)
+            score += 1;
+
+        if (mStateFlags & STATE_CRASHED)
+            score -= 1;
+
+        return score * 10;
+    }
+
+private:
+    // Same as Lander::AnimLander
+    void animLander(bool upThrust, bool leftThrust, bool rightThrust)
+    {
+        const SimParams& sp = getSP();
+
+        mVel.y += sp.GRAVITY;
+
+        if (mFuel > 0)
+        {
+            if (upThrust)
+            {
+                mVel.y += sp.VERTICAL_THRUST_POWER;
+                mFuel -= 0.5f;
+            }
+            if (leftThrust)
+            {
+                mVel.x -= sp.LATERAL_THRUST_POWER;
+                mFuel -= 0.3f;
+            }
+            if (rightThrust)
+            {
+                mVel.x += sp.LATERAL_THRUST_POWER;
+                mFuel -= 0.3f;
+            }
+        }
+        if (mFuel < 0) mFuel = 0;
+
+        mPos.x += mVel.x;
+        mPos.y += mVel.y;
+
+        mPos.x = std::clamp(mPos.x, -getMaxAbsX(), getMaxAbsX());
+        if (mPos.y > sp.SCREEN_HEIGHT) mPos.y = sp.SCREEN_HEIGHT;
+    }
+
+    //==================================================================
+    // Coarse physics: one step covers mSubStepsN physics steps
+    // The controls are held over the sub-steps, so the position after
+    // n of them has a closed form:
+    //  v(n) = v + n*a
+    //  p(n) = p + n*v + a*n*(n+1)/2
+    // Contacts are checked at every sub-step, so the lander can't go
+    // through the pad or the ground, and stops at the sub-step that
+    // touched them.
+    // Approximations, compared to full fidelity: the fuel running out
+    // and the screen clamps are only applied at the end of the step.
+    void animCoarse()
+    {
+        const SimParams& sp = getSP();
+
+        // Acceleration and fuel use of each sub-step
+        float ax = 0.0f;
+        float ay = sp.GRAVITY;
+        float fuelUse = 0.0f;
+        if (mFuel > 0)
+        {
+            if (mControls & CONTROL_UP)
+            {
+                ay += sp.VERTICAL_THRUST_POWER;
+                fuelUse += 0.5f;
+            }
+            if (mControls & CONTROL_LEFT)
+            {
+                ax -= sp.LATERAL_THRUST_POWER;
+                fuelUse += 0.3f;
+            }
+            if (mControls & CONTROL_RIGHT)
+            {
+                ax += sp.LATERAL_THRUST_POWER;
+                fuelUse += 0.3f;
+            }
+        }
+
+        // Sub-stepped contact check, with the same rules as checkContacts()
+        const auto p0 = mPos;
+        const auto v0 = mVel;
+        const auto subStepsN = std::min(mpCtx->mSubStepsN, getMaxStepsN() - mStepsN + 1);
+        uint32_t n = 1;
+        for (; n <= subStepsN; ++n)
+        {
+            const auto k = (float)(n * (n + 1) / 2);
+            mPos.x = p0.x + (float)n * v0.x + k * ax;
+            mPos.y = p0.y + (float)n * v0.y + k * ay;
+            if (isOnPad() || isOnTerrain())
+                break;
+        }
+        n = std::min(n, subStepsN);
+
+        mVel.x = v0.x + (float)n * ax;
+        mVel.y = v0.y + (float)n * ay;
+        mFuel = std::max(0.0f, mFuel - (float)n * fuelUse);
+
+        mPos.x = std::clamp(mPos.x, -getMaxAbsX(), getMaxAbsX());
+        if (mPos.y > sp.SCREEN_HEIGHT) mPos.y = sp.SCREEN_HEIGHT;
+
+        mStepsN += n - 1; // The first one is counted by AnimateSim
+
+        checkContacts();
+    }
+
+    bool isOnPad() const
+    {
+        const SimScenario& sc = *mpScenario;
+        return mPos.y <= sc.padPos.y &&
+               mPos.x >= sc.padPos.x - sc.padWidth/2 &&
+               mPos.x <= sc.padPos.x + sc.padWidth/2;
+    }
+
+    bool isOnTerrain() const
+    {
+        return mPos.y <= mpScenario->terrainProfile.GetHeightAt(mPos.x);
+    }
+
+    // Same as LandingPad::CheckPadLanding, then Terrain::CheckTerrainCollision
+    void checkContacts()
+    {
+        // Above the pad and the highest point of the terrain, nothing to
+        // touch: skips the terrain lookup for most of the flight
+        const SimScenario& sc = *mpScenario;
+        if (mPos.y > std::max(sc.padPos.y, sc.terrainProfile.mMaxHeight))
+            return;
+
+        if (isOnPad())
+        {
+            const auto speed = (float)sqrt(mVel.x*mVel.x + mVel.y*mVel.y);
+            mStateFlags |= speed <= getSP().LANDING_SAFE_SPEED ? STATE_LANDED : STATE_CRASHED;
+            return;
+        }
+
+        if (isOnTerrain())
+            mStateFlags |= STATE_CRASHED;
+    }
+
+    // Same as Simulation::checkEarlyTermination, for the out of fuel case
+    void fastForwardBallistic()
+    {
+        const SimScenario& sc = *mpScenario;
+        const auto contactY = std::max(sc.padPos.y, sc.terrainProfile.mMaxHeight);
+        const auto isContact = fallBallistic(getSP(), contactY, mPos, mVel, [&]() {
+            if (IsTimeOut())
+                return false;
+            ++mStepsN;
+            return true;
+        });
+        if (isContact)
+            checkContacts();
+
+        // Finish with physics only
+        while (!IsSimulationComplete() && !IsTimeOut())
+        {
+            ++mStepsN;
+            animLander(false, false, false);
+            checkContacts();
+        }
+    }
+};
+
+using SimRollout = SimRolloutT<>;
+
+template<SimParams SP>
+using SimRolloutFixed = SimRolloutT<SP>;
+
+static_assert(sizeof(SimRollout) == 64, "A rollout should fit a single cache line");
+static_assert(sizeof(SimRolloutFixed<SimParams{}>) == 64, "A rollout should fit a single cache line");
+
+#endif
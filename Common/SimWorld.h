@@ -0,0 +1,333 @@
+#ifndef SIMWORLD_H
+#define SIMWORLD_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "Simulation.h"
+#include "SpatialHashGrid.h"
+
+//==================================================================
+// SimWorld class - many landers flying at the same time over the same
+// terrain, with several landing pads
+// Each lander follows the same physics as in a Simulation, and sees the
+// same kind of state, with the nearest free pad as its target. On top
+// of that, landers interact:
+// - a pad holds only one landed lander, landing on an occupied pad is
+//   a crash (the lander with the lowest index gets a pad when more of
+//   them land on it in the same step)
+// - landers that touch each other crash (landed ones included)
+// Contacts between landers go through a spatial hash grid, so a step
+// stays O(N) in the number of landers.
+// The layout is built once, for the whole population.
+//==================================================================
+class SimWorld
+{
+public:
+    SimParams sp;
+
+    // Landers are circles of this radius, for the contacts between them
+    static constexpr float LANDER_RADIUS = 15.0f;
+
+    std::vector<Lander>     mLanders;
+    std::vector<LandingPad> mLandingPads;
+    std::vector<int32_t>    mPadOccupants; // Lander landed on each pad, or -1
+    Terrain                 mTerrain;
+
+    double mElapsedTimeS = 0;
+    float  mMaxDistanceToPad = 0.0f;
+
+private:
+    SpatialHashGrid      mGrid {LANDER_RADIUS * 2};
+    std::vector<Vector2> mGridPoints;
+    std::vector<uint8_t> mIsHit; // Landers hit by another one in this step
+
+public:
+    // Constructor
+    // "landersN" landers start in rows (see makeStartPositions), as many
+    // of them as fit
+    SimWorld(const SimParams& sp, uint64_t seed, size_t landersN, size_t padsN)
+        : sp(sp)
+        , mLandingPads(makePads(sp, padsN, seed))
+        , mTerrain(sp, mLandingPads.data(), mLandingPads.size(), seed)
+    {
+        mMaxDistanceToPad = calcMagnitude({sp.SCREEN_WIDTH, sp.SCREEN_HEIGHT});
+        mPadOccupants.assign(mLandingPads.size(), -1);
+
+        mLanders.reserve(landersN);
+        for (const auto& pos : makeStartPositions(sp, mTerrain.mProfile.mMaxHeight, landersN))
+            mLanders.emplace_back(sp, pos);
+
+        mGridPoints.resize(mLanders.size());
+        mIsHit.resize(mLanders.size());
+    }
+
+    //==================================================================
+    // Execute one simulation step for all the landers
+    // "getBrainActions(landerIdx, state, actions)" is called for each
+    // active lander
+    template<typename GetActionsFn>
+    void AnimateWorld(const GetActionsFn& getBrainActions)
+    {
+        if (IsWorldComplete())
+            return;
+
+        mElapsedTimeS += Simulation::mTimeStepS;
+
+        // 1. Brains and physics of each lander
+        for (size_t i=0; i < mLanders.size(); ++i)
+        {
+            auto& lander = mLanders[i];
+            if (isLanderDone(lander))
+                continue;
+
+            const auto& pad = mLandingPads[findTargetPad(lander)];
+
+            Eigen::Vector<float, SIM_BRAINSTATE_N> simState;
+            simState[SIM_BRAINSTATE_LANDER_X] = lander.mPos.x;
+            simState[SIM_BRAINSTATE_LANDER_Y] = lander.mPos.y;
+            simState[SIM_BRAINSTATE_LANDER_VX] = lander.mVel.x;
+            simState[SIM_BRAINSTATE_LANDER_VY] = lander.mVel.y;
+            simState[SIM_BRAINSTATE_LANDER_FUEL] = lander.mFuel;
+            simState[SIM_BRAINSTATE_LANDER_STATE_LANDED] = lander.mStateIsLanded;
+            simState[SIM_BRAINSTATE_LANDER_STATE_CRASHED] = lander.mStateIsCrashed;
+            simState[SIM_BRAINSTATE_PAD_X] = pad.mPos.x;
+            simState[SIM_BRAINSTATE_PAD_Y] = pad.mPos.y;
+            simState[SIM_BRAINSTATE_PAD_WIDTH] = pad.mPadWidth;
+
+            Eigen::Vector<float, SIM_BRAINACTION_N> actions;
+            getBrainActions(i, simState, actions);
+
+            lander.mControl_UpThrust = actions[SIM_BRAINACTION_UP] > 0.5f;
+            lander.mControl_LeftThrust = actions[SIM_BRAINACTION_LEFT] > 0.5f;
+            lander.mControl_RightThrust = actions[SIM_BRAINACTION_RIGHT] > 0.5f;
+
+            lander.AnimLander();
+        }
+
+        // 2. Contacts with the pads and the terrain
+        for (size_t i=0; i < mLanders.size(); ++i)
+        {
+            auto& lander = mLanders[i];
+            if (isLanderDone(lander))
+                continue;
+
+            for (size_t p=0; p < mLandingPads.size(); ++p)
+            {
+                if (!mLandingPads[p].CheckPadLanding(lander))
+                    continue;
+
+                if (lander.mStateIsLanded)
+                {
+                    if (mPadOccupants[p] < 0)
+                    {
+                        mPadOccupants[p] = (int32_t)i;
+                    }
+                    else
+                    {
+                        lander.mStateIsLanded = false;
+                        lander.mStateIsCrashed = true;
+                    }
+                }
+                break;
+            }
+            mTerrain.CheckTerrainCollision(lander);
+        }
+
+        // 3. Contacts between landers
+        checkLandersContacts();
+    }
+
+    // Get the elapsed time in seconds
+    double GetElapsedTimeS() const { return mElapsedTimeS; }
+
+    // Check if all the landers are done, or the time is up
+    bool IsWorldComplete() const
+    {
+        if (mElapsedTimeS >= Simulation::MAX_TIME_S)
+            return true;
+
+        for (const auto& lander : mLanders)
+            if (!isLanderDone(lander))
+                return false;
+
+        return true;
+    }
+
+    // Calculate the score of a lander (same as Simulation::CalculateScore,
+    // with the nearest pad)
+    double CalculateScore(size_t landerIdx) const
+    {
+        const auto& lander = mLanders[landerIdx];
+
+        double score = 1;
+
+        const auto distanceToPad = calcDistanceToPad(lander, findNearestPad(lander));
+
+        score += 1 * (1 - mapTo01(distanceToPad, 0.0f, mMaxDistanceToPad));
+        auto speed = calcMagnitude(lander.mVel);
+        score += 0.1 * (1 - mapTo01(speed, 0.0f, sp.LANDING_SAFE_SPEED));
+
+        if (lander.mStateIsLanded)
+            score += 1;
+
+        if (lander.mStateIsCrashed)
+            score -= 1;
+
+        return score * 10;
+    }
+
+private:
+    static std::vector<LandingPad> makePads(const SimParams& sp, size_t padsN, uint64_t& seed)
+    {
+        std::vector<LandingPad> pads;
+        pads.reserve(padsN);
+        for (size_t i=0; i < std::max<size_t>(padsN, 1); ++i)
+            pads.emplace_back(sp, seed);
+        return pads;
+    }
+
+    //==================================================================
+    // Start positions, in rows of landers spaced to not touch, between
+    // the terrain ("terrainMaxY" is its highest point) and the top of the
+    // screen. The first row is where a Simulation starts its lander, the
+    // next ones go down to the terrain, then up from the first one.
+    // When they don't fit, the rows are staggered (the odd ones shifted
+    // by half a spacing), which packs them closer. Past that, the landers
+    // that don't fit are left out: fewer positions than "landersN".
+    static std::vector<Vector2> makeStartPositions(const SimParams& sp, float terrainMaxY, size_t landersN)
+    {
+        const auto spacing = LANDER_RADIUS * 2.5f;
+        const auto usableW = sp.SCREEN_WIDTH * 0.9f;
+        const auto colsN = std::max<size_t>(1, (size_t)(usableW / spacing));
+        const auto rowsN = (landersN + colsN - 1) / colsN;
+
+        const auto startY = sp.SCREEN_HEIGHT * 0.75f;
+        const auto minY = terrainMaxY + spacing;
+        const auto maxY = sp.SCREEN_HEIGHT;
+
+        // Height and x offset of each row
+        std::vector<std::pair<float, float>> rows;
+        const auto makeRows = [&](float pitch, bool isStaggered) {
+            rows.clear();
+            const auto addRow = [&](int idx) {
+                const auto offX = isStaggered && (idx & 1) ? spacing * 0.5f : 0.0f;
+                rows.push_back({startY + (float)idx * pitch, offX});
+            };
+            for (int idx=0; startY + (float)idx * pitch >= minY; --idx)
+                addRow(idx);
+            for (int idx=1; startY + (float)idx * pitch <= maxY; ++idx)
+                addRow(idx);
+            return rows.size() >= rowsN;
+        };
+        if (!makeRows(spacing, false))
+            makeRows(spacing * std::sqrt(3.0f) * 0.5f, true);
+        landersN = std::min(landersN, rows.size() * colsN);
+
+        std::vector<Vector2> positions(landersN);
+        for (size_t i=0; i < landersN; ++i)
+        {
+            const auto col = i % colsN;
+            const auto row = i / colsN;
+            const auto rowW = (float)(std::min(colsN, landersN - row * colsN) - 1) * spacing;
+            positions[i] = {(float)col * spacing - rowW * 0.5f + rows[row].second, rows[row].first};
+        }
+        return positions;
+    }
+
+    static bool isLanderDone(const Lander& lander)
+    {
+        return lander.mStateIsLanded || lander.mStateIsCrashed;
+    }
+
+    float calcDistanceToPad(const Lander& lander, size_t padIdx) const
+    {
+        const auto& padPos = mLandingPads[padIdx].mPos;
+        return calcMagnitude({padPos.x - lander.mPos.x, padPos.y - lander.mPos.y});
+    }
+
+    size_t findNearestPad(const Lander& lander) const
+    {
+        size_t bestIdx = 0;
+        for (size_t p=1; p < mLandingPads.size(); ++p)
+            if (calcDistanceToPad(lander, p) < calcDistanceToPad(lander, bestIdx))
+                bestIdx = p;
+        return bestIdx;
+    }
+
+    // Nearest free pad, or the nearest one if they are all taken
+    size_t findTargetPad(const Lander& lander) const
+    {
+        size_t bestIdx = SIZE_MAX;
+        auto bestDist = std::numeric_limits<float>::max();
+        for (size_t p=0; p < mLandingPads.size(); ++p)
+        {
+            const auto dist = calcDistanceToPad(lander, p);
+            if (mPadOccupants[p] < 0 && dist < bestDist)
+            {
+                bestIdx = p;
+                bestDist = dist;
+            }
+        }
+        return bestIdx != SIZE_MAX ? bestIdx : findNearestPad(lander);
+    }
+
+    //==================================================================
+    // Crash the landers that touch each other
+    // Broadphase with the spatial hash grid (cells of one lander
+    // diameter), then the actual distance. Contacts are collected first
+    // and applied after, so the result doesn't depend on the order.
+    void checkLandersContacts()
+    {
+        const auto landersN = mLanders.size();
+        for (size_t i=0; i < landersN; ++i)
+            mGridPoints[i] = mLanders[i].mPos;
+
+        // Crashed landers are out of the way
+        mGrid.Build(mGridPoints.data(), landersN, [&](size_t i) {
+            return !mLanders[i].mStateIsCrashed;
+        });
+
+        std::fill(mIsHit.begin(), mIsHit.end(), 0);
+
+        const auto minDist2 = (LANDER_RADIUS * 2) * (LANDER_RADIUS * 2);
+        for (size_t i=0; i < landersN; ++i)
+        {
+            // Only the flying landers move into others
+            const auto& lander = mLanders[i];
+            if (isLanderDone(lander))
+                continue;
+
+            mGrid.ForEachNear(lander.mPos, [&](size_t j) {
+                if (j == i)
+                    return;
+                const auto dx = mLanders[j].mPos.x - lander.mPos.x;
+                const auto dy = mLanders[j].mPos.y - lander.mPos.y;
+                if (dx*dx + dy*dy < minDist2)
+                {
+                    mIsHit[i] = 1;
+                    mIsHit[j] = 1;
+                }
+            });
+        }
+
+        for (size_t i=0; i < landersN; ++i)
+        {
+            if (!mIsHit[i])
+                continue;
+
+            auto& lander = mLanders[i];
+            if (lander.mStateIsLanded)
+            {
+                // Free its pad
+                for (auto& occupant : mPadOccupants)
+                    if (occupant == (int32_t)i)
+                        occupant = -1;
+            }
+            lander.mStateIsLanded = false;
+            lander.mStateIsCrashed = true;
+        }
+    }
+};
+
+#endif
@@ -8,11 +8,15 @@
 #include <random> // Needed for InitializeRandomParameters
 #include <cassert>   // For assert
 #include <Eigen/Dense>
+#include "TinyGemv.h"
+#include "Activations.h"
 
 #define SNN_INIT_RANDOM_UNIFORM 0
 #define SNN_INIT_HE_NORMAL 0
 #define SNN_INIT_XAVIER_UNIFORM 1
 
+#define SNN_USE_TINY_GEMV 1 // Layers computed with kernels for their shape (see TinyGemv.h)
+
 template<typename T, typename Scalar>
 concept EigenMatrix = requires
 {
@@ -48,7 +52,8 @@ concept OnConstParamFunc = requires(T t, int l, int r, int c, const Y& param)
     { t(l, r, c, param) };
 };
 
-template<std::floating_point T, NetArch auto netArch>
+// Activations: the activation policy of each layer (see Activations.h)
+template<std::floating_point T, NetArch auto netArch, typename Activations = Activation::Layers<Activation::ReLU>>
 class SimpleNeuralNet
 {
 public:
@@ -59,6 +64,18 @@ public:
     using Inputs = Eigen::Vector<T, netArch.front()>;
     using Outputs = Eigen::Vector<T, netArch.back()>;
 
+    static constexpr size_t LAYERS_N = netArch.size() - 1;
+
+    // Activation policy of a layer
+    template<size_t L>
+    using LayerActivation = typename Activations::template Get<L>;
+    static_assert(Activations::SIZE <= LAYERS_N, "More activations than layers");
+
+    // Activations IDs of the layers
+    static constexpr auto ACTIVATION_IDS = []<size_t... Ls>(std::index_sequence<Ls...>) {
+        return std::array<uint32_t, LAYERS_N>{ LayerActivation<Ls>::ID... };
+    }(std::make_index_sequence<LAYERS_N>{});
+
 private:
     Parameters mParams;
 
@@ -122,6 +139,15 @@ The example below is just for illustration.
         return n;
     }
 
+    // Offset of a layer's parameters in the flat parameters layout
+    constexpr static size_t CalcLayerOffset(size_t layer)
+    {
+        size_t n = 0;
+        for (size_t i = 1; i <= layer; ++i)
+            n += netArch[i-1] * netArch[i] + netArch[i];
+        return n;
+    }
+
     //==================================================================
     // Feed forward function
     // This function builds a net with the given Parameters and then
@@ -131,7 +157,72 @@ The example below is just for illustration.
 
     void FeedForward(const Inputs& pInputs, Outputs& pOutputs) const
     {
-        std::apply([&](const auto&... params) { this->FeedForward(pInputs, pOutputs, params...); }, mParams);
+        std::apply([&](const auto&... params) { FeedForward(pInputs, pOutputs, params...); }, mParams);
+    }
+
+    //==================================================================
+    // Flat parameters
+    // The same parameters can also live outside of a SimpleNeuralNet
+    // object, as a plain array of CalcTotalParameters() values:
+    // the layers one after the other, each one stored as its
+    // (outputs x inputs+1) matrix in Eigen's column-major order.
+    // This lets trainers keep large populations in one compact block.
+    //==================================================================
+
+    // Feed forward using parameters from a flat array (no copy)
+    static void FeedForward(const T* pFlatParams, const Inputs& pInputs, Outputs& pOutputs)
+    {
+        [&]<size_t... Idxs>(std::index_sequence<Idxs...>) {
+            FeedForward(pInputs, pOutputs,
+                Eigen::Map<const std::tuple_element_t<Idxs, Parameters>>(pFlatParams + CalcLayerOffset(Idxs))...);
+        }(std::make_index_sequence<std::tuple_size_v<Parameters>>{});
+    }
+
+    // Copy the parameters to a flat array
+    void CopyParametersTo(T* pFlatParams) const
+    {
+        std::apply([&](const auto&... layers) {
+            ((Eigen::Map<std::remove_cvref_t<decltype(layers)>>(pFlatParams) = layers, pFlatParams += layers.size()), ...);
+        }, mParams);
+    }
+
+    // Set the parameters from a flat array
+    void SetParametersFrom(const T* pFlatParams)
+    {
+        std::apply([&](auto&... layers) {
+            ((layers = Eigen::Map<const std::remove_cvref_t<decltype(layers)>>(pFlatParams), pFlatParams += layers.size()), ...);
+        }, mParams);
+    }
+
+    //==================================================================
+    // Backward pass
+    // Gradients of a loss with respect to the flat parameters, to train
+    // a network on examples (see TrainingTaskDistill.h):
+    // - FeedForwardTrace() is FeedForward(), keeping the outputs of all
+    //   the layers in a trace (TRACE_SIZE values)
+    // - Backward() takes the gradient of the loss with respect to the
+    //   outputs, and adds the gradient with respect to the parameters
+    //   to pFlatGrads: the gradient of a minibatch is the sum of the
+    //   calls for its samples
+    //==================================================================
+    static constexpr size_t TRACE_SIZE = []() {
+        size_t n = 0;
+        for (size_t i = 1; i < netArch.size(); ++i)
+            n += netArch[i];
+        return n;
+    }();
+
+    static void FeedForwardTrace(const T* pFlatParams, const Inputs& pInputs, T* pTrace, Outputs& pOutputs)
+    {
+        [&]<size_t... Idxs>(std::index_sequence<Idxs...>) {
+            (feedTraceLayer<Idxs>(pFlatParams, pInputs.data(), pTrace), ...);
+        }(std::make_index_sequence<LAYERS_N>{});
+        pOutputs = Eigen::Map<const Outputs>(pTrace + calcTraceOffset(LAYERS_N - 1));
+    }
+
+    static void Backward(const T* pFlatParams, const Inputs& pInputs, const T* pTrace, const Outputs& dOutputs, T* pFlatGrads)
+    {
+        backwardLayer<LAYERS_N - 1>(pFlatParams, pInputs.data(), pTrace, dOutputs, pFlatGrads);
     }
     
     // Get the total number of parameters (weights + biases) in the network
@@ -238,22 +329,86 @@ The example below is just for illustration.
     }
 
 private:
-    float Activate(float x) const { return x > 0.0f ? x : 0.0f; } // ReLU
-    //float Activate(float x) const { return x > 0.0f ? x : 0.01f * x; } // Leaky ReLU
-    
-    template<int I, int O>
-    void FeedForward(const Eigen::Vector<T, I>& pInputs, Eigen::Vector<T, O>& pOutputs, const Eigen::Matrix<T, O, I+1>& pParams) const
+    // Activate on Eigen arrays, vectorized (see TinyGemv.h)
+    template<size_t L>
+    struct ActivateFunc { auto operator()(const auto& x) const { return LayerActivation<L>::Apply(x); } };
+
+    static constexpr size_t calcTraceOffset(size_t layer)
+    {
+        size_t n = 0;
+        for (size_t i = 1; i <= layer; ++i)
+            n += netArch[i];
+        return n;
+    }
+
+    // Inputs of layer L: the network's inputs, or the previous layer's
+    // outputs in the trace
+    template<size_t L>
+    static const T* getTraceInputs(const T* pInputs, const T* pTrace)
+    {
+        if constexpr (L == 0)
+            return pInputs;
+        else
+            return pTrace + calcTraceOffset(L - 1);
+    }
+
+    template<size_t L>
+    static void feedTraceLayer(const T* pFlatParams, const T* pInputs, T* pTrace)
+    {
+        constexpr int I = netArch[L];
+        constexpr int O = netArch[L + 1];
+        const T* pLayerInputs = getTraceInputs<L>(pInputs, pTrace);
+        T* pLayerOutputs = pTrace + calcTraceOffset(L);
+#if SNN_USE_TINY_GEMV
+        TinyGemv::SelectKernel<T, I, O>::Run(pFlatParams + CalcLayerOffset(L), pLayerInputs, pLayerOutputs, ActivateFunc<L>{});
+#else
+        const Eigen::Map<const Eigen::Matrix<T, O, I+1>> params(pFlatParams + CalcLayerOffset(L));
+        Eigen::Map<Eigen::Vector<T, O>> outputs(pLayerOutputs);
+        outputs = ActivateFunc<L>{}((params * Eigen::Map<const Eigen::Vector<T, I>>(pLayerInputs).homogeneous()).array()).matrix();
+#endif
+    }
+
+    // dOutputs: gradient with respect to the outputs of layer L
+    template<size_t L>
+    static void backwardLayer(const T* pFlatParams, const T* pInputs, const T* pTrace,
+                              const Eigen::Vector<T, netArch[L + 1]>& dOutputs, T* pFlatGrads)
     {
-        pOutputs = (pParams * pInputs.homogeneous()).unaryExpr([&](T x) { return Activate(x); });
+        constexpr int I = netArch[L];
+        constexpr int O = netArch[L + 1];
+        const Eigen::Map<const Eigen::Vector<T, I>> inputs(getTraceInputs<L>(pInputs, pTrace));
+        const Eigen::Map<const Eigen::Vector<T, O>> outputs(pTrace + calcTraceOffset(L));
+        const Eigen::Map<const Eigen::Matrix<T, O, I+1>> params(pFlatParams + CalcLayerOffset(L));
+        Eigen::Map<Eigen::Matrix<T, O, I+1>> grads(pFlatGrads + CalcLayerOffset(L));
+
+        // Through the activation, then the sums
+        const Eigen::Vector<T, O> dSums = (dOutputs.array() * LayerActivation<L>::Derivative(outputs.array())).matrix();
+        grads.template leftCols<I>().noalias() += dSums * inputs.transpose();
+        grads.col(I) += dSums;
+        if constexpr (L > 0)
+        {
+            const Eigen::Vector<T, I> dInputs = params.template leftCols<I>().transpose() * dSums;
+            backwardLayer<L - 1>(pFlatParams, pInputs, pTrace, dInputs, pFlatGrads);
+        }
+    }
+
+    // L: the layer's index, for its activation
+    template<size_t L = 0, int I, int O>
+    static void FeedForward(const Eigen::Vector<T, I>& pInputs, Eigen::Vector<T, O>& pOutputs, const EigenMatrixC<T, I+1> auto& pParams)
+    {
+#if SNN_USE_TINY_GEMV
+        TinyGemv::SelectKernel<T, I, O>::Run(pParams.data(), pInputs.data(), pOutputs.data(), ActivateFunc<L>{});
+#else
+        pOutputs = ActivateFunc<L>{}((pParams * pInputs.homogeneous()).array()).matrix();
+#endif
     }
 
-    template<int I, int O>
-    void FeedForward(const Eigen::Vector<T, I>& pInputs, Eigen::Vector<T, O>& pOutputs, const EigenMatrixC<T, I+1> auto& pParams,
-                     const EigenMatrix<T> auto&  pRemaingParams, const EigenMatrix<T> auto& ... pRemaingParamsPack) const
+    template<size_t L = 0, int I, int O>
+    static void FeedForward(const Eigen::Vector<T, I>& pInputs, Eigen::Vector<T, O>& pOutputs, const EigenMatrixC<T, I+1> auto& pParams,
+                            const EigenMatrix<T> auto&  pRemaingParams, const EigenMatrix<T> auto& ... pRemaingParamsPack)
     {
         Eigen::Vector<T, std::remove_cvref_t<decltype(pParams)>::RowsAtCompileTime> outputs;
-        FeedForward(pInputs, outputs, pParams);
-        FeedForward(outputs, pOutputs, pRemaingParams, pRemaingParamsPack...);
+        FeedForward<L>(pInputs, outputs, pParams);
+        FeedForward<L + 1>(outputs, pOutputs, pRemaingParams, pRemaingParamsPack...);
     }
 };
 
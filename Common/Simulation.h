@@ -35,6 +35,28 @@ public:
     float LATERAL_THRUST_POWER = 0.08f;
     float LANDING_SAFE_SPEED = 1.5f;
     float GROUND_LEVEL = 30.0f;
+
+    // SimParams is also usable as a template argument, for compile-time
+    // parameters (see SimRolloutFixed)
+    constexpr bool operator==(const SimParams&) const = default;
+};
+
+//==================================================================
+// Options on how the simulation is run (they don't change the physics)
+//==================================================================
+class SimRunOptions
+{
+public:
+    // End the episode as soon as the brain can't change its outcome,
+    // finalizing it with the score it would have received at the end
+    // (see Simulation::checkEarlyTermination)
+    bool EARLY_TERMINATION = false;
+
+    // Query the brain every ACTION_REPEAT steps, and hold its controls
+    // in between (the physics still steps at the full rate). The
+    // rollouts hold it in a byte, and clamp it to 255 (see
+    // SimRolloutContext)
+    int ACTION_REPEAT = 1;
 };
 
 // Indices of states in the simulation state array
@@ -150,6 +172,11 @@ public:
     Vector2 mPos {0.0f, 0.0f};
     float   mPadWidth = 100.0f;
 
+    // Empty pad, to be set from a scenario
+    explicit LandingPad(const SimParams& sp)
+        : sp(sp)
+    {}
+
     LandingPad(const SimParams& sp, uint64_t& seed)
         : sp(sp)
     {
@@ -186,6 +213,131 @@ public:
     }
 };
 
+// Number of segments of the terrain (can be set at build time, up to
+// thousands, the collision cost doesn't depend on it)
+#ifndef NNL_TERRAIN_SEGMENTS_N
+    #define NNL_TERRAIN_SEGMENTS_N 10
+#endif
+
+//==================================================================
+// Terrain profile - the terrain polyline, ready for collision checks
+// Segments have the same width, so the segment under a point is found
+// directly from its x, and its line gives the height of the terrain.
+// It's plain data, so it can be part of a scenario (see SimScenario)
+//==================================================================
+template<size_t SEGMENTS_N>
+struct TerrainProfile
+{
+    struct Segment
+    {
+        float slope = 0.0f;
+        float intercept = 0.0f; // Height at x = 0
+    };
+
+    float   mMinX = 0.0f;
+    float   mMaxX = 0.0f;
+    float   mInvSegmentWidth = 0.0f;
+    float   mMaxHeight = 0.0f; // Nothing can touch the terrain above this
+    Segment mSegments[SEGMENTS_N] {};
+
+    // Build from SEGMENTS_N+1 points, evenly spaced in x
+    void Build(const Vector2* pPoints)
+    {
+        mMinX = pPoints[0].x;
+        mMaxX = pPoints[SEGMENTS_N].x;
+        mInvSegmentWidth = (float)SEGMENTS_N / (mMaxX - mMinX);
+        mMaxHeight = pPoints[0].y;
+        for (size_t i=0; i < SEGMENTS_N; ++i)
+        {
+            const auto& p0 = pPoints[i];
+            const auto& p1 = pPoints[i + 1];
+            mSegments[i].slope = (p1.y - p0.y) / (p1.x - p0.x);
+            mSegments[i].intercept = p0.y - mSegments[i].slope * p0.x;
+            mMaxHeight = std::max(mMaxHeight, p1.y);
+        }
+    }
+
+    // Height of the terrain at x (flat beyond the ends)
+    float GetHeightAt(float x) const
+    {
+        x = std::clamp(x, mMinX, mMaxX);
+        const auto segIdx = std::min((size_t)((x - mMinX) * mInvSegmentWidth), SEGMENTS_N - 1);
+        const auto& seg = mSegments[segIdx];
+        return seg.slope * x + seg.intercept;
+    }
+
+    //==================================================================
+    // Distance along a ray to the terrain, or "maxDist" if it's not hit
+    // within it ("dir" is a unit vector)
+    // The part of the ray above mMaxHeight is skipped, then the ray walks
+    // the segments it crosses (they are bins of the same width), testing
+    // each one, until the first hit. So a downward ray only tests the
+    // segments between mMaxHeight and where it lands (usually one or two).
+    float CastRay(const Vector2& origin, const Vector2& dir, float maxDist) const
+    {
+        if (origin.y <= GetHeightAt(origin.x))
+            return 0.0f;
+
+        // Start where the ray can first touch the terrain
+        float t = 0.0f;
+        if (origin.y > mMaxHeight)
+        {
+            if (dir.y >= 0)
+                return maxDist;
+            t = (origin.y - mMaxHeight) / -dir.y;
+            if (t >= maxDist)
+                return maxDist;
+        }
+
+        // Segment at the start, -1 and SEGMENTS_N are the flat ends
+        const auto x = origin.x + t * dir.x;
+        int64_t segIdx = x < mMinX ? -1
+                       : x >= mMaxX ? (int64_t)SEGMENTS_N
+                       : std::min((int64_t)((x - mMinX) * mInvSegmentWidth), (int64_t)SEGMENTS_N - 1);
+
+        const auto segmentWidth = (mMaxX - mMinX) / (float)SEGMENTS_N;
+        const int64_t segStep = dir.x > 0 ? 1 : -1;
+        while (true)
+        {
+            // Line of the segment, and the end of the ray over it
+            float slope = 0.0f;
+            float intercept = 0.0f;
+            float tEnd = maxDist;
+            if (segIdx < 0 || segIdx >= (int64_t)SEGMENTS_N)
+            {
+                intercept = GetHeightAt(segIdx < 0 ? mMinX : mMaxX);
+                // Going towards the terrain, the ray enters its first segment
+                if (dir.x != 0 && (segIdx < 0) == (dir.x > 0))
+                    tEnd = ((segIdx < 0 ? mMinX : mMaxX) - origin.x) / dir.x;
+            }
+            else
+            {
+                slope = mSegments[segIdx].slope;
+                intercept = mSegments[segIdx].intercept;
+                if (dir.x != 0)
+                {
+                    const auto edgeX = mMinX + (float)(segIdx + (dir.x > 0 ? 1 : 0)) * segmentWidth;
+                    tEnd = (edgeX - origin.x) / dir.x;
+                }
+            }
+            tEnd = std::clamp(tEnd, t, maxDist);
+
+            // Height of the ray over the segment line, linear in t:
+            //  f(t) = a + b*t
+            const auto a = origin.y - (slope * origin.x + intercept);
+            const auto b = dir.y - slope * dir.x;
+            if (a + b * tEnd <= 0)
+                return b < 0 ? std::clamp(-a / b, t, tEnd) : t;
+
+            if (tEnd >= maxDist)
+                return maxDist;
+
+            t = tEnd;
+            segIdx += segStep;
+        }
+    }
+};
+
 //==================================================================
 // Terrain class
 //==================================================================
@@ -194,12 +346,23 @@ class Terrain
 public:
     SimParams sp;
 public:
-    static const size_t SEGMENTS_N = 10;
+    static constexpr size_t SEGMENTS_N = NNL_TERRAIN_SEGMENTS_N;
     Vector2 mPoints[SEGMENTS_N + 1];
+    TerrainProfile<SEGMENTS_N> mProfile; // For the collisions
+
+    float mGroundY = 0; // Base level of the terrain
 
-    float mGroundY = 0;
+    // Empty terrain, to be set from a scenario
+    explicit Terrain(const SimParams& sp)
+        : sp(sp)
+    {}
 
     Terrain(const SimParams& sp, LandingPad& pad, uint64_t& seed)
+        : Terrain(sp, &pad, 1, seed)
+    {}
+
+    // Terrain with a flat area for each of "padsN" landing pads
+    Terrain(const SimParams& sp, const LandingPad* pPads, size_t padsN, uint64_t& seed)
         : sp(sp)
     {
         mGroundY = sp.GROUND_LEVEL;
@@ -212,17 +375,25 @@ public:
             mPoints[i].x = i * segmentWidth - sp.SCREEN_WIDTH*0.5f;
 
             // Find landing pad segment
-            float padLeftX = pad.mPos.x - pad.mPadWidth/2;
-            float padRightX = pad.mPos.x + pad.mPadWidth/2;
+            const LandingPad* pAreaPad = nullptr;
+            for (size_t j=0; j < padsN && !pAreaPad; ++j)
+            {
+                const auto& pad = pPads[j];
+                float padLeftX = pad.mPos.x - pad.mPadWidth/2;
+                float padRightX = pad.mPos.x + pad.mPadWidth/2;
 
-            const auto isLandingPadArea =
-                mPoints[i].x >= padLeftX - segmentWidth &&
-                mPoints[i].x <= padRightX + segmentWidth;
+                const auto isLandingPadArea =
+                    mPoints[i].x >= padLeftX - segmentWidth &&
+                    mPoints[i].x <= padRightX + segmentWidth;
 
-            if (isLandingPadArea)
+                if (isLandingPadArea)
+                    pAreaPad = &pad;
+            }
+
+            if (pAreaPad)
             {
                 // Make flat area for landing pad
-                mPoints[i].y = pad.mPos.y;
+                mPoints[i].y = pAreaPad->mPos.y;
             }
             else
             {
@@ -232,6 +403,8 @@ public:
             }
         }
 
+        mProfile.Build(mPoints);
+
         // Update seed for chaining with other generators
         seed = rng.NextU64();
     }
@@ -243,7 +416,7 @@ public:
         if (lander.mStateIsCrashed || lander.mStateIsLanded)
             return false;
 
-        if (lander.mPos.y <= mGroundY)
+        if (lander.mPos.y <= mProfile.GetHeightAt(lander.mPos.x))
         {
             lander.mStateIsCrashed = true;
             return true;
@@ -253,6 +426,107 @@ public:
     }
 };
 
+//==================================================================
+// Raycast sensors - optional brain inputs, after the SimBrainState ones
+// RAYS_N rays fan out from the lander, evenly over the lower half
+// circle (from the left to the right), and each one gives the distance
+// to the terrain or the pad it hits, up to MAX_DIST.
+// They are selected at compile-time (see Simulation::AnimateSim), so
+// the brains without sensors pay nothing for them.
+//==================================================================
+template<int RAYS_N>
+struct SimRaySensors
+{
+    static constexpr float MAX_DIST = 600.0f;
+
+    static inline const std::array<Vector2, RAYS_N> DIRS = []()
+    {
+        std::array<Vector2, RAYS_N> dirs {};
+        for (int i=0; i < RAYS_N; ++i)
+        {
+            const auto angle = PI * (1.0f + ((float)i + 0.5f) / (float)RAYS_N);
+            dirs[i] = {std::cos(angle), std::sin(angle)};
+        }
+        return dirs;
+    }();
+
+    template<size_t SEGMENTS_N>
+    static void CalcDistances(
+            const TerrainProfile<SEGMENTS_N>& profile,
+            const Vector2& padPos,
+            float padWidth,
+            const Vector2& pos,
+            float* pOutDists)
+    {
+        for (int i=0; i < RAYS_N; ++i)
+        {
+            const auto& dir = DIRS[i];
+            auto dist = profile.CastRay(pos, dir, MAX_DIST);
+
+            // The pad is a horizontal segment (all the rays go down)
+            if (pos.y > padPos.y)
+            {
+                const auto padDist = (pos.y - padPos.y) / -dir.y;
+                const auto padX = pos.x + padDist * dir.x;
+                if (padDist < dist && std::abs(padX - padPos.x) <= padWidth/2)
+                    dist = padDist;
+            }
+            pOutDists[i] = dist;
+        }
+    }
+};
+
+//==================================================================
+// Scenario - the static layout of a simulation variant (pad and terrain)
+// It's plain data, so it can be shared between simulations and stored
+// in files (see ScenarioBank)
+//==================================================================
+struct SimScenario
+{
+    uint64_t seed = 0; // Seed the layout was generated from
+    Vector2  padPos {0.0f, 0.0f};
+    float    padWidth = 0.0f;
+    float    groundY = 0.0f;
+    Vector2  terrainPoints[Terrain::SEGMENTS_N + 1] {};
+    TerrainProfile<Terrain::SEGMENTS_N> terrainProfile;
+};
+
+//==================================================================
+// Ballistic (out of fuel) fall
+// Follows the discrete steps of Lander::AnimLander, with no thrust and
+// none of the contact checks, in float and in the same order, so that
+// the final state is the one of the stepped fall, to the last bit.
+// Without the brain and the checks, the steps are only a few adds.
+// Updates the position and velocity to the end of the free fall, which
+// is either the first step at or below "contactY", or the timeout.
+// "takeStep()" is called before each step, to count it, and returns
+// false at the timeout, so the time is counted as in the regular loop.
+// Nothing can be touched above contactY (the pad and the highest point
+// of the terrain), the contact checks from there are left to the caller.
+// Returns true when contactY is reached.
+//==================================================================
+inline bool fallBallistic(
+        const SimParams& sp,
+        float contactY,
+        Vector2& pos,
+        Vector2& vel,
+        const auto& takeStep)
+{
+    const auto maxAbsX = sp.SCREEN_WIDTH*0.6f;
+    while (takeStep())
+    {
+        vel.y += sp.GRAVITY;
+        pos.x += vel.x;
+        pos.y += vel.y;
+        pos.x = std::clamp(pos.x, -maxAbsX, maxAbsX);
+        if (pos.y > sp.SCREEN_HEIGHT) pos.y = sp.SCREEN_HEIGHT;
+
+        if (pos.y <= contactY)
+            return true;
+    }
+    return false;
+}
+
 //==================================================================
 // Simulation class
 //==================================================================
@@ -266,6 +540,7 @@ class Simulation
 {
 public:
     SimParams   sp;
+    SimRunOptions ro;
     Lander      mLander;
     LandingPad  mLandingPad;
     Terrain     mTerrain;
@@ -276,9 +551,12 @@ public:
 
     float mMaxDistanceToPad = 0.0f;
 
+    int mActionHoldStepsN = 0; // Steps left before the next brain query
+
     // Constructor
-    Simulation(const SimParams& sp, uint64_t seed)
+    Simulation(const SimParams& sp, uint64_t seed, const SimRunOptions& ro = {})
         : sp(sp)
+        , ro(ro)
         , mLander(sp, Vector2{0.0f, sp.SCREEN_HEIGHT * 0.75f})
         , mLandingPad(sp, seed)
         , mTerrain(sp, mLandingPad, seed)
@@ -288,8 +566,42 @@ public:
         mMaxDistanceToPad = calcMagnitude({w, h});
     }
 
+    // Constructor from a pre-generated scenario (same as from its seed,
+    // but skips the generation of the layout)
+    Simulation(const SimParams& sp, const SimScenario& sc, const SimRunOptions& ro = {})
+        : sp(sp)
+        , ro(ro)
+        , mLander(sp, Vector2{0.0f, sp.SCREEN_HEIGHT * 0.75f})
+        , mLandingPad(sp)
+        , mTerrain(sp)
+    {
+        mLandingPad.mPos = sc.padPos;
+        mLandingPad.mPadWidth = sc.padWidth;
+        mTerrain.mGroundY = sc.groundY;
+        std::copy(std::begin(sc.terrainPoints), std::end(sc.terrainPoints), mTerrain.mPoints);
+        mTerrain.mProfile = sc.terrainProfile;
+
+        auto w = sp.SCREEN_WIDTH;
+        auto h = sp.SCREEN_HEIGHT;
+        mMaxDistanceToPad = calcMagnitude({w, h});
+    }
+
+    // Get the scenario of this simulation (its seed is left to the caller)
+    SimScenario GetScenario() const
+    {
+        SimScenario sc;
+        sc.padPos = mLandingPad.mPos;
+        sc.padWidth = mLandingPad.mPadWidth;
+        sc.groundY = mTerrain.mGroundY;
+        std::copy(std::begin(mTerrain.mPoints), std::end(mTerrain.mPoints), sc.terrainPoints);
+        sc.terrainProfile = mTerrain.mProfile;
+        return sc;
+    }
+
     // Execute one simulation step
-    void AnimateSim(const GetBrainActionsFn<float, SIM_BRAINSTATE_N, SIM_BRAINACTION_N> auto& getBrainActions)
+    // RAYS_N raycast sensors are added to the brain state (see SimRaySensors)
+    template<int RAYS_N = 0>
+    void AnimateSim(const GetBrainActionsFn<float, SIM_BRAINSTATE_N + RAYS_N, SIM_BRAINACTION_N> auto& getBrainActions)
     {
         // Skip the simulation if lander is not active
         if (mLander.mStateIsCrashed || mLander.mStateIsLanded)
@@ -297,31 +609,48 @@ public:
 
         mElapsedTimeS += mTimeStepS;
 
-        // 1. Convert the simulation variables to a eigen vector for the brain input
-        Eigen::Vector<float, SIM_BRAINSTATE_N> simState;
-        simState[SIM_BRAINSTATE_LANDER_X] = mLander.mPos.x;
-        simState[SIM_BRAINSTATE_LANDER_Y] = mLander.mPos.y;
-        simState[SIM_BRAINSTATE_LANDER_VX] = mLander.mVel.x;
-        simState[SIM_BRAINSTATE_LANDER_VY] = mLander.mVel.y;
-        simState[SIM_BRAINSTATE_LANDER_FUEL] = mLander.mFuel;
-        simState[SIM_BRAINSTATE_LANDER_STATE_LANDED] = mLander.mStateIsLanded;
-        simState[SIM_BRAINSTATE_LANDER_STATE_CRASHED] = mLander.mStateIsCrashed;
-        simState[SIM_BRAINSTATE_PAD_X] = mLandingPad.mPos.x;
-        simState[SIM_BRAINSTATE_PAD_Y] = mLandingPad.mPos.y;
-        simState[SIM_BRAINSTATE_PAD_WIDTH] = mLandingPad.mPadWidth;
-
-        // 2. Get the brain actions
-        Eigen::Vector<float, SIM_BRAINACTION_N> actions;
-        getBrainActions(simState, actions);
-
-        // 3. Convert the brain actions to the simulation variables
-        mLander.mControl_UpThrust = actions[SIM_BRAINACTION_UP] > 0.5f;
-        mLander.mControl_LeftThrust = actions[SIM_BRAINACTION_LEFT] > 0.5f;
-        mLander.mControl_RightThrust = actions[SIM_BRAINACTION_RIGHT] > 0.5f;
+        // Query the brain, or keep holding its last controls
+        const auto isBrainStep = mActionHoldStepsN <= 0;
+        if (isBrainStep)
+        {
+            // 1. Convert the simulation variables to a eigen vector for the brain input
+            Eigen::Vector<float, SIM_BRAINSTATE_N + RAYS_N> simState;
+            simState[SIM_BRAINSTATE_LANDER_X] = mLander.mPos.x;
+            simState[SIM_BRAINSTATE_LANDER_Y] = mLander.mPos.y;
+            simState[SIM_BRAINSTATE_LANDER_VX] = mLander.mVel.x;
+            simState[SIM_BRAINSTATE_LANDER_VY] = mLander.mVel.y;
+            simState[SIM_BRAINSTATE_LANDER_FUEL] = mLander.mFuel;
+            simState[SIM_BRAINSTATE_LANDER_STATE_LANDED] = mLander.mStateIsLanded;
+            simState[SIM_BRAINSTATE_LANDER_STATE_CRASHED] = mLander.mStateIsCrashed;
+            simState[SIM_BRAINSTATE_PAD_X] = mLandingPad.mPos.x;
+            simState[SIM_BRAINSTATE_PAD_Y] = mLandingPad.mPos.y;
+            simState[SIM_BRAINSTATE_PAD_WIDTH] = mLandingPad.mPadWidth;
+            if constexpr (RAYS_N > 0)
+            {
+                SimRaySensors<RAYS_N>::CalcDistances(
+                    mTerrain.mProfile, mLandingPad.mPos, mLandingPad.mPadWidth, mLander.mPos,
+                    simState.data() + SIM_BRAINSTATE_N);
+            }
+
+            // 2. Get the brain actions
+            Eigen::Vector<float, SIM_BRAINACTION_N> actions;
+            getBrainActions(simState, actions);
+
+            // 3. Convert the brain actions to the simulation variables
+            mLander.mControl_UpThrust = actions[SIM_BRAINACTION_UP] > 0.5f;
+            mLander.mControl_LeftThrust = actions[SIM_BRAINACTION_LEFT] > 0.5f;
+            mLander.mControl_RightThrust = actions[SIM_BRAINACTION_RIGHT] > 0.5f;
+
+            mActionHoldStepsN = std::max(ro.ACTION_REPEAT, 1);
+        }
+        mActionHoldStepsN -= 1;
 
         mLander.AnimLander(); // Update lander
         mLandingPad.CheckPadLanding(mLander); // Check for landing
         mTerrain.CheckTerrainCollision(mLander); // Check for terrain collision
+
+        if (ro.EARLY_TERMINATION)
+            checkEarlyTermination();
     }
 
     // Get the elapsed time in seconds
@@ -358,6 +687,59 @@ public:
 
         return score * 10; // Scale for readability
     }
+
+private:
+    //==================================================================
+    // Early termination
+    // Detect when the rest of the episode can't depend on the brain
+    // anymore, and jump straight to its end. The final state, and so the
+    // score, is the same as the full rollout.
+    // A hovering lander, or one too far to reach the pad before the
+    // timeout, still runs to the end: its score depends on where it
+    // stops, which only the steps can tell.
+    //==================================================================
+    void checkEarlyTermination()
+    {
+        if (IsSimulationComplete())
+            return;
+
+        // Out of fuel: the controls have no effect anymore, and the
+        // rest is ballistic. Fall without the checks to where the lander
+        // could touch something, then finish with physics only (no
+        // brain), with the same steps of the regular loop.
+        if (mLander.mFuel <= 0)
+        {
+            fastForwardBallistic();
+
+            while (!IsSimulationComplete() && mElapsedTimeS < MAX_TIME_S)
+            {
+                mElapsedTimeS += mTimeStepS;
+                mLander.AnimLander();
+                mLandingPad.CheckPadLanding(mLander);
+                mTerrain.CheckTerrainCollision(mLander);
+            }
+        }
+    }
+
+    //==================================================================
+    // Jump a ballistic (out of fuel) fall to the first step that could
+    // touch the pad or the terrain, or to the timeout (see fallBallistic)
+    void fastForwardBallistic()
+    {
+        const auto contactY = std::max(mLandingPad.mPos.y, mTerrain.mProfile.mMaxHeight);
+        const auto isContact = fallBallistic(sp, contactY, mLander.mPos, mLander.mVel, [&]() {
+            if (mElapsedTimeS >= MAX_TIME_S)
+                return false;
+            mElapsedTimeS += mTimeStepS;
+            return true;
+        });
+
+        if (isContact)
+        {
+            mLandingPad.CheckPadLanding(mLander);
+            mTerrain.CheckTerrainCollision(mLander);
+        }
+    }
 };
 
 #endif
@@ -0,0 +1,127 @@
+#ifndef SPATIALHASHGRID_H
+#define SPATIALHASHGRID_H
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include "raylib.h" // For Vector2
+
+//==================================================================
+// SpatialHashGrid class - broadphase for proximity queries
+// Space is split in square cells of a given size, and each cell is
+// hashed to a bucket of a fixed-size table, so the grid needs no bounds.
+// The grid is rebuilt from scratch with all the points (counting sort
+// of the points by bucket, O(N)), and a query only visits the buckets
+// of the 3x3 cells around a position.
+// With the cell size at least the query radius, all the points within
+// the radius are found. Points from other cells sharing a bucket may be
+// returned too, so the caller must check the actual distance.
+//==================================================================
+class SpatialHashGrid
+{
+    float mInvCellSize = 1.0f;
+
+    uint32_t              mBucketsMask = 0;
+    std::vector<uint32_t> mBucketStart;  // Start of each bucket in mBucketItems (+1 for the end)
+    std::vector<uint32_t> mBucketItems;  // Items, sorted by bucket
+    std::vector<uint32_t> mItemBuckets;  // Bucket of each item
+    std::vector<uint32_t> mBucketFill;   // Scratch, for Build
+
+public:
+    explicit SpatialHashGrid(float cellSize = 1.0f)
+        : mInvCellSize(1.0f / cellSize)
+    {}
+
+    //==================================================================
+    // Rebuild the grid with "n" points (items are their indices)
+    // Points for which "isIncluded(idx)" is false are left out
+    template<typename IncludeFn>
+    void Build(const Vector2* pPoints, size_t n, const IncludeFn& isIncluded)
+    {
+        // Table size: power of two, at least twice the points
+        size_t bucketsN = 16;
+        while (bucketsN < n * 2)
+            bucketsN *= 2;
+        mBucketsMask = (uint32_t)(bucketsN - 1);
+
+        mBucketStart.assign(bucketsN + 1, 0);
+        mItemBuckets.resize(n);
+
+        // Count the points of each bucket
+        uint32_t includedN = 0;
+        for (size_t i=0; i < n; ++i)
+        {
+            if (!isIncluded(i))
+            {
+                mItemBuckets[i] = UINT32_MAX;
+                continue;
+            }
+            const auto bucket = calcBucket(calcCell(pPoints[i].x), calcCell(pPoints[i].y));
+            mItemBuckets[i] = bucket;
+            mBucketStart[bucket + 1] += 1;
+            includedN += 1;
+        }
+
+        // Prefix sum, then scatter the items in their buckets
+        for (size_t b=0; b < bucketsN; ++b)
+            mBucketStart[b + 1] += mBucketStart[b];
+
+        mBucketItems.resize(includedN);
+        mBucketFill.assign(mBucketStart.begin(), mBucketStart.end() - 1);
+        for (size_t i=0; i < n; ++i)
+        {
+            const auto bucket = mItemBuckets[i];
+            if (bucket != UINT32_MAX)
+                mBucketItems[mBucketFill[bucket]++] = (uint32_t)i;
+        }
+    }
+
+    //==================================================================
+    // Call "fn(itemIdx)" for each item in the cells around "pos"
+    // (each item once)
+    template<typename Fn>
+    void ForEachNear(const Vector2& pos, const Fn& fn) const
+    {
+        if (mBucketItems.empty())
+            return;
+
+        const auto cx = calcCell(pos.x);
+        const auto cy = calcCell(pos.y);
+
+        // Different cells may share a bucket, visit each bucket once
+        uint32_t visited[9];
+        size_t visitedN = 0;
+        for (int32_t dy = -1; dy <= 1; ++dy)
+        {
+            for (int32_t dx = -1; dx <= 1; ++dx)
+            {
+                const auto bucket = calcBucket(cx + dx, cy + dy);
+
+                bool isVisited = false;
+                for (size_t v=0; v < visitedN; ++v)
+                    isVisited = isVisited || visited[v] == bucket;
+                if (isVisited)
+                    continue;
+                visited[visitedN++] = bucket;
+
+                for (auto i = mBucketStart[bucket]; i < mBucketStart[bucket + 1]; ++i)
+                    fn((size_t)mBucketItems[i]);
+            }
+        }
+    }
+
+private:
+    int32_t calcCell(float v) const
+    {
+        return (int32_t)std::floor(v * mInvCellSize);
+    }
+
+    uint32_t calcBucket(int32_t cx, int32_t cy) const
+    {
+        // Hash of the cell coordinates (large primes, as in Teschner et al.)
+        const auto h = ((uint32_t)cx * 73856093u) ^ ((uint32_t)cy * 19349663u);
+        return h & mBucketsMask;
+    }
+};
+
+#endif
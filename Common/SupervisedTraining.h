@@ -0,0 +1,216 @@
+#ifndef SUPERVISED_TRAINING_H
+#define SUPERVISED_TRAINING_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "PolicySamples.h"
+#include "SimpleNeuralNet.h"
+
+//==================================================================
+// Supervised training
+// Trains a network to take the actions of samples of a policy (see
+// PolicySamples.h), by minibatch gradient descent (see
+// SimpleNeuralNet::Backward). The simulation only thresholds the
+// outputs at 0.5, so the loss is a squared hinge on each output: above
+// 0.5 + margin for the actions taken, below 0.5 - margin for the
+// others. Outputs past the margin are right, and don't pull on the
+// parameters, whatever their value.
+// Each minibatch is a step of an optimizer: AdamOptimizer, or
+// SgdOptimizer, or any class with the same Step().
+// States are in pixels, which gradient descent can't take as they are:
+// a network is trained on scaled states (see InputsScaling), and the
+// scaling is then folded in its first layer, to get the same network
+// on the states as they are.
+//==================================================================
+struct SupervisedParams
+{
+    size_t   epochsN = 10;   // Passes over the samples
+    size_t   batchSize = 64;
+    double   learningRate = 2e-3;
+    double   margin = 0.25;
+    uint32_t seed = 1234;    // Order of the samples
+};
+
+struct SupervisedStats
+{
+    double loss = 0;     // Mean, over the samples of the last epoch
+    double accuracy = 0; // Samples with all the actions right, same
+};
+
+//==================================================================
+// Inputs scaling: (state - mean) * invStd, to zero mean and unit variance
+struct InputsScaling
+{
+    PolicyState mean = PolicyState::Zero();
+    PolicyState invStd = PolicyState::Ones();
+
+    PolicyState Apply(const PolicyState& state) const { return (state - mean).cwiseProduct(invStd); }
+};
+
+inline InputsScaling CalcInputsScaling(const std::vector<PolicySample>& samples)
+{
+    InputsScaling scaling;
+    if (samples.empty())
+        return scaling;
+
+    Eigen::Vector<double, SIM_BRAINSTATE_N> sum = Eigen::Vector<double, SIM_BRAINSTATE_N>::Zero();
+    Eigen::Vector<double, SIM_BRAINSTATE_N> sumSq = Eigen::Vector<double, SIM_BRAINSTATE_N>::Zero();
+    for (const auto& s : samples)
+    {
+        const Eigen::Vector<double, SIM_BRAINSTATE_N> x = s.state.cast<double>();
+        sum += x;
+        sumSq += x.cwiseProduct(x);
+    }
+    const auto n = (double)samples.size();
+    for (int i=0; i < SIM_BRAINSTATE_N; ++i)
+    {
+        const auto mean = sum[i] / n;
+        const auto std = std::sqrt(std::max(sumSq[i] / n - mean * mean, 0.0));
+        scaling.mean[i] = (float)mean;
+        scaling.invStd[i] = std > 1e-6 ? (float)(1 / std) : 1.0f; // Constants are left as they are
+    }
+    return scaling;
+}
+
+// Parameters trained on scaled states -> the same network on states:
+// W x' + b = W diag(invStd) x + b - W diag(invStd) mean
+template<typename NeuralNet, typename T>
+void FoldInputsScaling(T* pFlatParams, const InputsScaling& scaling)
+{
+    using FirstLayer = std::tuple_element_t<0, typename NeuralNet::Parameters>;
+    constexpr int I = SIM_BRAINSTATE_N;
+    Eigen::Map<FirstLayer> layer(pFlatParams);
+    const Eigen::Vector<T, I> invStd = scaling.invStd.template cast<T>();
+    layer.template leftCols<I>() *= invStd.asDiagonal();
+    layer.col(I) -= layer.template leftCols<I>() * scaling.mean.template cast<T>();
+}
+
+//==================================================================
+// AdamOptimizer class - Adam, on flat parameters
+//==================================================================
+template<std::floating_point T>
+class AdamOptimizer
+{
+    static constexpr double BETA1 = 0.9;
+    static constexpr double BETA2 = 0.999;
+    static constexpr double EPSILON = 1e-8;
+
+    std::vector<T> mM; // Moving averages of the gradients
+    std::vector<T> mV; // and of their squares
+    size_t         mStepsN = 0;
+
+public:
+    explicit AdamOptimizer(size_t paramsN) : mM(paramsN, T(0)), mV(paramsN, T(0)) {}
+
+    void Step(T* pParams, const T* pGrads, double learningRate)
+    {
+        using Array = Eigen::Array<T, Eigen::Dynamic, 1>;
+        const auto n = (Eigen::Index)mM.size();
+        Eigen::Map<Array> params(pParams, n);
+        const Eigen::Map<const Array> grads(pGrads, n);
+        Eigen::Map<Array> m(mM.data(), n);
+        Eigen::Map<Array> v(mV.data(), n);
+
+        ++mStepsN;
+        m = T(BETA1) * m + T(1 - BETA1) * grads;
+        v = T(BETA2) * v + T(1 - BETA2) * grads.square();
+        // Bias corrections folded in the step size
+        const auto stepSize = learningRate * std::sqrt(1 - std::pow(BETA2, (double)mStepsN)) / (1 - std::pow(BETA1, (double)mStepsN));
+        params -= T(stepSize) * m / (v.sqrt() + T(EPSILON));
+    }
+};
+
+//==================================================================
+// SgdOptimizer class - SGD with momentum, on flat parameters
+// Plainer than Adam, and with one buffer less, but the learning rate
+// must suit the scale of the gradients (e.g. 0.02 for SupervisedParams'
+// loss, against 2e-3 with Adam)
+//==================================================================
+template<std::floating_point T>
+class SgdOptimizer
+{
+    double         mMomentum = 0.9;
+    std::vector<T> mVelocity;
+
+public:
+    explicit SgdOptimizer(size_t paramsN, double momentum = 0.9) : mMomentum(momentum), mVelocity(paramsN, T(0)) {}
+
+    void Step(T* pParams, const T* pGrads, double learningRate)
+    {
+        using Array = Eigen::Array<T, Eigen::Dynamic, 1>;
+        const auto n = (Eigen::Index)mVelocity.size();
+        Eigen::Map<Array> params(pParams, n);
+        const Eigen::Map<const Array> grads(pGrads, n);
+        Eigen::Map<Array> velocity(mVelocity.data(), n);
+
+        velocity = T(mMomentum) * velocity - T(learningRate) * grads;
+        params += velocity;
+    }
+};
+
+//==================================================================
+// Train the flat parameters of a network of type NeuralNet on the
+// samples, for par.epochsN epochs, returns the stats of the last one.
+// The parameters are for scaled states (see FoldInputsScaling)
+template<typename NeuralNet, typename T, typename Optimizer>
+SupervisedStats TrainOnSamples(T* pFlatParams, const std::vector<PolicySample>& samples, const InputsScaling& scaling,
+                               const SupervisedParams& par, Optimizer& optimizer, std::mt19937& rng)
+{
+    using Inputs = typename NeuralNet::Inputs;
+    using Outputs = typename NeuralNet::Outputs;
+    static_assert((int)Inputs::RowsAtCompileTime == (int)SIM_BRAINSTATE_N &&
+                  (int)Outputs::RowsAtCompileTime == (int)SIM_BRAINACTION_N, "A network of the lander");
+
+    SupervisedStats stats;
+    if (samples.empty())
+        return stats;
+
+    std::vector<uint32_t> order(samples.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::vector<T> grads(NeuralNet::CalcTotalParameters());
+    std::array<T, NeuralNet::TRACE_SIZE> trace;
+    const auto margin = T(par.margin);
+    const auto batchSize = std::max<size_t>(par.batchSize, 1);
+
+    for (size_t epoch=0; epoch < par.epochsN; ++epoch)
+    {
+        std::shuffle(order.begin(), order.end(), rng);
+        double lossSum = 0;
+        size_t rightN = 0;
+        for (size_t begin=0; begin < order.size(); begin += batchSize)
+        {
+            const auto end = std::min(begin + batchSize, order.size());
+            std::fill(grads.begin(), grads.end(), T(0));
+            for (size_t i=begin; i < end; ++i)
+            {
+                const auto& sample = samples[order[i]];
+                const Inputs inputs = scaling.Apply(sample.state).template cast<T>();
+                Outputs outputs;
+                NeuralNet::FeedForwardTrace(pFlatParams, inputs, trace.data(), outputs);
+
+                Outputs dOutputs;
+                bool isRight = true;
+                for (int a=0; a < SIM_BRAINACTION_N; ++a)
+                {
+                    const auto sign = (sample.actions >> a) & 1 ? T(1) : T(-1);
+                    const auto dist = margin - sign * (outputs[a] - T(0.5));
+                    lossSum += dist > 0 ? (double)(dist * dist) : 0.0;
+                    dOutputs[a] = dist > 0 ? T(-2) * sign * dist / T(end - begin) : T(0);
+                    isRight = isRight && dist < margin;
+                }
+                rightN += isRight;
+                NeuralNet::Backward(pFlatParams, inputs, trace.data(), dOutputs, grads.data());
+            }
+            optimizer.Step(pFlatParams, grads.data(), par.learningRate);
+        }
+        stats.loss = lossSum / (double)samples.size();
+        stats.accuracy = (double)rightN / (double)samples.size();
+    }
+    return stats;
+}
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef TINY_GEMV_H
+#define TINY_GEMV_H
+
+#include <type_traits>
+#include <utility>
+#include <Eigen/Dense>
+
+// Widest SIMD register Eigen uses
+#if defined(EIGEN_VECTORIZE_AVX512)
+    #define TGV_SIMD_BYTES 64
+#elif defined(EIGEN_VECTORIZE_AVX)
+    #define TGV_SIMD_BYTES 32
+#else
+    #define TGV_SIMD_BYTES 16 // SSE, NEON
+#endif
+
+// The unrolled kernels inline all they call: depending on the caller, GCC can leave
+// a call to the unrolled lambda, or to Eigen's unrolled loops, and then
+// the sums go through memory, and the layer is twice slower
+#if defined(__GNUC__)
+    #define TGV_FLATTEN __attribute__((flatten))
+#else
+    #define TGV_FLATTEN
+#endif
+
+//==================================================================
+// Kernels for small network layers
+// A layer computes outputs = activate(W * inputs + b), with its
+// parameters as in SimpleNeuralNet: an (O x I+1) column-major matrix,
+// the bias in the last column. At the sizes of the landers' networks
+// (10->12->12->3), Eigen's generic product, with the homogeneous()
+// input, spends more on its setup than on the math, so each layer is
+// computed by a kernel for its shape, picked at compile time by
+// SelectKernel:
+// - ColumnsKernel: outer product, unrolled over the inputs: each input
+//   adds its column of weights to the sums. Rows are padded to whole
+//   SIMD registers, so a column is a few multiply-adds with no tail
+// - DotKernel: a single output, its weights are contiguous, so it's a
+//   dot product in SIMD lanes
+// - EigenKernel: Eigen's product, for layers too large to unroll
+// activate() takes an Eigen array expression, so that the activation
+// is vectorized along with the sums (for ReLU: x.max(0)).
+// All the kernels compute the same, up to the order of the sums.
+//==================================================================
+namespace TinyGemv
+{
+    // Largest layer computed without Eigen, in parameters
+    inline constexpr int MAX_PARAMS_N = 4096;
+    // Most inputs to unroll
+    inline constexpr int MAX_INPUTS_N = 64;
+
+    template<typename T>
+    constexpr int MaxLanes() { return TGV_SIMD_BYTES / (int)sizeof(T); }
+
+    // Rows per register for a layer of O outputs: the widest register,
+    // narrowed until padding to it at most doubles the rows, so that
+    // loading a whole padded column stays inside the layer's parameters
+    // (the rows past O read the start of the next column, and are
+    // thrown away)
+    template<typename T, int O>
+    constexpr int CalcLanes()
+    {
+        int lanes = MaxLanes<T>();
+        while (lanes > 1 && (O + lanes - 1) / lanes * lanes > 2 * O)
+            lanes /= 2;
+        return lanes;
+    }
+
+    //==================================================================
+    template<typename T, int I, int O>
+    struct ColumnsKernel
+    {
+        static constexpr int LANES = CalcLanes<T, O>();
+        static constexpr int PO = (O + LANES - 1) / LANES * LANES; // Padded rows
+
+        TGV_FLATTEN static void Run(const T* pParams, const T* pInputs, T* pOutputs, const auto& activate)
+        {
+            using Column = Eigen::Array<T, PO, 1>;
+            using Bias = Eigen::Array<T, O, 1>;
+            const Eigen::Map<const Bias> bias(pParams + I * O);
+
+            // Even and odd inputs go to two sums, to halve the dependency
+            // chains. The bias is the initial sum, unless the rows are
+            // padded: the bias column is the last one, it can't be read
+            // padded, and setting part of a register goes through memory
+            Column s;
+            if constexpr (PO == O)
+                s = bias;
+            else
+                s.setZero();
+            Column t = Column::Zero();
+
+            // Unrolled over the inputs
+            [&]<int... Cs>(std::integer_sequence<int, Cs...>) {
+                (((Cs % 2 ? t : s) += Eigen::Map<const Column>(pParams + Cs * O) * pInputs[Cs]), ...);
+            }(std::make_integer_sequence<int, I>{});
+
+            Eigen::Map<Eigen::Array<T, O, 1>> outputs(pOutputs);
+            if constexpr (PO == O)
+                outputs = activate(s + t);
+            else
+                outputs = activate((s + t).template head<O>() + bias);
+        }
+    };
+
+    //==================================================================
+    template<typename T, int I, int O>
+    struct DotKernel
+    {
+        static_assert(O == 1, "DotKernel is for layers with a single output");
+
+        TGV_FLATTEN static void Run(const T* pParams, const T* pInputs, T* pOutputs, const auto& activate)
+        {
+            using Vec = Eigen::Array<T, I, 1>;
+            const T sum = (Eigen::Map<const Vec>(pParams) * Eigen::Map<const Vec>(pInputs)).sum() + pParams[I];
+            Eigen::Map<Eigen::Array<T, 1, 1>> outputs(pOutputs);
+            outputs = activate(Eigen::Array<T, 1, 1>::Constant(sum));
+        }
+    };
+
+    //==================================================================
+    template<typename T, int I, int O>
+    struct EigenKernel
+    {
+        static void Run(const T* pParams, const T* pInputs, T* pOutputs, const auto& activate)
+        {
+            const Eigen::Map<const Eigen::Matrix<T, O, I+1>> params(pParams);
+            const Eigen::Map<const Eigen::Vector<T, I>> inputs(pInputs);
+            Eigen::Map<Eigen::Array<T, O, 1>> outputs(pOutputs);
+            outputs = activate((params * inputs.homogeneous()).array());
+        }
+    };
+
+    //==================================================================
+    template<typename T, int I, int O>
+    using SelectKernel =
+        std::conditional_t<O == 1,                                             DotKernel<T, I, O>,
+        std::conditional_t<((I + 1) * O > MAX_PARAMS_N || I > MAX_INPUTS_N), EigenKernel<T, I, O>,
+                                                                               ColumnsKernel<T, I, O>>>;
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef TRAINING_TASK_DISTILL_H
+#define TRAINING_TASK_DISTILL_H
+
+#include <functional>
+#include <random>
+#include <vector>
+#include "FixedBrain.h"
+#include "PolicySamples.h"
+#include "SupervisedTraining.h"
+
+//==================================================================
+// TrainingTaskDistill class - trains a network to act as a teacher
+// The teacher is any policy, typically a larger network, and the
+// student a network of architecture netArch: wide networks can be
+// searched by GA or ES, and narrow ones deployed.
+// Each iteration is a round:
+// - fly the sample scenarios, and label each state met with the
+//   teacher's actions. The first round is flown by the teacher, the
+//   next ones by the student, so that it learns to recover from the
+//   states its own mistakes lead to (DAgger)
+// - train the student on all the samples so far (see
+//   SupervisedTraining.h), with the inputs scaling of the first round
+// The sample scenarios should be other than the ones the student is
+// measured on (see MeasurePolicyAgreement).
+//==================================================================
+struct TrainingTaskDistillParams
+{
+    size_t           roundsN = 4;
+    size_t           scenariosN = 300;           // Flown each round
+    uint64_t         samplesStartSeed = 2000000; // Not the trainers' seeds
+    SupervisedParams supervised;
+    uint32_t         seed = 1234;                // Initial student
+};
+
+template<std::floating_point T, NetArch auto netArch>
+class TrainingTaskDistill
+{
+public:
+    using NeuralNet = SimpleNeuralNet<T, netArch>;
+    static constexpr auto NET_ARCH = netArch;
+    using Policy = std::function<void(const PolicyState&, PolicyActions&)>;
+
+private:
+    TrainingTaskDistillParams mPar;
+    SimRolloutContext         mCtx;
+    ScenarioBank              mScenarios;
+    Policy                    mTeacher;
+
+    std::vector<T>            mParams;    // Trained, for scaled states
+    std::vector<T>            mNetParams; // The student, the scaling folded in
+    InputsScaling             mScaling;
+    AdamOptimizer<T>          mOptimizer;
+    std::mt19937              mRng;
+    std::vector<PolicySample> mSamples;
+    size_t                    mCurRound = 0;
+    SupervisedStats           mLastStats;
+
+public:
+    TrainingTaskDistill(const TrainingTaskDistillParams& par, const SimParams& sp, Policy teacher)
+        : mPar(par)
+        , mCtx(sp)
+        , mScenarios(sp, par.samplesStartSeed, par.scenariosN)
+        , mTeacher(std::move(teacher))
+        , mParams(NeuralNet::CalcTotalParameters())
+        , mNetParams(NeuralNet::CalcTotalParameters())
+        , mOptimizer(NeuralNet::CalcTotalParameters())
+        , mRng(par.supervised.seed)
+    {
+        NeuralNet net;
+        net.InitializeRandomParameters(par.seed);
+        net.CopyParametersTo(mParams.data());
+        // Outputs start at the threshold, undecided: below 0, a ReLU
+        // output would get no gradient
+        constexpr auto LAST_LAYER = NeuralNet::LAYERS_N - 1;
+        constexpr int I = netArch[LAST_LAYER];
+        Eigen::Map<Eigen::Matrix<T, netArch[LAST_LAYER + 1], I + 1>> lastLayer(mParams.data() + NeuralNet::CalcLayerOffset(LAST_LAYER));
+        lastLayer.col(I).setConstant(T(0.5));
+        mNetParams = mParams;
+    }
+
+    void RunIteration()
+    {
+        if (IsTrainingComplete())
+            return;
+
+        if (mCurRound == 0)
+        {
+            CollectPolicySamples(mCtx, mScenarios, mTeacher, mTeacher, mSamples);
+            mScaling = CalcInputsScaling(mSamples);
+        }
+        else
+            CollectPolicySamples(mCtx, mScenarios, GetStudentPolicy(), mTeacher, mSamples);
+
+        mLastStats = TrainOnSamples<NeuralNet>(mParams.data(), mSamples, mScaling, mPar.supervised, mOptimizer, mRng);
+        mNetParams = mParams;
+        FoldInputsScaling<NeuralNet>(mNetParams.data(), mScaling);
+        ++mCurRound;
+    }
+
+    bool IsTrainingComplete() const { return mCurRound >= mPar.roundsN; }
+    size_t GetCurrentRound() const { return mCurRound; }
+    size_t GetSamplesN() const { return mSamples.size(); }
+    const SupervisedStats& GetLastStats() const { return mLastStats; }
+
+    NeuralNet GetStudentNetwork() const
+    {
+        NeuralNet net;
+        net.SetParametersFrom(mNetParams.data());
+        return net;
+    }
+
+    // The student as it is now, valid as long as the trainer
+    auto GetStudentPolicy() const
+    {
+        return [this](const PolicyState& state, PolicyActions& actions) {
+            typename NeuralNet::Outputs outputs;
+            NeuralNet::FeedForward(mNetParams.data(), state.template cast<T>(), outputs);
+            actions = outputs.template cast<float>();
+        };
+    }
+};
+
+//==================================================================
+// A network of architecture netArch cloned from the rule-based brain
+// (see FixedBrain.h), to start the trainers from instead of random
+// networks (see TrainingTaskGA::SetInitialNetwork): they don't have to
+// find out again that thrusting when falling fast is good
+template<std::floating_point T, NetArch auto netArch>
+SimpleNeuralNet<T, netArch> CloneFixedBrain(const TrainingTaskDistillParams& par = {}, const SimParams& sp = {})
+{
+    TrainingTaskDistill<T, netArch> task(par, sp, GetFixedBrainActions);
+    while (!task.IsTrainingComplete())
+        task.RunIteration();
+    return task.GetStudentNetwork();
+}
+
+#endif
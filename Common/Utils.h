@@ -82,6 +82,11 @@ public:
 
 //==================================================================
 // ParallelTasks class - handles parallel execution of tasks
+// Tasks are either:
+// - single tasks (AddTask), queued and run by the first free thread
+// - batches of indexed tasks (ForEach), that the threads pick by index
+//   until the batch is done. A batch doesn't allocate anything, so it
+//   can be used in loops that must not touch the heap.
 //==================================================================
 
 class ParallelTasks
@@ -94,6 +99,15 @@ class ParallelTasks
     bool mTerminate = false;
     std::atomic<int> mRunningTaskCount = 0;
 
+    // Current batch of indexed tasks (see ForEach)
+    void (*mpBatchInvoke)(const void*, size_t) = nullptr;
+    const void*         mpBatchFn = nullptr;
+    size_t              mBatchTasksN = 0;
+    std::atomic<size_t> mBatchNextIdx = 0;
+    uint64_t            mBatchGeneration = 0; // Changes with each batch
+    bool                mIsBatchOpen = false; // Threads can still join it
+    std::atomic<int>    mBatchWorkersN = 0;   // Threads working on the batch
+
 public:
     ParallelTasks()
     {
@@ -101,26 +115,58 @@ public:
         for (auto& el : mThreads)
         {
             el = std::thread([&]() {
+                uint64_t seenBatchGeneration = 0;
                 while (true)
                 {
                     std::function<void()> task;
+                    bool isBatchWorker = false;
                     {
                         std::unique_lock<std::mutex> lock(mMutex);
-                        mCondVar.wait(lock, [this]() { return mTerminate || mTasks.empty() == false; });
+                        mCondVar.wait(lock, [&]() {
+                            return mTerminate ||
+                                   mTasks.empty() == false ||
+                                   seenBatchGeneration != mBatchGeneration;
+                        });
                         if (mTerminate)
                             break;
-                        task = std::move(mTasks.front());
-                        mTasks.pop();
+
+                        if (seenBatchGeneration != mBatchGeneration)
+                        {
+                            // Join the batch, unless it's already over
+                            seenBatchGeneration = mBatchGeneration;
+                            isBatchWorker = mIsBatchOpen;
+                            if (isBatchWorker)
+                                mBatchWorkersN++;
+                        }
+                        else
+                        {
+                            task = std::move(mTasks.front());
+                            mTasks.pop();
+                            mRunningTaskCount++;
+                        }
+                    }
+
+                    if (isBatchWorker)
+                    {
+                        runBatchTasks();
+                        mBatchWorkersN--;
+                        mBatchWorkersN.notify_all();
+                    }
+                    else
+                    if (task)
+                    {
+                        task();
+                        mRunningTaskCount--;
+                        mRunningTaskCount.notify_all();
                     }
-                    mRunningTaskCount++;
-                    task();
-                    mRunningTaskCount--;
-                    mRunningTaskCount.notify_all();
                 }
             });
         }
     }
 
+    // Number of worker threads
+    size_t GetThreadsN() const { return mThreads.size(); }
+
     void AddTask(const std::function<void()>& task)
     {
         {
@@ -150,6 +196,41 @@ public:
             mRunningTaskCount.wait(old);
     }
 
+    //==================================================================
+    // Run "fn(taskIdx)" for each taskIdx in [0, tasksN), on the worker
+    // threads and the calling one, and wait for all of them to complete
+    // "fn" must be safe to call from multiple threads. One batch runs at
+    // a time.
+    template<typename Fn>
+    void ForEach(size_t tasksN, const Fn& fn)
+    {
+        if (tasksN == 0)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mpBatchInvoke = [](const void* pFn, size_t idx) { (*(const Fn*)pFn)(idx); };
+            mpBatchFn = &fn;
+            mBatchTasksN = tasksN;
+            mBatchNextIdx = 0;
+            mBatchGeneration += 1;
+            mIsBatchOpen = true;
+        }
+        mCondVar.notify_all();
+
+        runBatchTasks();
+
+        // All the tasks have been picked: close the batch, and wait for
+        // the ones still running
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mIsBatchOpen = false;
+        }
+        int old;
+        while ((old = mBatchWorkersN) > 0)
+            mBatchWorkersN.wait(old);
+    }
+
     ~ParallelTasks()
     {
         {
@@ -160,6 +241,14 @@ public:
         for (auto& t : mThreads)
             t.join();
     }
+
+private:
+    void runBatchTasks()
+    {
+        size_t idx;
+        while ((idx = mBatchNextIdx++) < mBatchTasksN)
+            mpBatchInvoke(mpBatchFn, idx);
+    }
 };
 
 #endif
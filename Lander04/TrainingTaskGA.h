@@ -2,6 +2,7 @@
 #define TRAININGTASKGA_H
 
 #include <future>
+#include <memory>
 #include <mutex>
 #include <random>
 #include <algorithm>
@@ -9,6 +10,11 @@
 #include <limits> // Needed for numeric_limits
 #include <thread>
 #include "Utils.h"
+#include "BatchEvaluator.h"
+#include "Checkpoint.h"
+#include "ParamStorage.h"
+#include "ScenarioBank.h"
+#include "SimRollout.h"
 #include "SimpleNeuralNet.h"
 #include "Simulation.h"
 
@@ -16,34 +22,30 @@
 
 //==================================================================
 // TrainingTaskGA class - handles neural network training using genetic algorithms
+// "ParamStorageT" is the type of the population parameters: T, or a
+// 16 bit type to halve the population memory (see ParamStorage.h)
 //==================================================================
-template<std::floating_point T, NetArch auto netArch>
+template<std::floating_point T, NetArch auto netArch, typename ParamStorageT = T>
+    requires ParamStorageFor<ParamStorageT, T>
 class TrainingTaskGA
 {
 public:
     using NeuralNet = SimpleNeuralNet<T, netArch>;
+    using ParamStorage = ParamStorageT;
+    static constexpr auto NET_ARCH = netArch;
 
-private:
-    // Individual struct - represents a single member of the population
-    struct Individual
-    {
-        NeuralNet network; // Neural network object
-        double fitness = -std::numeric_limits<double>::max();  // Fitness score (-infinity by default)
-        
-        Individual() = default;
-
-        // Constructor with existing network and optional fitness
-        Individual(const  NeuralNet& net, double fitnessScore = -std::numeric_limits<double>::max())
-            : network(net), fitness(fitnessScore)
-        {
-        }
-
-        // Comparison operator for sorting by fitness (descending order)
-        inline bool operator<(const Individual& other) const { return fitness > other.fitness; }
-    };
+    // Inputs beyond the simulation state are raycast sensors (see SimRaySensors)
+    static constexpr int SIM_RAYS_N = netArch[0] - SIM_BRAINSTATE_N;
+    static_assert(SIM_RAYS_N >= 0, "The network needs all the simulation state inputs");
 
 private:
-    SimParams mSimParams;
+    // Number of parameters of each individual
+    static constexpr size_t PARAMS_N = NeuralNet::CalcTotalParameters();
+
+    // Parameters and options shared by all the rollouts
+    SimRolloutContext mSimContext;
+    // Same, with coarse physics (see SetCoarseFidelity)
+    SimRolloutContext mSimContextCoarse;
 
     // Training parameters
     size_t  mMaxGenerations = 0;     // Maximum number of generations
@@ -52,13 +54,39 @@ private:
     double  mMutationRate = 0.1;     // Probability of mutation
     double  mMutationStrength = 0.3; // Scale of mutation
     double  mElitePercentage = 0.1;  // Percentage of top individuals to keep unchanged
+    T       mParamLimit = T(1);      // Mutations keep parameters within +/- this (see SetInitialNetwork)
+    // Multi-fidelity evaluation (see SetCoarseFidelity)
+    bool    mIsCoarsePhase = false;      // Evaluating with coarse physics
+    size_t  mCoarsePlateauGensN = 0;     // Generations without improvement to end it
+    size_t  mGensWithoutImprovementN = 0;
     // Number of simulations to run for each individual
     // More variants -> more accurate evaluation (helps prevent overfitting)
     static constexpr size_t SIM_VARIANTS_N = 30;
+    static constexpr uint32_t SIM_START_SEED = 1134;
+    // Layouts of the simulation variants (generated once, shared by all evaluations)
+    std::shared_ptr<const ScenarioBank> mScenarios;
 
     // Population
-    std::vector<Individual> mPopulation;
-    Individual mBestIndividual;
+    // Individuals are not objects, but rows of flat arrays: the parameters
+    // of individual i are at mPopParams[i * PARAMS_N] (see SimpleNeuralNet's
+    // flat parameters layout) and its fitness is mPopFitness[i].
+    // This keeps the population compact and cheap to turn over, so that
+    // it can scale to 100k+ individuals.
+    // Parameters are stored as ParamStorage, the genetic operators and
+    // the networks compute with T.
+    std::vector<ParamStorage> mPopParams;
+    std::vector<double>   mPopFitness;
+    std::vector<ParamStorage> mNextPopParams; // Next generation (double buffer)
+    // Expected simulation steps of each individual, used to schedule the
+    // evaluation longest-expected-first. Measured during evaluation and
+    // inherited by children from their parents.
+    std::vector<float>    mPopStepsEst;
+    std::vector<float>    mNextPopStepsEst;
+    std::vector<uint32_t> mRankIdx;       // Individuals indices, for elites selection
+    std::vector<double>   mEliteFitness;  // Full fidelity fitness of the elites
+
+    NeuralNet mBestNetwork;
+    double    mBestFitness = -std::numeric_limits<double>::max();
     std::mutex mBestIndividualMtx;
 
     // Random number generator
@@ -66,9 +94,31 @@ private:
 
     // Parallelization system
     ParallelTasks mPllTasks;
+    BatchEvaluator mEvaluator {mPllTasks};
 
     std::thread mTrainingThread;
 
+    // Checkpoints saved by the training thread (see SetCheckpointFile)
+    std::string mCheckpointPath;
+    size_t      mCheckpointEveryGensN = 0;
+
+    // Scalar state, in checkpoints. Its layout changes bump its own
+    // version, not Checkpoint::FILE_VERSION
+    static constexpr uint64_t STATE_VERSION = 2; // 2: paramLimit
+    struct CheckpointState
+    {
+        uint64_t version = STATE_VERSION;
+        uint64_t populationSize = 0;
+        uint64_t paramsN = 0;
+        uint64_t paramsStorage = 0; // See GetParamStorageId
+        uint64_t currentGeneration = 0;
+        uint64_t isCoarsePhase = 0;
+        uint64_t gensWithoutImprovementN = 0;
+        double   bestFitness = 0;
+        double   paramLimit = 1; // See SetInitialNetwork
+    };
+    static_assert(std::is_trivially_copyable_v<std::mt19937>, "The RNG state is stored as raw bytes");
+
 public:
     TrainingTaskGA(
         const SimParams& sp,
@@ -76,18 +126,27 @@ public:
         size_t populationSize,
         double mutationRate,
         double mutationStrength,
-        uint32_t seed = 1234)
-        : mSimParams(sp)
+        uint32_t seed = 1234,
+        const SimRunOptions& ro = {})
+        : mSimContext(sp, ro)
+        , mSimContextCoarse(sp, ro)
         , mMaxGenerations(maxGenerations)
         , mPopulationSize(populationSize)
         , mMutationRate(mutationRate)
         , mMutationStrength(mutationStrength)
-        , mBestIndividual() // Initialize before mRng to match declaration order
+        , mScenarios(std::make_shared<const ScenarioBank>(sp, SIM_START_SEED, SIM_VARIANTS_N))
         , mRng(seed)
     {
         // Here we create the initial population, with random networks
+        mPopParams.resize(mPopulationSize * PARAMS_N);
+        mNextPopParams.resize(mPopulationSize * PARAMS_N);
+        mPopFitness.assign(mPopulationSize, -std::numeric_limits<double>::max());
+        mPopStepsEst.assign(mPopulationSize, 0.0f);
+        mNextPopStepsEst.assign(mPopulationSize, 0.0f);
+        mRankIdx.resize(mPopulationSize);
 
         // Generate random networks for each individual
+        std::array<T, PARAMS_N> netParams;
         for (size_t i=0; i < mPopulationSize; ++i)
         {
             // Create a network
@@ -96,14 +155,16 @@ public:
             // Note: Xavier/He init could be added to InitializeRandomParameters if needed
             net.InitializeRandomParameters(mRng()); // Use the member RNG
 
-            // Create an individual with the generated network
-            mPopulation.emplace_back(net);
+            // Store it as the individual's parameters
+            net.CopyParametersTo(netParams.data());
+            StoreParams(netParams.data(), getIndividualParams(i), PARAMS_N);
         }
     }
 
     ~TrainingTaskGA()
     {
-        mTrainingThread.join();
+        if (mTrainingThread.joinable())
+            mTrainingThread.join();
     }
 
     void startTraining(bool useThread = true)
@@ -112,10 +173,148 @@ public:
             while (IsTrainingComplete() == false)
             {
                 RunIteration(useThread);
+
+                if (mCheckpointEveryGensN && (mCurrentGeneration % mCheckpointEveryGensN == 0 || IsTrainingComplete()))
+                    SaveCheckpoint(mCheckpointPath);
             }
         });
     }
 
+    //==================================================================
+    // Checkpoints
+    // A checkpoint holds everything the next generations depend on: the
+    // population with its fitness, the best network, the generation
+    // counter, the fidelity phase, the mutations limit and the state of
+    // the RNG. Training resumed from a checkpoint continues exactly, bit
+    // for bit, as it would have without the interruption.
+    // The options (constructor and SetCoarseFidelity) are not saved:
+    // create the trainer with the same ones, then load the checkpoint.
+    // The best network is stored as a plain network (see
+    // Checkpoint::LoadNetworkFromFile), for viewers to load it.
+    // Call these between iterations, not while training is running
+    //==================================================================
+    bool SaveCheckpoint(const std::string& path)
+    {
+        CheckpointState st;
+        st.populationSize = mPopulationSize;
+        st.paramsN = PARAMS_N;
+        st.paramsStorage = GetParamStorageId<ParamStorage>();
+        st.currentGeneration = mCurrentGeneration;
+        st.isCoarsePhase = mIsCoarsePhase;
+        st.gensWithoutImprovementN = mGensWithoutImprovementN;
+        st.paramLimit = (double)mParamLimit;
+
+        CheckpointWriter writer;
+        {
+            std::lock_guard<std::mutex> lock(mBestIndividualMtx);
+            st.bestFitness = mBestFitness;
+            Checkpoint::AddNetwork(writer, mBestNetwork);
+        }
+        writer.AddValue("ga_state", st);
+        writer.AddValue("ga_rng", mRng);
+        writer.AddArray("ga_pop_params", mPopParams.data(), mPopParams.size());
+        writer.AddArray("ga_pop_fitness", mPopFitness.data(), mPopFitness.size());
+        writer.AddArray("ga_pop_steps", mPopStepsEst.data(), mPopStepsEst.size());
+        return writer.SaveToFile(path);
+    }
+
+    bool LoadCheckpoint(const std::string& path)
+    {
+        CheckpointReader reader;
+        if (!reader.LoadFromFile(path))
+            return false;
+
+        CheckpointState st;
+        NeuralNet bestNet;
+        const auto isCompatible =
+            reader.ReadValue("ga_state", st) &&
+            st.version == STATE_VERSION &&
+            st.populationSize == mPopulationSize &&
+            st.paramsN == PARAMS_N &&
+            st.paramsStorage == GetParamStorageId<ParamStorage>() &&
+            Checkpoint::ReadNetwork(reader, bestNet);
+
+        const auto* pRng = isCompatible ? reader.FindArray<std::mt19937>("ga_rng", 1) : nullptr;
+        const auto* pParams = reader.FindArray<ParamStorage>("ga_pop_params", mPopParams.size());
+        const auto* pFitness = reader.FindArray<double>("ga_pop_fitness", mPopFitness.size());
+        const auto* pStepsEst = reader.FindArray<float>("ga_pop_steps", mPopStepsEst.size());
+        if (!pRng || !pParams || !pFitness || !pStepsEst)
+        {
+            printf("The checkpoint file %s doesn't match this training\n", path.c_str());
+            return false;
+        }
+
+        std::copy(pParams, pParams + mPopParams.size(), mPopParams.begin());
+        std::copy(pFitness, pFitness + mPopFitness.size(), mPopFitness.begin());
+        std::copy(pStepsEst, pStepsEst + mPopStepsEst.size(), mPopStepsEst.begin());
+        std::memcpy((void*)&mRng, pRng, sizeof(mRng));
+        mCurrentGeneration = (size_t)st.currentGeneration;
+        mIsCoarsePhase = st.isCoarsePhase != 0;
+        mGensWithoutImprovementN = (size_t)st.gensWithoutImprovementN;
+        mParamLimit = (T)st.paramLimit;
+        {
+            std::lock_guard<std::mutex> lock(mBestIndividualMtx);
+            mBestFitness = st.bestFitness;
+            mBestNetwork = bestNet;
+        }
+        return true;
+    }
+
+    // Have the training thread save a checkpoint every "everyGensN"
+    // generations, and at the end (0 for none)
+    // Call it before training
+    void SetCheckpointFile(const std::string& path, size_t everyGensN)
+    {
+        mCheckpointPath = path;
+        mCheckpointEveryGensN = path.empty() ? 0 : everyGensN;
+    }
+
+    //==================================================================
+    // Multi-fidelity evaluation
+    // Early generations are mostly about weeding out hopeless networks,
+    // so coarse physics ("subStepsN" steps at a time, see
+    // SimRolloutT::animCoarse) is enough to rank them. Elites are
+    // always re-evaluated at full fidelity, so the best network and its
+    // score are never coarse ones (see reevaluateElites).
+    // Once the best score doesn't improve for "plateauGensN" generations,
+    // the whole population is evaluated at full fidelity.
+    // Call it before training
+    void SetCoarseFidelity(uint32_t subStepsN, size_t plateauGensN)
+    {
+        mSimContextCoarse = SimRolloutContext(mSimContext.sp, mSimContext.ro, subStepsN);
+        mCoarsePlateauGensN = plateauGensN;
+        mIsCoarsePhase = subStepsN > 1;
+        mGensWithoutImprovementN = 0;
+    }
+
+    bool IsCoarsePhase() const { return mIsCoarsePhase; }
+
+    //==================================================================
+    // Warm start
+    // Start from a network (e.g. one cloned from the rule-based brain,
+    // see CloneFixedBrain) instead of random ones: the first individual
+    // is the network, and the others mutations of it, so the population
+    // starts around a network that already flies.
+    // Mutations keep the parameters within the largest one of the
+    // network, if it's more than 1: a network trained by gradient
+    // descent has no reason to fit in the range of random ones. The
+    // limit is in checkpoints, so a warm started training can resume
+    // without the initial network.
+    // Call it before training (a checkpoint loaded after it wins)
+    void SetInitialNetwork(const NeuralNet& net)
+    {
+        std::array<T, PARAMS_N> netParams;
+        net.CopyParametersTo(netParams.data());
+        for (const auto param : netParams)
+            mParamLimit = std::max(mParamLimit, std::abs(param));
+        for (size_t i=0; i < mPopulationSize; ++i)
+        {
+            StoreParams(netParams.data(), getIndividualParams(i), PARAMS_N);
+            if (i > 0)
+                mutate(getIndividualParams(i));
+        }
+    }
+
     //==================================================================
     // Run a single training iteration (one generation)
     void RunIteration(bool useThread = true)
@@ -127,132 +326,192 @@ public:
         // Evaluate the fitness of the population
         evaluatePopulation(useThread);
 
-        // Sort the population by fitness (descending)
-        std::sort(mPopulation.begin(), mPopulation.end());
-        
+        // Find the best individual of this generation (no need to sort everything)
+        // With coarse physics, only the elites have a full fidelity score
+        size_t bestIdx = 0;
+        double bestFitness = 0;
+        if (mIsCoarsePhase)
+        {
+            const auto bestIt = std::max_element(mEliteFitness.begin(), mEliteFitness.end());
+            bestIdx = mRankIdx[(size_t)(bestIt - mEliteFitness.begin())];
+            bestFitness = *bestIt;
+        }
+        else
+        {
+            bestIdx = (size_t)(std::max_element(mPopFitness.begin(), mPopFitness.end()) - mPopFitness.begin());
+            bestFitness = mPopFitness[bestIdx];
+        }
+
+        bool isImproved = false;
         {
             std::lock_guard<std::mutex> lock(mBestIndividualMtx);
 
             // Update best individual if necessary
-            if (mPopulation[0].fitness > mBestIndividual.fitness)
+            if (bestFitness > mBestFitness)
             {
-                mBestIndividual = mPopulation[0];
+                mBestFitness = bestFitness;
+                std::array<T, PARAMS_N> bestParams;
+                LoadParams(getIndividualParams(bestIdx), bestParams.data(), PARAMS_N);
+                mBestNetwork.SetParametersFrom(bestParams.data());
+                isImproved = true;
             }
         }
 
+        // Switch to full fidelity once the coarse phase stops improving
+        if (mIsCoarsePhase)
+        {
+            mGensWithoutImprovementN = isImproved ? 0 : mGensWithoutImprovementN + 1;
+            if (mGensWithoutImprovementN >= mCoarsePlateauGensN)
+                mIsCoarsePhase = false;
+        }
+
         // Increment the generation counter
         mCurrentGeneration += 1;
     }
 
     //==================================================================
     // Evaluate fitness for all individuals in the population
+    // Individuals are evaluated in place (see BatchEvaluator for how
+    // the work is split between threads)
     void evaluatePopulation(bool useThread = true)
     {
-        const uint32_t simStartSeed = 1134;
+        const auto isCoarse = mIsCoarsePhase;
 
-        // Evaluate each individual's fitness in parallel
-        for (auto& individual : mPopulation)
-        {
-            auto task = [&]() {
-                double sum = 0.0;
-                for (size_t i = 0; i < SIM_VARIANTS_N; ++i)
-                {
-                    const auto variantSeed = simStartSeed + (uint32_t)i;
-                    // Pass the individual's network directly
-                    sum += TestNetworkOnSimulation(variantSeed, individual.network);
-                }
-
-                individual.fitness = sum / (double)SIM_VARIANTS_N;
-            };
-            if (useThread)
-                mPllTasks.AddTask(task);
-            else
-                task();
-        }
-        if (useThread)
-            mPllTasks.WaitAll();
+        mEvaluator.Evaluate(mPopulationSize, mScenarios->GetSize(),
+            [&](size_t idx, size_t variantIdx)
+            {
+                BatchEvalResult res;
+                // Pass the individual's parameters directly
+                res.score = TestNetworkOnSimulation(mScenarios->GetScenario(variantIdx), getIndividualParams(idx), &res.stepsN, isCoarse);
+                return res;
+            },
+            mPopFitness.data(),
+            useThread,
+            mPopStepsEst.data(),  // Longest-expected-first...
+            mPopStepsEst.data()); // ...and measure for the next generation
+
+        if (isCoarse)
+            reevaluateElites(useThread);
     }
 
     //==================================================================
-    // Create a new generation through selection, crossover and mutation
-    void evolve()
+    // Re-evaluate at full fidelity the individuals with the best coarse
+    // fitness, leaving their indices at the start of mRankIdx
+    // Their full fidelity fitness goes to mEliteFitness: it selects the
+    // best network, but selection within the population keeps comparing
+    // coarse fitness with coarse fitness.
+    void reevaluateElites(bool useThread)
     {
-        // Keep track of the original population
-        std::vector<Individual> oldPopulation = mPopulation;
+        const size_t eliteCount = std::max<size_t>(1, calcEliteCount());
+
+        std::iota(mRankIdx.begin(), mRankIdx.end(), 0);
+        const auto byFitness = [&](uint32_t a, uint32_t b) { return mPopFitness[a] > mPopFitness[b]; };
+        if (eliteCount < mPopulationSize)
+            std::nth_element(mRankIdx.begin(), mRankIdx.begin() + (eliteCount - 1), mRankIdx.end(), byFitness);
 
-        // Clear the population for the new generation
-        mPopulation.clear();
+        mEliteFitness.resize(eliteCount);
+        mEvaluator.Evaluate(eliteCount, mScenarios->GetSize(),
+            [&](size_t i, size_t variantIdx)
+            {
+                BatchEvalResult res;
+                res.score = TestNetworkOnSimulation(mScenarios->GetScenario(variantIdx), getIndividualParams(mRankIdx[i]), &res.stepsN);
+                return res;
+            },
+            mEliteFitness.data(),
+            useThread);
+    }
 
+    size_t calcEliteCount() const
+    {
+        return std::min(static_cast<size_t>(mPopulationSize * mElitePercentage), mPopulationSize);
+    }
+
+    //==================================================================
+    // Create a new generation through selection, crossover and mutation
+    // The new generation is written in the second buffer, which is then
+    // swapped with the current one, so nothing is reallocated
+    void evolve()
+    {
         // Calculate number of elite individuals to keep unchanged
-        const size_t eliteCount = static_cast<size_t>(mPopulationSize * mElitePercentage);
+        const size_t eliteCount = calcEliteCount();
+
+        // Partially sort the indices, so that the first eliteCount are the best ones
+        std::iota(mRankIdx.begin(), mRankIdx.end(), 0);
+        const auto byFitness = [&](uint32_t a, uint32_t b) { return mPopFitness[a] > mPopFitness[b]; };
+        if (eliteCount > 0 && eliteCount < mPopulationSize)
+            std::nth_element(mRankIdx.begin(), mRankIdx.begin() + (eliteCount - 1), mRankIdx.end(), byFitness);
+        std::sort(mRankIdx.begin(), mRankIdx.begin() + eliteCount, byFitness);
 
         // Keep elite individuals
-        for (size_t i = 0; i < eliteCount && i < oldPopulation.size(); ++i)
+        size_t newIdx = 0;
+        for (; newIdx < eliteCount; ++newIdx)
         {
-            mPopulation.push_back(oldPopulation[i]);
+            const ParamStorage* pSrc = getIndividualParams(mRankIdx[newIdx]);
+            std::copy(pSrc, pSrc + PARAMS_N, &mNextPopParams[newIdx * PARAMS_N]);
+            mNextPopStepsEst[newIdx] = mPopStepsEst[mRankIdx[newIdx]];
         }
 
         // Fill the rest of the population with offspring from crossover
-        while (mPopulation.size() < mPopulationSize)
+        for (; newIdx < mPopulationSize; ++newIdx)
         {
             // Select two parents
-            const auto& parent1 = SelectParent(oldPopulation);
-            const auto& parent2 = SelectParent(oldPopulation);
+            const auto parent1 = SelectParent();
+            const auto parent2 = SelectParent();
+
+            ParamStorage* pChild = &mNextPopParams[newIdx * PARAMS_N];
 
             // Perform crossover
-            Individual child = Crossover(parent1, parent2);
+            Crossover(getIndividualParams(parent1), getIndividualParams(parent2), pChild);
 
             // Perform mutation
-            mutate(child);
+            mutate(pChild);
 
-            // Add the child to the new population
-            mPopulation.push_back(child);
+            // The child is expected to behave like its parents
+            mNextPopStepsEst[newIdx] = (mPopStepsEst[parent1] + mPopStepsEst[parent2]) * 0.5f;
         }
+
+        // The new generation becomes the current one
+        std::swap(mPopParams, mNextPopParams);
+        std::swap(mPopStepsEst, mNextPopStepsEst);
+        std::fill(mPopFitness.begin(), mPopFitness.end(), -std::numeric_limits<double>::max());
     }
 
     //==================================================================
     // Select a parent using tournament selection
-    const Individual& SelectParent(const std::vector<Individual>& population)
+    // Contestants are drawn with replacement, which keeps this O(1)
+    // regardless of the population size
+    size_t SelectParent()
     {
         // Number of individuals to consider in the tournament
         const size_t tournamentSize = 3;
 
-        // Select random individuals for the tournament
-        std::vector<size_t> indices(population.size());
-        std::iota(indices.begin(), indices.end(), 0);
-        std::shuffle(indices.begin(), indices.end(), mRng);
+        std::uniform_int_distribution<size_t> idxDist(0, mPopulationSize - 1);
 
         // Find the best individual among those selected
-        size_t bestIdx = indices[0];
-        for (size_t i = 1; i < tournamentSize && i < indices.size(); ++i)
+        size_t bestIdx = idxDist(mRng);
+        for (size_t i = 1; i < tournamentSize; ++i)
         {
-            if (population[indices[i]].fitness > population[bestIdx].fitness)
-                bestIdx = indices[i];
+            const size_t idx = idxDist(mRng);
+            if (mPopFitness[idx] > mPopFitness[bestIdx])
+                bestIdx = idx;
         }
 
-        return population[bestIdx];
+        return bestIdx;
     }
 
     //==================================================================
     // Crossover two parents to create a child
-    Individual Crossover(const Individual& parent1, const Individual& parent2)
+    void Crossover(const ParamStorage* pParent1, const ParamStorage* pParent2, ParamStorage* pChild)
     {
-        const NeuralNet& networkP1 = parent1.network;
-        const NeuralNet& networkP2 = parent2.network;
-
-        NeuralNet childNet;
-
         std::uniform_real_distribution<float> dist(0.0f, 1.0f);
 
-        childNet.foreachParameters([&](int layer, int row, int col, T& param)
+        for (size_t j = 0; j < PARAMS_N; ++j)
         {
             if (dist(mRng) >= 0.5f)
-                param = networkP1.GetParameter(layer, row, col); // Take from parent1 with 50% chance
+                pChild[j] = pParent1[j]; // Take from parent1 with 50% chance
             else
-                param = networkP2.GetParameter(layer, row, col); // Otherwise, take from parent2
-        });
-
-        return Individual(childNet);
+                pChild[j] = pParent2[j]; // Otherwise, take from parent2
+        }
     }
 
     //==================================================================
@@ -269,63 +528,101 @@ public:
 
     //==================================================================
     // Mutate an individual
-    void mutate(Individual& individual)
+    void mutate(ParamStorage* pParams)
     {
         std::uniform_real_distribution<float> shouldMutateDist(0.0f, 1.0f);
         // Note: USE_MUTATION_STDDEV is not easily adaptable here without recalculating stddev per layer/parameter type
         // Sticking to the simpler mutation strength for now.
         std::normal_distribution<float> mutationValueDist(0.0f, (float)mMutationStrength);
 
-        // Iterate through layers, weights, and biases
-        individual.network.foreachParameters([&](int, int, int, T& param) {
+        // Iterate through all the weights and biases
+        for (size_t j = 0; j < PARAMS_N; ++j)
+        {
             if (shouldMutateDist(mRng) < mMutationRate) {
+                auto param = LoadParam<T>(pParams[j]);
                 param += mutationValueDist(mRng);
-                param = std::clamp(param, -1.0f, 1.0f); // Clamp
+                param = std::clamp(param, -mParamLimit, mParamLimit); // Clamp
+                pParams[j] = StoreParam<ParamStorage>(param);
             }
-        });
+        }
     }
 
     //==================================================================
     // Test a network on a simulation
-    // - "seed" gives the simulation variant to test
-    // - "net" is the network to test
+    // - "scenario" gives the simulation variant to test
+    // - "pStoredParams" are the flat parameters of the network to test,
+    //   as stored in the population
+    // - "pOutStepsN" optionally receives the number of steps simulated
+    // - "useCoarse" selects the coarse physics (see SetCoarseFidelity)
     // Returns the score of the simulation with the given network
     //==================================================================
     double TestNetworkOnSimulation(
-        uint32_t simulationSeed,
-        const NeuralNet& net) const
+        const SimScenario& scenario,
+        const ParamStorage* pStoredParams,
+        uint32_t* pOutStepsN = nullptr,
+        bool useCoarse = false) const
     {
-        // Create a simulation with the given seed
-        Simulation sim(mSimParams, simulationSeed);
+        // 16 bit parameters are converted once, for all the steps
+        const T* pNetParams = nullptr;
+        std::array<T, PARAMS_N> netParams;
+        if constexpr (std::is_same_v<ParamStorage, T>)
+        {
+            pNetParams = pStoredParams;
+        }
+        else
+        {
+            LoadParams(pStoredParams, netParams.data(), PARAMS_N);
+            pNetParams = netParams.data();
+        }
+
+        // Start a (compact) simulation run with the given scenario
+        SimRollout sim(useCoarse ? mSimContextCoarse : mSimContext, scenario);
+        uint32_t stepsN = 0;
 
-        // Run the simulation until it ends, or 30 (virtual) seconds have passed
-        while (!sim.IsSimulationComplete() && sim.GetElapsedTimeS() < Simulation::MAX_TIME_S)
+        // Run the simulation until it ends, or MAX_TIME_S (virtual) seconds have passed
+        while (!sim.IsSimulationComplete() && !sim.IsTimeOut())
         {
             // Step the simulation forward...
-            sim.AnimateSim([&](const NeuralNet::Inputs& states, NeuralNet::Outputs& actions)
+            sim.AnimateSim<SIM_RAYS_N>([&](const NeuralNet::Inputs& states, NeuralNet::Outputs& actions)
             {
                 // states -> net -> actions
-                net.FeedForward(states, actions);
+                NeuralNet::FeedForward(pNetParams, states, actions);
             });
+            stepsN += 1;
         }
+        if (pOutStepsN)
+            *pOutStepsN = stepsN;
+
         // Return the score of the simulation
         return sim.CalculateScore();
     }
 
+    // Evaluate on another set of scenarios (e.g. a library mapped from a file)
+    // Call it between iterations, not while training is running
+    void SetScenarioBank(std::shared_ptr<const ScenarioBank> scenarios)
+    {
+        assert(scenarios && scenarios->GetSize() > 0);
+        mScenarios = std::move(scenarios);
+    }
+
     // Getters for training status
     size_t GetCurrentGeneration() const { return mCurrentGeneration; }
     size_t GetMaxGenerations() const { return mMaxGenerations; }
     double GetBestScore() {
         std::lock_guard<std::mutex> lock(mBestIndividualMtx);
-        return mBestIndividual.fitness;
+        return mBestFitness;
     }
     size_t GetPopulationSize() const { return mPopulationSize; }
     bool IsTrainingComplete() const { return mCurrentGeneration >= mMaxGenerations; }
     // Get the best network object found so far
     NeuralNet GetBestIndividualNetwork() {
         std::lock_guard<std::mutex> lock(mBestIndividualMtx);
-        return mBestIndividual.network;
+        return mBestNetwork;
     }
+
+private:
+    ParamStorage* getIndividualParams(size_t idx) { return &mPopParams[idx * PARAMS_N]; }
+    const ParamStorage* getIndividualParams(size_t idx) const { return &mPopParams[idx * PARAMS_N]; }
 };
 
 #endif
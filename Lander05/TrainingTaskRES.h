@@ -2,6 +2,7 @@
 #define TRAININGTASKRES_H
 
 #include <cstddef>
+#include <memory>
 #include <random>
 #include <vector>
 #include <limits> // Needed for numeric_limits
@@ -10,35 +11,58 @@
 #include <algorithm> // For std::transform, std::clamp
 #include <cstdio> // For printf debugging
 #include "Utils.h"
+#include "BatchEvaluator.h"
+#include "Checkpoint.h"
+#include "ParamStorage.h"
+#include "ScenarioBank.h"
+#include "SimRollout.h"
 #include "SimpleNeuralNet.h"
 #include "Simulation.h"
 
+// Options of TrainingTaskRES, the same for all its instantiations
+struct TrainingTaskRESParams
+{
+    size_t maxGenerations = 0;     // Maximum number of generations/updates
+    double sigma = 0.1;            // Standard deviation for noise perturbation
+    double alpha = 0.01;           // Learning rate
+    size_t numPerturbations = 50;  // Number of perturbation pairs (N/2 in some literature)
+    uint32_t seed = 1234;          // Seed for random number generator
+};
+
 //==================================================================
 // TrainingTaskRES class - handles neural network training using REINFORCE-ES
+// "ParamStorageT" is the type of the perturbations noise: T, or a 16 bit
+// type to halve the memory of large perturbation sets (see ParamStorage.h)
 //==================================================================
-template<std::floating_point T, NetArch auto netArch>
+template<std::floating_point T, NetArch auto netArch, typename ParamStorageT = T>
+    requires ParamStorageFor<ParamStorageT, T>
 class TrainingTaskRES
 {
 public:
     using NeuralNet = SimpleNeuralNet<T, netArch>;
+    using ParamStorage = ParamStorageT;
+    static constexpr auto NET_ARCH = netArch;
+
+    // Inputs beyond the simulation state are raycast sensors (see SimRaySensors)
+    static constexpr int SIM_RAYS_N = netArch[0] - SIM_BRAINSTATE_N;
+    static_assert(SIM_RAYS_N >= 0, "The network needs all the simulation state inputs");
 
 public:
-    struct Params
-    {
-        size_t maxGenerations = 0;     // Maximum number of generations/updates
-        double sigma = 0.1;            // Standard deviation for noise perturbation
-        double alpha = 0.01;           // Learning rate
-        size_t numPerturbations = 50;  // Number of perturbation pairs (N/2 in some literature)
-        uint32_t seed = 1234;          // Seed for random number generator
-    };
+    using Params = TrainingTaskRESParams;
 private:
     const Params mPar;
 
-    SimParams          mSimParams;
+    // Parameters and options shared by all the rollouts
+    SimRolloutContext  mSimContext;
+    // Same, with coarse physics (see SetCoarseFidelity)
+    SimRolloutContext  mSimContextCoarse;
 
     // Number of simulations to run for each perturbed network evaluation
     // More variants -> more accurate evaluation (helps prevent overfitting)
     static constexpr size_t SIM_VARIANTS_N = 30;
+    static constexpr uint32_t SIM_START_SEED = 1134; // Consistent starting seed for evaluation runs
+    // Layouts of the simulation variants (generated once, shared by all evaluations)
+    std::shared_ptr<const ScenarioBank> mScenarios;
 
     // Central network being trained
     NeuralNet mCentralNetwork;
@@ -49,27 +73,64 @@ private:
     std::mt19937 mRng;
 
     // Parameter vector size
-    size_t mTotalParams = 0;
+    static constexpr size_t PARAMS_N = NeuralNet::CalcTotalParameters();
+    size_t mTotalParams = PARAMS_N;
     // Scaled hyperparameters
     double mAdaptedSigma {};
     double mAdaptedAlpha {};
 
     size_t mCurrentGeneration = 0;
 
+    // Multi-fidelity evaluation (see SetCoarseFidelity)
+    bool   mIsCoarsePhase = false;      // Evaluating perturbations with coarse physics
+    size_t mCoarsePlateauGensN = 0;     // Iterations without improvement to end it
+    size_t mGensWithoutImprovementN = 0;
+
+    // Perturbations of the current iteration, two networks each:
+    // theta_plus and theta_minus. Only their noise is stored, the
+    // networks parameters are made from it when they are evaluated (see
+    // evaluatePerturbations).
+    std::vector<double> mPerturbedFitness;
+    // Noise of each perturbation, as [perturbation][param]
+    std::vector<ParamStorage> mEpsilons;
+    std::vector<float>  mGradientEstimate;
+    // Central network as flat parameters, for its evaluation
+    std::vector<T>      mCentralParams;
+
     // Parallelization system
     ParallelTasks mPllTasks;
+    BatchEvaluator mEvaluator {mPllTasks};
 
     std::thread mTrainingThread;
 
+    // Checkpoints saved by the training thread (see SetCheckpointFile)
+    std::string mCheckpointPath;
+    size_t      mCheckpointEveryGensN = 0;
+
+    // Scalar state, in checkpoints
+    struct CheckpointState
+    {
+        uint64_t currentGeneration = 0;
+        uint64_t isCoarsePhase = 0;
+        uint64_t gensWithoutImprovementN = 0;
+        double   bestScore = 0;
+    };
+    static_assert(std::is_trivially_copyable_v<std::mt19937>, "The RNG state is stored as raw bytes");
+
 public:
-    TrainingTaskRES(const Params& par, const SimParams& sp)
+    TrainingTaskRES(const Params& par, const SimParams& sp, const SimRunOptions& ro = {})
         : mPar(par)
-        , mSimParams(sp)
+        , mSimContext(sp, ro)
+        , mSimContextCoarse(sp, ro)
+        , mScenarios(std::make_shared<const ScenarioBank>(sp, SIM_START_SEED, SIM_VARIANTS_N))
         , mRng(par.seed)
     {
         // Initialize central network with random parameters
         mCentralNetwork.InitializeRandomParameters(mRng());
-        mTotalParams = mCentralNetwork.GetTotalParameterCount();
+        mPerturbedFitness.resize(2 * mPar.numPerturbations);
+        mEpsilons.resize(mPar.numPerturbations * mTotalParams);
+        mGradientEstimate.resize(mTotalParams);
+        mCentralParams.resize(mTotalParams);
 
         // Scale sigma and alpha by the number of parameters of the network
         // This helps keeping constant the effective learning when the
@@ -84,7 +145,8 @@ public:
 
     ~TrainingTaskRES()
     {
-        mTrainingThread.join();
+        if (mTrainingThread.joinable())
+            mTrainingThread.join();
     }
 
     void startTraining(bool useThread = true)
@@ -93,102 +155,201 @@ public:
             while (IsTrainingComplete() == false)
             {
                 RunIteration(useThread);
+
+                if (mCheckpointEveryGensN && (mCurrentGeneration % mCheckpointEveryGensN == 0 || IsTrainingComplete()))
+                    SaveCheckpoint(mCheckpointPath);
             }
         });
     }
 
     //==================================================================
-    // Evaluate fitness for a given network over multiple simulation variants
+    // Checkpoints
+    // The state of ES is small: the central network, the best score,
+    // the iteration counter, the fidelity phase and the state of the
+    // RNG. Training resumed from a checkpoint continues exactly, bit for
+    // bit, as it would have without the interruption.
+    // The options (constructor and SetCoarseFidelity) are not saved:
+    // create the trainer with the same ones, then load the checkpoint.
+    // The central network is stored as a plain network (see
+    // Checkpoint::LoadNetworkFromFile), for viewers to load it.
+    // Call these between iterations, not while training is running
     //==================================================================
-    double evaluateNetwork(const NeuralNet& net) const
+    bool SaveCheckpoint(const std::string& path)
     {
-        const uint32_t simStartSeed = 1134; // Consistent starting seed for evaluation runs
-        double totalScore = 0.0;
+        CheckpointState st;
+        st.currentGeneration = mCurrentGeneration;
+        st.isCoarsePhase = mIsCoarsePhase;
+        st.gensWithoutImprovementN = mGensWithoutImprovementN;
+        st.bestScore = mBestScore;
 
-        for (size_t i = 0; i < SIM_VARIANTS_N; ++i)
+        CheckpointWriter writer;
         {
-            const auto variantSeed = simStartSeed + (uint32_t)i;
-            totalScore += TestNetworkOnSimulation(variantSeed, net);
+            std::lock_guard<std::mutex> lock(mCentralNetworkMtx);
+            Checkpoint::AddNetwork(writer, mCentralNetwork);
         }
-        return totalScore / (double)SIM_VARIANTS_N;
+        writer.AddValue("res_state", st);
+        writer.AddValue("res_rng", mRng);
+        return writer.SaveToFile(path);
+    }
+
+    bool LoadCheckpoint(const std::string& path)
+    {
+        CheckpointReader reader;
+        if (!reader.LoadFromFile(path))
+            return false;
+
+        CheckpointState st;
+        NeuralNet centralNet;
+        const auto* pRng = reader.FindArray<std::mt19937>("res_rng", 1);
+        if (!reader.ReadValue("res_state", st) || !pRng || !Checkpoint::ReadNetwork(reader, centralNet))
+        {
+            printf("The checkpoint file %s doesn't match this training\n", path.c_str());
+            return false;
+        }
+
+        std::memcpy((void*)&mRng, pRng, sizeof(mRng));
+        mCurrentGeneration = (size_t)st.currentGeneration;
+        mIsCoarsePhase = st.isCoarsePhase != 0;
+        mGensWithoutImprovementN = (size_t)st.gensWithoutImprovementN;
+        mBestScore = st.bestScore;
+        {
+            std::lock_guard<std::mutex> lock(mCentralNetworkMtx);
+            mCentralNetwork = centralNet;
+        }
+        return true;
+    }
+
+    // Have the training thread save a checkpoint every "everyGensN"
+    // iterations, and at the end (0 for none)
+    // Call it before training
+    void SetCheckpointFile(const std::string& path, size_t everyGensN)
+    {
+        mCheckpointPath = path;
+        mCheckpointEveryGensN = path.empty() ? 0 : everyGensN;
+    }
+
+    //==================================================================
+    // Multi-fidelity evaluation
+    // The perturbed networks are only compared with each other, to
+    // estimate the gradient, so coarse physics ("subStepsN" steps at a
+    // time, see SimRolloutT::animCoarse) is enough in the early
+    // iterations. The central network is always evaluated at full
+    // fidelity.
+    // Once the best score doesn't improve for "plateauGensN" iterations,
+    // the perturbations are evaluated at full fidelity too.
+    // Call it before training
+    void SetCoarseFidelity(uint32_t subStepsN, size_t plateauGensN)
+    {
+        mSimContextCoarse = SimRolloutContext(mSimContext.sp, mSimContext.ro, subStepsN);
+        mCoarsePlateauGensN = plateauGensN;
+        mIsCoarsePhase = subStepsN > 1;
+        mGensWithoutImprovementN = 0;
+    }
+
+    bool IsCoarsePhase() const { return mIsCoarsePhase; }
+
+    //==================================================================
+    // Warm start
+    // Start from a network (e.g. one cloned from the rule-based brain,
+    // see CloneFixedBrain) instead of a random one
+    // Call it before training (a checkpoint loaded after it wins)
+    void SetInitialNetwork(const NeuralNet& net)
+    {
+        std::lock_guard<std::mutex> lock(mCentralNetworkMtx);
+        mCentralNetwork = net;
+        mBestScore = evaluateNetwork(mCentralNetwork);
+    }
+
+    //==================================================================
+    // Evaluate fitness for a given network over multiple simulation variants
+    // (the variants are split between threads by the BatchEvaluator)
+    //==================================================================
+    double evaluateNetwork(const NeuralNet& net, bool useThread = true)
+    {
+        net.CopyParametersTo(mCentralParams.data());
+
+        double score = 0.0;
+        evaluateNetworks(1, mCentralParams.data(), &score, useThread);
+        return score;
+    }
+
+    //==================================================================
+    // Evaluate fitness for "netsN" networks stored as consecutive flat
+    // parameters in "pNetsParams", writing the scores to "pOutScores"
+    // Perturbed networks all behave much like the central one, so the
+    // BatchEvaluator orders their chunks by the cost of each variant,
+    // as measured in the previous evaluations
+    //==================================================================
+    void evaluateNetworks(size_t netsN, const T* pNetsParams, double* pOutScores, bool useThread = true, bool useCoarse = false)
+    {
+        mEvaluator.Evaluate(netsN, mScenarios->GetSize(),
+            [&](size_t netIdx, size_t variantIdx)
+            {
+                BatchEvalResult res;
+                res.score = TestNetworkOnSimulation(mScenarios->GetScenario(variantIdx), pNetsParams + netIdx * mTotalParams, &res.stepsN, useCoarse);
+                return res;
+            },
+            pOutScores,
+            useThread);
+    }
+
+    //==================================================================
+    // Evaluate theta_plus and theta_minus of all the perturbations
+    // Each evaluation makes the parameters of its network, from the
+    // central ones and the stored noise, in a local buffer
+    //==================================================================
+    void evaluatePerturbations(bool useThread, bool useCoarse)
+    {
+        const auto sigma = (float)mAdaptedSigma;
+        mEvaluator.Evaluate(2 * mPar.numPerturbations, mScenarios->GetSize(),
+            [&](size_t netIdx, size_t variantIdx)
+            {
+                const ParamStorage* epsilon = &mEpsilons[(netIdx / 2) * mTotalParams];
+                std::array<T, PARAMS_N> netParams;
+                for (size_t j = 0; j < PARAMS_N; ++j)
+                {
+                    const auto perturbation = sigma * LoadParam<float>(epsilon[j]);
+                    netParams[j] = netIdx % 2 == 0
+                                    ? mCentralParams[j] + perturbation
+                                    : mCentralParams[j] - perturbation;
+                }
+
+                BatchEvalResult res;
+                res.score = TestNetworkOnSimulation(mScenarios->GetScenario(variantIdx), netParams.data(), &res.stepsN, useCoarse);
+                return res;
+            },
+            mPerturbedFitness.data(),
+            useThread);
     }
 
     //==================================================================
     // Run a single training iteration (one ES update step)
+    // All the buffers are allocated once, in the constructor, so an
+    // iteration doesn't touch the heap
     //==================================================================
     void RunIteration(bool useThread = true)
     {
         if (IsTrainingComplete()) return;
 
-        std::vector<float> gradientEstimate(mTotalParams, 0.0f);
+        std::normal_distribution<float> noiseDist{0.0f, 1.0f}; // Standard normal distribution
 
-        // Store results from perturbations
-        struct PerturbationResult
+        // Snapshot of the central parameters to perturb
         {
-            double fitness_plus {};
-            double fitness_minus {};
-            std::vector<float> epsilon;
-        };
-        std::vector<PerturbationResult> results(mPar.numPerturbations);
-
-        std::normal_distribution<float> noiseDist{0.0f, 1.0f}; // Standard normal distribution
+            std::lock_guard<std::mutex> lock(mCentralNetworkMtx);
+            mCentralNetwork.CopyParametersTo(mCentralParams.data());
+        }
 
-        // --- Generate and Evaluate Perturbations ---
+        // --- Generate Perturbations ---
         for (size_t i = 0; i < mPar.numPerturbations; ++i)
         {
-            // Generate noise vector epsilon
-            std::vector<float> epsilon(mTotalParams);
-            for(size_t j = 0; j < mTotalParams; ++j)
-                epsilon[j] = noiseDist(mRng);
-
-            // Store epsilon for later gradient calculation
-            results[i].epsilon = epsilon; // Copy epsilon
-
-            // Create perturbed parameters theta_plus and theta_minus
-            NeuralNet net_plus;
-            NeuralNet net_minus;
-            size_t j = 0;
-            {
-                std::lock_guard<std::mutex> lock(mCentralNetworkMtx);
-                mCentralNetwork.foreachParameters([&](int layer, int row, int col, T& central_param){
-                    const auto perturbation = (float)mAdaptedSigma * epsilon[j];
-                    net_plus.GetParameter(layer, row, col) = central_param + perturbation;
-                    net_minus.GetParameter(layer, row, col) = central_param - perturbation;
-                    j++;
-                });
-            }
-#if 0
+            // Generate noise vector epsilon (kept for the gradient calculation)
+            ParamStorage* epsilon = &mEpsilons[i * mTotalParams];
             for(size_t j = 0; j < mTotalParams; ++j)
-            {
-                // Optional: Clamp parameters if needed, though often omitted in ES
-                params_plus[j] = std::clamp(params_plus[j], -1.0f, 1.0f);
-                params_minus[j] = std::clamp(params_minus[j], -1.0f, 1.0f);
-            }
-#endif
-
-            // --- Evaluate theta_plus ---
-            auto thetaPlusTask = [this, net_plus = std::move(net_plus), i, &results]()
-                {
-                    results[i].fitness_plus = evaluateNetwork(net_plus);
-                };
-            if (useThread)
-                mPllTasks.AddTask(thetaPlusTask);
-            else
-                thetaPlusTask();
-
-            // --- Evaluate theta_minus ---
-            auto thetaMinusTask = [this, net_minus = std::move(net_minus), i, &results]()
-                {
-                    results[i].fitness_minus = evaluateNetwork(net_minus);
-                };
-            if (useThread)
-                mPllTasks.AddTask(thetaMinusTask);
-            else
-                thetaMinusTask();
+                epsilon[j] = StoreParam<ParamStorage>(noiseDist(mRng));
         }
 
-        // Wait for all evaluations to complete
-        mPllTasks.WaitAll();
+        // --- Evaluate theta_plus and theta_minus of all the perturbations ---
+        evaluatePerturbations(useThread, mIsCoarsePhase);
 
 #if 0
         if (!(mCurrentGeneration % 100)) // Log every 10 generations to avoid spam
@@ -196,76 +357,103 @@ public:
              printf("[DEBUG Gen %zu] Perturbation Scores:\n", mCurrentGeneration);
              for (size_t i = 0; i < std::min((size_t)3, mNumPerturbations); ++i) {
                  printf("  [%zu] F+: %.4f, F-: %.4f, Diff: %.4f\n",
-                        i, results[i].fitness_plus, results[i].fitness_minus,
-                        results[i].fitness_plus - results[i].fitness_minus);
+                        i, mPerturbedFitness[2 * i + 0], mPerturbedFitness[2 * i + 1],
+                        mPerturbedFitness[2 * i + 0] - mPerturbedFitness[2 * i + 1]);
              }
         }
 #endif
 
         // --- Calculate Gradient Estimate ---
+        auto& gradientEstimate = mGradientEstimate;
+        std::fill(gradientEstimate.begin(), gradientEstimate.end(), 0.0f);
         for (size_t i = 0; i < mPar.numPerturbations; ++i)
         {
-            double fitness_diff = results[i].fitness_plus - results[i].fitness_minus;
-            const auto& epsilon = results[i].epsilon;
+            double fitness_diff = mPerturbedFitness[2 * i + 0] - mPerturbedFitness[2 * i + 1];
+            const ParamStorage* epsilon = &mEpsilons[i * mTotalParams];
             for (size_t j = 0; j < mTotalParams; ++j)
             {
-                gradientEstimate[j] += (float)fitness_diff * epsilon[j];
+                gradientEstimate[j] += (float)fitness_diff * LoadParam<float>(epsilon[j]);
             }
         }
 
         // --- Update Central Parameters ---
         const auto scaleFactor = mAdaptedAlpha / (2.0 * mPar.numPerturbations * mAdaptedSigma);
-        size_t j = 0;
+        for (size_t j = 0; j < mTotalParams; ++j)
+        {
+            mCentralParams[j] += (float)(scaleFactor * gradientEstimate[j]);
+            // Optional: Clamp parameters
+            // mCentralParams[j] = std::clamp(mCentralParams[j], -1.0f, 1.0f);
+        }
         double currentCentralScore;
         {
             std::lock_guard<std::mutex> lock(mCentralNetworkMtx);
-            mCentralNetwork.foreachParameters([&](int, int, int, T& central_param){
-                central_param += (float)(scaleFactor * gradientEstimate[j]);
-                // Optional: Clamp parameters
-                // centralParams[j] = std::clamp(centralParams[j], -1.0f, 1.0f);
-                j++;
-
-            });
+            mCentralNetwork.SetParametersFrom(mCentralParams.data());
         // Evaluate the updated central network and update best score if improved
-            currentCentralScore = evaluateNetwork(mCentralNetwork);
+            evaluateNetworks(1, mCentralParams.data(), &currentCentralScore, useThread);
         }
-        if (currentCentralScore > mBestScore) {
+        const auto isImproved = currentCentralScore > mBestScore;
+        if (isImproved) {
             mBestScore = currentCentralScore;
             // Could potentially save the best network parameters here if needed
         }
 
+        // Switch to full fidelity once the coarse phase stops improving
+        if (mIsCoarsePhase)
+        {
+            mGensWithoutImprovementN = isImproved ? 0 : mGensWithoutImprovementN + 1;
+            if (mGensWithoutImprovementN >= mCoarsePlateauGensN)
+                mIsCoarsePhase = false;
+        }
+
         // Increment the generation counter
         mCurrentGeneration += 1;
     }
 
     //==================================================================
     // Test a network on a simulation
-    // - "seed" gives the simulation variant to test
-    // - "net" is the network to test
+    // - "scenario" gives the simulation variant to test
+    // - "pNetParams" are the flat parameters of the network to test
+    // - "pOutStepsN" optionally receives the number of steps simulated
+    // - "useCoarse" selects the coarse physics (see SetCoarseFidelity)
     // Returns the score of the simulation with the given network
     // (Identical to the one in TrainingTaskGA)
     //==================================================================
     double TestNetworkOnSimulation(
-        uint32_t simulationSeed,
-        const NeuralNet& net) const
+        const SimScenario& scenario,
+        const T* pNetParams,
+        uint32_t* pOutStepsN = nullptr,
+        bool useCoarse = false) const
     {
-        // Create a simulation with the given seed
-        Simulation sim(mSimParams, simulationSeed);
+        // Start a (compact) simulation run with the given scenario
+        SimRollout sim(useCoarse ? mSimContextCoarse : mSimContext, scenario);
+        uint32_t stepsN = 0;
 
-        // Run the simulation until it ends, or 30 (virtual) seconds have passed
-        while (!sim.IsSimulationComplete() && sim.GetElapsedTimeS() < Simulation::MAX_TIME_S)
+        // Run the simulation until it ends, or MAX_TIME_S (virtual) seconds have passed
+        while (!sim.IsSimulationComplete() && !sim.IsTimeOut())
         {
             // Step the simulation forward...
-            sim.AnimateSim([&](const NeuralNet::Inputs& states, NeuralNet::Outputs& actions)
+            sim.AnimateSim<SIM_RAYS_N>([&](const NeuralNet::Inputs& states, NeuralNet::Outputs& actions)
             {
                 // states -> net -> actions
-                net.FeedForward(states, actions);
+                NeuralNet::FeedForward(pNetParams, states, actions);
             });
+            stepsN += 1;
         }
+        if (pOutStepsN)
+            *pOutStepsN = stepsN;
+
         // Return the score of the simulation
         return sim.CalculateScore();
     }
 
+    // Evaluate on another set of scenarios (e.g. a library mapped from a file)
+    // Call it between iterations, not while training is running
+    void SetScenarioBank(std::shared_ptr<const ScenarioBank> scenarios)
+    {
+        assert(scenarios && scenarios->GetSize() > 0);
+        mScenarios = std::move(scenarios);
+    }
+
     // Getters for training status
     size_t GetCurrentGeneration() const { return mCurrentGeneration; }
     size_t GetMaxGenerations() const { return mPar.maxGenerations; }
@@ -1,5 +1,6 @@
 #include <cmath>
 #include <chrono>
+#include <string>
 
 #include "raylib.h"
 #include "rlgl.h"
@@ -7,11 +8,15 @@
 #include "SimulationDisplay.h"
 #include "SimpleNeuralNet.h"
 #include "TrainingTaskRES.h" // Use REINFORCE-ES task
+#include "TrainingTaskDistill.h"
 #include "DrawUI.h"
+#include "ArchRegistry.h"
 
 static const int SCREEN_WIDTH = 800;
 static const int SCREEN_HEIGHT = 600;
 static const float RESTART_DELAY = 2.0f;
+// Steps between brain queries (the controls are held in between)
+static const int ACTION_REPEAT = 1;
 
 // Number of training generations/updates to run
 static const int MAX_TRAINING_GENERATIONS = 10000;
@@ -19,27 +24,98 @@ static const int MAX_TRAINING_GENERATIONS = 10000;
 static const double SIGMA = 0.5;             // Noise standard deviation
 static const double ALPHA = 0.40;            // Learning rate
 static const size_t NUM_PERTURBATIONS = 100;  // Number of perturbation pairs
+// Coarse physics (steps at a time) in early training, until the best
+// score stops improving for a number of generations
+static const uint32_t COARSE_SUBSTEPS_N = 4;
+static const size_t COARSE_PLATEAU_GENS_N = 15;
+// Training state saved every number of generations, and resumed from at start
+static const char* CHECKPOINT_FILE = "lander05_res.ckpt";
+static const size_t CHECKPOINT_EVERY_GENS_N = 100;
+// Warm start (--warm-start): the central network starts as a network
+// cloned from the rule-based brain of lander02 (see CloneFixedBrain),
+// with smaller steps, not to lose what it knows
+static const double WARM_START_SIGMA = 0.1;
+static const double WARM_START_ALPHA = 0.004;
+
+// Raycast sensors to see the terrain, as extra inputs (0 for none)
+static constexpr int RAY_SENSORS_N = 0;
 
 //==================================================================
 // Network configuration
 //==================================================================
 static constexpr std::array<int, 4> NETWORK_ARCHITECTURE = {
-    SIM_BRAINSTATE_N,             // Input layer: simulation state variables
+    SIM_BRAINSTATE_N + RAY_SENSORS_N, // Input layer: simulation state variables (and sensors)
     (int)((double)SIM_BRAINSTATE_N*1.25), // Hidden layer
     (int)((double)SIM_BRAINSTATE_N*1.25), // Hidden layer
     SIM_BRAINACTION_N             // Output layer: actions (up, left, right)
 };
 
-using TrainingTask = TrainingTaskRES<float, NETWORK_ARCHITECTURE>;
+// Type of the perturbations noise: float, or Float16/BFloat16 to halve
+// the memory of the perturbation sets (see ParamStorage.h)
+using NoiseParamStorage = float;
+
+// Architectures built in, to pick one at runtime (see ArchRegistry.h):
+//   lander05 --arch 10x16x16x3
+// The first one is the default
+using LanderArchs = LanderArchRegistry<SIM_BRAINSTATE_N + RAY_SENSORS_N>;
+static_assert(LanderArchs::FIRST_ARCH == NETWORK_ARCHITECTURE, "The default architecture comes first");
 
 // Forward declarations
+template<NetArch auto netArch>
+static int runTraining(const std::string& checkpointFile, bool isWarmStart);
+template<typename TrainingTask>
+static bool warmStart(TrainingTask& trainingTask);
+template<typename TrainingTask>
 static void drawUI(Simulation& sim, TrainingTask& trainingTask);
 
 //==================================================================
 // Main function
 //==================================================================
-int main()
+int main(int argc, char** argv)
 {
+    auto arch = MakeArchDesc<NETWORK_ARCHITECTURE>();
+    bool isWarmStart = false;
+    for (int i=1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--arch" && i + 1 < argc)
+        {
+            if (!ParseArch(argv[++i], arch))
+            {
+                printf("Invalid architecture %s, expected the layers sizes, e.g. 10x12x12x3\n", argv[i]);
+                return 1;
+            }
+        }
+        else
+        if (arg == "--warm-start")
+            isWarmStart = true;
+        else
+        {
+            printf("Usage: lander05 [--arch <layers sizes, e.g. 10x12x12x3>] [--warm-start]\n");
+            return 1;
+        }
+    }
+
+    // The default architecture keeps the original checkpoint file
+    std::string checkpointFile = CHECKPOINT_FILE;
+    if (arch != MakeArchDesc<NETWORK_ARCHITECTURE>())
+        checkpointFile = "lander05_res_" + ArchToString(arch) + ".ckpt";
+    // Warm started trainings have their own (e.g. lander05_res_warm.ckpt)
+    if (isWarmStart)
+        checkpointFile.insert(checkpointFile.rfind(".ckpt"), "_warm");
+
+    int ret = 1;
+    if (!LanderArchs::Dispatch(arch, [&]<NetArch auto netArch>() { ret = runTraining<netArch>(checkpointFile, isWarmStart); }))
+        LanderArchs::PrintNotBuiltIn(arch);
+    return ret;
+}
+
+//==================================================================
+template<NetArch auto netArch>
+static int runTraining(const std::string& checkpointFile, bool isWarmStart)
+{
+    using TrainingTask = TrainingTaskRES<float, netArch, NoiseParamStorage>;
+
     // Initialize window
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "NNLander05 - REINFORCE-ES Training");
     SetTargetFPS(60);
@@ -49,17 +125,36 @@ int main()
     sp.SCREEN_WIDTH = (float)SCREEN_WIDTH;
     sp.SCREEN_HEIGHT = (float)SCREEN_HEIGHT;
 
+    // The displayed simulation queries the brain as in training
+    SimRunOptions displayRo;
+    displayRo.ACTION_REPEAT = ACTION_REPEAT;
+
     // Create the simulation object with the parameters
     uint32_t seed = 1134; // Initial random seed
-    Simulation sim(sp, seed);
+    Simulation sim(sp, seed, displayRo);
 
     // Create the training task
-    TrainingTask::Params par;
+    typename TrainingTask::Params par;
     par.maxGenerations = MAX_TRAINING_GENERATIONS;
-    par.sigma = SIGMA;
-    par.alpha = ALPHA;
+    par.sigma = isWarmStart ? WARM_START_SIGMA : SIGMA;
+    par.alpha = isWarmStart ? WARM_START_ALPHA : ALPHA;
     par.numPerturbations = NUM_PERTURBATIONS;
-    TrainingTask trainingTask(par, sp);
+    // Options for the training simulations
+    SimRunOptions trainingRo;
+    trainingRo.EARLY_TERMINATION = true; // Same outcomes, fewer brain steps
+    trainingRo.ACTION_REPEAT = ACTION_REPEAT;
+    TrainingTask trainingTask(par, sp, trainingRo);
+    trainingTask.SetCoarseFidelity(COARSE_SUBSTEPS_N, COARSE_PLATEAU_GENS_N);
+    if (isWarmStart && !warmStart(trainingTask))
+    {
+        CloseWindow();
+        return 1;
+    }
+
+    // Resume an interrupted training (after all the options are set)
+    if (FileExists(checkpointFile.c_str()) && trainingTask.LoadCheckpoint(checkpointFile))
+        printf("Resumed training from %s, at generation %i\n", checkpointFile.c_str(), (int)trainingTask.GetCurrentGeneration());
+    trainingTask.SetCheckpointFile(checkpointFile, CHECKPOINT_EVERY_GENS_N);
 
     // We'll use the central network from trainingTask
 
@@ -89,7 +184,7 @@ int main()
             if (restartTimer >= RESTART_DELAY || IsKeyPressed(KEY_SPACE))
             {
                 // Reset the simulation, keep the same seed
-                sim = Simulation(sp, seed);
+                sim = Simulation(sp, seed, displayRo);
                 seed += 1;
                 restartTimer = 0.0f;
             }
@@ -97,7 +192,7 @@ int main()
         else
         {
             // Animate the simulation using the best network from the training task
-            sim.AnimateSim([&](const TrainingTask::NeuralNet::Inputs& states, TrainingTask::NeuralNet::Outputs& actions)
+            sim.AnimateSim<TrainingTask::SIM_RAYS_N>([&](const typename TrainingTask::NeuralNet::Inputs& states, typename TrainingTask::NeuralNet::Outputs& actions)
             {
                 // states -> centralNet -> actions
                 trainingTask.GetCentralNetwork().FeedForward(states, actions); // Use central network
@@ -124,6 +219,28 @@ int main()
 }
 
 //==================================================================
+// Start from a network cloned from the rule-based brain, which only
+// sees the simulation state
+template<typename TrainingTask>
+static bool warmStart(TrainingTask& trainingTask)
+{
+    if constexpr (TrainingTask::SIM_RAYS_N == 0)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+        trainingTask.SetInitialNetwork(CloneFixedBrain<float, TrainingTask::NET_ARCH>());
+        const auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        printf("Warm start from the rule-based brain, cloned in %.1f seconds\n", duration);
+        return true;
+    }
+    else
+    {
+        printf("No warm start with raycast sensors: the rule-based brain doesn't use them\n");
+        return false;
+    }
+}
+
+//==================================================================
+template<typename TrainingTask>
 static void drawUI(Simulation& sim, TrainingTask& trainingTask)
 {
     // Draw neural network visualization
@@ -0,0 +1,268 @@
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "Checkpoint.h"
+
+//==================================================================
+// netcodegen - exports a trained network as a standalone C++ header
+// Usage: netcodegen <checkpoint file> <output header> <name>
+// The checkpoint can be a network file or a training checkpoint (see
+// Checkpoint::SaveNetworkToFile). The header defines, in namespace
+// <name>:
+// - the weights and biases of each layer, as constexpr arrays
+// - FeedForward(pInputs, pOutputs), specialized for this architecture:
+//   unrolled over the inputs of each layer, and without branches, Eigen
+//   or includes. Each statement updates a whole layer, padded to a
+//   multiple of ROWS_ALIGN rows, so that it compiles to plain SIMD
+//   multiply-adds.
+// It computes the same function as SimpleNeuralNet::FeedForward, but
+// the sums are in another order, so results can differ in the last bits.
+//==================================================================
+
+// Layers are padded to multiples of this, for SIMD
+static constexpr int ROWS_ALIGN = 8;
+
+struct NetDesc
+{
+    size_t           paramSize = 0; // sizeof of the parameters type
+    std::vector<int> arch;          // Layers sizes
+    size_t           paramsN = 0;   // Total number of parameters
+    const void*      pParams = nullptr;
+    const uint32_t*  pActIds = nullptr; // Activation of each layer
+};
+
+//==================================================================
+static bool readNetwork(const CheckpointReader& reader, NetDesc& out)
+{
+    size_t descSize = 0;
+    const auto* pDesc = (const uint32_t*)reader.FindSectionAnySize("net_arch", descSize);
+    if (!pDesc || descSize % sizeof(uint32_t) || descSize < 3 * sizeof(uint32_t))
+        return false;
+
+    out.paramSize = pDesc[0];
+    out.arch.assign(pDesc + 1, pDesc + descSize / sizeof(uint32_t));
+    if (out.paramSize != sizeof(float) && out.paramSize != sizeof(double))
+        return false;
+    for (auto n : out.arch)
+        if (n <= 0)
+            return false;
+
+    out.paramsN = 0;
+    for (size_t l=0; l + 1 < out.arch.size(); ++l)
+        out.paramsN += (size_t)out.arch[l + 1] * (out.arch[l] + 1);
+
+    out.pParams = reader.FindSection("net_params", out.paramsN * out.paramSize);
+    out.pActIds = reader.FindArray<uint32_t>("net_act", out.arch.size() - 1);
+    return out.pParams != nullptr && out.pActIds != nullptr;
+}
+
+//==================================================================
+// Only ReLU is generated
+static bool isAllReLU(const NetDesc& net)
+{
+    for (size_t i=0; i + 1 < net.arch.size(); ++i)
+        if (net.pActIds[i] != Activation::ReLU::ID)
+            return false;
+    return true;
+}
+
+//==================================================================
+// Literal that reads back to the exact same value
+template<typename T>
+static std::string makeLiteral(T x)
+{
+    char buff[64];
+    snprintf(buff, sizeof(buff), std::is_same_v<T, float> ? "%.9g" : "%.17g", (double)x);
+    std::string s = buff;
+    if (s.find_first_of(".e") == std::string::npos)
+        s += ".0";
+    return std::is_same_v<T, float> ? s + "f" : s;
+}
+
+//==================================================================
+template<typename T>
+static bool writeHeader(FILE* pFile, const NetDesc& net, const std::string& name, const std::string& srcPath)
+{
+    const auto* pParams = (const T*)net.pParams;
+    const char* pType = std::is_same_v<T, float> ? "float" : "double";
+    const size_t layersN = net.arch.size() - 1;
+    const auto calcPadded = [](int n) { return (n + ROWS_ALIGN - 1) / ROWS_ALIGN * ROWS_ALIGN; };
+
+    std::string archStr;
+    std::string archList;
+    for (size_t l=0; l < net.arch.size(); ++l)
+    {
+        archStr += (l ? "x" : "") + std::to_string(net.arch[l]);
+        archList += (l ? ", " : "") + std::to_string(net.arch[l]);
+    }
+
+    std::string guard;
+    for (char c : name)
+        guard += (char)toupper(c);
+    guard += "_H";
+
+    fprintf(pFile, "#ifndef %s\n#define %s\n\n", guard.c_str(), guard.c_str());
+    fprintf(pFile, "//==================================================================\n");
+    fprintf(pFile, "// %s - network %s, ReLU on all the layers\n", name.c_str(), archStr.c_str());
+    fprintf(pFile, "// Generated by netcodegen from %s, do not edit\n", srcPath.c_str());
+    fprintf(pFile, "//==================================================================\n");
+    fprintf(pFile, "namespace %s\n{\n", name.c_str());
+    fprintf(pFile, "    inline constexpr int ARCH[] = {%s};\n", archList.c_str());
+    fprintf(pFile, "    inline constexpr int INPUTS_N = %d;\n", net.arch.front());
+    fprintf(pFile, "    inline constexpr int OUTPUTS_N = %d;\n", net.arch.back());
+
+    // Weights as [input][output], from the flat parameters (each layer
+    // is an (outputs x inputs+1) column-major matrix, the bias last)
+    size_t offset = 0;
+    for (size_t l=0; l < layersN; ++l)
+    {
+        const int I = net.arch[l];
+        const int O = net.arch[l + 1];
+        const int PO = calcPadded(O);
+        const T* pLayer = pParams + offset;
+        offset += (size_t)O * (I + 1);
+
+        const auto getParam = [&](int r, int c) { return r < O ? makeLiteral(pLayer[(size_t)c * O + r]) : makeLiteral(T(0)); };
+
+        fprintf(pFile, "\n    // Layer %zu: %d -> %d, weights as [input][output]\n", l, I, O);
+        fprintf(pFile, "    alignas(64) inline constexpr %s W%zu[%d][%d] = {\n", pType, l, I, PO);
+        for (int c=0; c < I; ++c)
+        {
+            fprintf(pFile, "        {");
+            for (int r=0; r < PO; ++r)
+                fprintf(pFile, "%s%s", r ? ", " : "", getParam(r, c).c_str());
+            fprintf(pFile, "},\n");
+        }
+        fprintf(pFile, "    };\n");
+        fprintf(pFile, "    alignas(64) inline constexpr %s B%zu[%d] = {", pType, l, PO);
+        for (int r=0; r < PO; ++r)
+            fprintf(pFile, "%s%s", r ? ", " : "", getParam(r, I).c_str());
+        fprintf(pFile, "};\n");
+    }
+
+    fprintf(pFile, "\n    inline %s Activate(%s x) { return x > 0 ? x : 0; } // ReLU\n", pType, pType);
+
+    // Feed forward: unrolled over the inputs, each statement updates the
+    // whole (padded) layer, so each is a few SIMD multiply-adds
+    // Even and odd inputs go to two sums, to halve the dependency chains
+    fprintf(pFile, "\n    // inputs -> net -> outputs\n");
+    fprintf(pFile, "    inline void FeedForward(const %s* pInputs, %s* pOutputs)\n    {\n", pType, pType);
+    std::string in = "pInputs";
+    for (size_t l=0; l < layersN; ++l)
+    {
+        const int I = net.arch[l];
+        const int PO = calcPadded(net.arch[l + 1]);
+        const bool isLast = l + 1 == layersN;
+        if (l)
+            fprintf(pFile, "\n");
+
+        fprintf(pFile, "        // Layer %zu\n", l);
+        fprintf(pFile, "        alignas(64) %s s%zu[%d];\n", pType, l, PO);
+        fprintf(pFile, "        alignas(64) %s t%zu[%d];\n", pType, l, PO);
+        for (int c=0; c < I; ++c)
+        {
+            fprintf(pFile, "        for (int r=0; r < %d; ++r) ", PO);
+            if (c == 0)
+                fprintf(pFile, "s%zu[r] = B%zu[r] + W%zu[0][r] * %s[0];\n", l, l, l, in.c_str());
+            else
+            if (c == 1)
+                fprintf(pFile, "t%zu[r] = W%zu[1][r] * %s[1];\n", l, l, in.c_str());
+            else
+                fprintf(pFile, "%c%zu[r] += W%zu[%d][r] * %s[%d];\n", c % 2 ? 't' : 's', l, l, c, in.c_str(), c);
+        }
+        if (I == 1)
+            fprintf(pFile, "        for (int r=0; r < %d; ++r) t%zu[r] = 0;\n", PO, l);
+
+        if (isLast)
+        {
+            for (int r=0; r < net.arch[l + 1]; ++r)
+                fprintf(pFile, "        pOutputs[%d] = Activate(s%zu[%d] + t%zu[%d]);\n", r, l, r, l, r);
+        }
+        else
+        {
+            in = "a" + std::to_string(l + 1);
+            fprintf(pFile, "        alignas(64) %s %s[%d];\n", pType, in.c_str(), PO);
+            fprintf(pFile, "        for (int r=0; r < %d; ++r) %s[r] = Activate(s%zu[r] + t%zu[r]);\n", PO, in.c_str(), l, l);
+        }
+    }
+    fprintf(pFile, "    }\n}\n\n#endif\n");
+    return ferror(pFile) == 0;
+}
+
+//==================================================================
+static bool isIdentifier(const std::string& s)
+{
+    if (s.empty() || isdigit((unsigned char)s[0]))
+        return false;
+    for (char c : s)
+        if (!isalnum((unsigned char)c) && c != '_')
+            return false;
+    return true;
+}
+
+//==================================================================
+int main(int argc, char** argv)
+{
+    if (argc != 4)
+    {
+        printf("Usage: netcodegen <checkpoint file> <output header> <name>\n");
+        return 1;
+    }
+    const std::string srcPath = argv[1];
+    const std::string outPath = argv[2];
+    const std::string name = argv[3];
+    if (!isIdentifier(name))
+    {
+        printf("The name %s is not a C++ identifier\n", name.c_str());
+        return 1;
+    }
+
+    CheckpointReader reader;
+    if (!reader.LoadFromFile(srcPath))
+        return 1;
+
+    NetDesc net;
+    if (!readNetwork(reader, net))
+    {
+        printf("No network in the checkpoint file %s\n", srcPath.c_str());
+        return 1;
+    }
+
+    if (!isAllReLU(net))
+    {
+        printf("The network in %s has activations other than ReLU, not supported\n", srcPath.c_str());
+        return 1;
+    }
+
+    // Weights that aren't finite have no literal
+    for (size_t i=0; i < net.paramsN; ++i)
+    {
+        const auto x = net.paramSize == sizeof(float) ? (double)((const float*)net.pParams)[i]
+                                                      : ((const double*)net.pParams)[i];
+        if (!std::isfinite(x))
+        {
+            printf("The network in %s has parameters that are not finite\n", srcPath.c_str());
+            return 1;
+        }
+    }
+
+    FILE* pFile = fopen(outPath.c_str(), "w");
+    if (!pFile)
+    {
+        printf("Could not write the file %s\n", outPath.c_str());
+        return 1;
+    }
+    const auto ok = net.paramSize == sizeof(float)
+                        ? writeHeader<float>(pFile, net, name, srcPath)
+                        : writeHeader<double>(pFile, net, name, srcPath);
+    if (fclose(pFile) != 0 || !ok)
+    {
+        printf("Could not write the file %s\n", outPath.c_str());
+        return 1;
+    }
+    return 0;
+}
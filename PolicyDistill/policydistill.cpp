@@ -0,0 +1,263 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ArchRegistry.h"
+#include "Checkpoint.h"
+#include "PolicyTree.h"
+#include "TrainingTaskDistill.h"
+
+//==================================================================
+// policydistill - distills a trained network into a policy tree, or
+// into a smaller network
+// Usage: policydistill <checkpoint file> <output file> [options]
+//   --net ARCH     distill into a network of architecture ARCH (e.g.
+//                  10x8x3), instead of a tree
+//   --leaves N     leaves of the tree, at most (default 4096)
+//   --depth N      depth of the tree, at most (default 32)
+//   --iters N      rounds of samples from the student's own flights
+//                  (default 4)
+//   --epochs N     training epochs of the network, each round (default 10)
+//   --scenarios N  scenarios to fly, for samples and for the agreement
+//                  (default 300)
+// The checkpoint can be a network file or a training checkpoint (see
+// Checkpoint::SaveNetworkToFile), of a ReLU network of an architecture
+// of lander04, and so can the student network. The first samples are
+// from the teacher's flights, then each round adds the states met by
+// the student, labeled by the teacher (DAgger), so that the student
+// learns the way back from its mistakes.
+// Samples are flown on other scenarios than the trainers', the
+// agreement is measured on held out ones, and the student of the round
+// with the most outcomes like the teacher's is saved. Its landing rate
+// on the trainers' scenarios is reported too, to compare with the
+// training logs.
+//==================================================================
+
+// The architectures of lander04 and lander05, without sensors
+using DistillArchs = LanderArchRegistry<>;
+
+using Policy = std::function<void(const PolicyState&, PolicyActions&)>;
+
+static const uint32_t TRAINERS_START_SEED = 1134; // As TrainingTaskGA
+static const size_t   TRAINERS_SCENARIOS_N = 30;
+static const uint32_t EVAL_START_SEED = 1000000;
+
+struct DistillOptions
+{
+    ArchDesc                  studentArch; // Empty for a tree
+    PolicyTreeParams          treePar;
+    TrainingTaskDistillParams netPar;      // Samples seeds, training
+    size_t                    itersN = 4;
+    size_t                    scenariosN = 300;
+};
+
+//==================================================================
+// Average time of a policy over the states, in ns
+static double calcLookupTimeNs(const std::vector<PolicySample>& samples, const auto& policy)
+{
+    const size_t REPEATS_N = 20;
+    PolicyActions actions;
+    volatile uint32_t sum = 0; // Keeps the calls
+    const auto startTime = std::chrono::steady_clock::now();
+    for (size_t r=0; r < REPEATS_N; ++r)
+    {
+        for (const auto& s : samples)
+        {
+            policy(s.state, actions);
+            sum = sum + CalcActionBits(actions);
+        }
+    }
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return 1e9 * seconds / (double)std::max<size_t>(samples.size() * REPEATS_N, 1);
+}
+
+//==================================================================
+// DistillRounds class - the rounds of a student, whatever it is
+// Each round, "fit(round)" adds samples and fits the student, which is
+// then measured against the teacher, and "keepBest()" is called when
+// it's the best so far
+//==================================================================
+class DistillRounds
+{
+    SimRolloutContext mCtx;
+    ScenarioBank      mEvalScenarios;
+    ScenarioBank      mTrainersScenarios;
+    PolicyAgreement   mBestRes;
+
+public:
+    explicit DistillRounds(size_t scenariosN)
+        : mCtx(SimParams{})
+        , mEvalScenarios(mCtx.sp, EVAL_START_SEED, scenariosN)
+        , mTrainersScenarios(mCtx.sp, TRAINERS_START_SEED, TRAINERS_SCENARIOS_N)
+    {
+    }
+
+    void Run(size_t itersN, const Policy& teacher, const Policy& student, const auto& fit, const auto& keepBest)
+    {
+        for (size_t it=0; it <= itersN; ++it)
+        {
+            printf("Round %zu: ", it);
+            fit(it);
+            const auto res = MeasurePolicyAgreement(mCtx, mEvalScenarios, teacher, student);
+            printf("agreement %.2f%%, landed %.1f%% (teacher %.1f%%), same outcome %.1f%%\n", 100.0 * res.statesAgreeRate,
+                   100.0 * res.landedRateB, 100.0 * res.landedRateA, 100.0 * res.sameOutcomeRate);
+            if (it == 0 || res.sameOutcomeRate > mBestRes.sameOutcomeRate)
+            {
+                keepBest();
+                mBestRes = res;
+            }
+        }
+    }
+
+    // Of the best student, once it's back in place
+    void PrintBest(const Policy& teacher, const Policy& student, const std::vector<PolicySample>& samples) const
+    {
+        const auto res = MeasurePolicyAgreement(mCtx, mTrainersScenarios, teacher, student);
+        printf("Best: agreement %.2f%%, same outcome %.1f%%\n", 100.0 * mBestRes.statesAgreeRate, 100.0 * mBestRes.sameOutcomeRate);
+        printf("Trainers' scenarios: landed %.1f%% (teacher %.1f%%), score %.2f (teacher %.2f)\n",
+               100.0 * res.landedRateB, 100.0 * res.landedRateA, res.meanScoreB, res.meanScoreA);
+        printf("Lookup: student %.1f ns, teacher %.1f ns\n",
+               calcLookupTimeNs(samples, student), calcLookupTimeNs(samples, teacher));
+    }
+};
+
+//==================================================================
+static bool distillTree(const Policy& teacher, const std::string& outPath, const DistillOptions& opt)
+{
+    PolicyTree tree;
+    PolicyTree bestTree;
+    const Policy student = [&](const PolicyState& s, PolicyActions& a) { tree.FeedForward(s, a); };
+
+    const SimRolloutContext ctx(SimParams{});
+    const ScenarioBank scenarios(ctx.sp, opt.netPar.samplesStartSeed, opt.scenariosN);
+    std::vector<PolicySample> samples;
+    DistillRounds rounds(opt.scenariosN);
+    rounds.Run(opt.itersN, teacher, student, [&](size_t it) {
+        CollectPolicySamples(ctx, scenarios, it == 0 ? teacher : student, teacher, samples);
+        tree.Build(samples, opt.treePar);
+        printf("%zu samples, %zu leaves, depth %d, ", samples.size(), tree.GetLeavesN(), tree.CalcDepth());
+    }, [&]() { bestTree = tree; });
+
+    tree = bestTree;
+    rounds.PrintBest(teacher, student, samples);
+    if (!tree.SaveToFile(outPath))
+    {
+        printf("Failed to save the tree to %s\n", outPath.c_str());
+        return false;
+    }
+    printf("Saved %s (%zu nodes)\n", outPath.c_str(), tree.GetNodesN());
+    return true;
+}
+
+//==================================================================
+template<NetArch auto netArch>
+static bool distillNet(const Policy& teacher, const std::string& outPath, const DistillOptions& opt)
+{
+    using NeuralNet = SimpleNeuralNet<float, netArch>;
+    auto par = opt.netPar;
+    par.roundsN = opt.itersN + 1;
+    par.scenariosN = opt.scenariosN;
+    TrainingTaskDistill<float, netArch> task(par, SimParams{}, teacher);
+
+    NeuralNet net;
+    NeuralNet bestNet;
+    const Policy student = [&](const PolicyState& s, PolicyActions& a) { net.FeedForward(s, a); };
+
+    DistillRounds rounds(opt.scenariosN);
+    rounds.Run(opt.itersN, teacher, student, [&](size_t) {
+        task.RunIteration();
+        net = task.GetStudentNetwork();
+        printf("%zu samples, accuracy %.2f%%, ", task.GetSamplesN(), 100.0 * task.GetLastStats().accuracy);
+    }, [&]() { bestNet = net; });
+
+    net = bestNet;
+    // The teacher's states, to time the lookups
+    const SimRolloutContext ctx(SimParams{});
+    std::vector<PolicySample> samples;
+    CollectPolicySamples(ctx, ScenarioBank(ctx.sp, par.samplesStartSeed, opt.scenariosN), teacher, teacher, samples);
+    rounds.PrintBest(teacher, student, samples);
+    if (!Checkpoint::SaveNetworkToFile(outPath, net))
+    {
+        printf("Failed to save the network to %s\n", outPath.c_str());
+        return false;
+    }
+    printf("Saved %s (%s, %zu parameters)\n", outPath.c_str(), ArchToString(MakeArchDesc<netArch>()).c_str(),
+           (size_t)NeuralNet::CalcTotalParameters());
+    return true;
+}
+
+//==================================================================
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        printf("Usage: policydistill <checkpoint file> <output file> [--net ARCH] [--leaves N] [--depth N] [--iters N]"
+               " [--epochs N] [--scenarios N]\n");
+        return 1;
+    }
+
+    DistillOptions opt;
+    for (int i=3; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto value = i + 1 < argc ? atoi(argv[i + 1]) : -1;
+        if (arg == "--net" && i + 1 < argc && ParseArch(argv[i + 1], opt.studentArch))
+            ;
+        else if (arg == "--leaves" && value > 0)
+            opt.treePar.maxLeavesN = (size_t)value;
+        else if (arg == "--depth" && value > 0)
+            opt.treePar.maxDepth = value;
+        else if (arg == "--iters" && value >= 0)
+            opt.itersN = (size_t)value;
+        else if (arg == "--epochs" && value > 0)
+            opt.netPar.supervised.epochsN = (size_t)value;
+        else if (arg == "--scenarios" && value > 0)
+            opt.scenariosN = (size_t)value;
+        else
+        {
+            printf("Invalid option %s\n", arg.c_str());
+            return 1;
+        }
+        ++i;
+    }
+    if (!opt.studentArch.empty() && !DistillArchs::Has(opt.studentArch))
+    {
+        DistillArchs::PrintNotBuiltIn(opt.studentArch);
+        return 1;
+    }
+
+    CheckpointReader reader;
+    if (!reader.LoadFromFile(argv[1]))
+        return 1;
+
+    // The architecture, to pick the network's type
+    size_t descSize = 0;
+    const auto* pDesc = (const uint32_t*)reader.FindSectionAnySize("net_arch", descSize);
+    if (!pDesc || descSize < 3 * sizeof(uint32_t) || descSize % sizeof(uint32_t) || pDesc[0] != sizeof(float))
+    {
+        printf("No float network in the checkpoint file %s\n", argv[1]);
+        return 1;
+    }
+    const ArchDesc arch(pDesc + 1, pDesc + descSize / sizeof(uint32_t));
+
+    // The teacher, of any architecture
+    Policy teacher;
+    if (!DistillArchs::Dispatch(arch, [&]<NetArch auto netArch>() {
+            auto pNet = std::make_shared<SimpleNeuralNet<float, netArch>>();
+            if (Checkpoint::LoadNetworkFromFile(argv[1], *pNet))
+                teacher = [pNet](const PolicyState& s, PolicyActions& a) { pNet->FeedForward(s, a); };
+        }))
+        DistillArchs::PrintNotBuiltIn(arch);
+    if (!teacher)
+        return 1;
+
+    bool ok = false;
+    if (opt.studentArch.empty())
+        ok = distillTree(teacher, argv[2], opt);
+    else
+        DistillArchs::Dispatch(opt.studentArch, [&]<NetArch auto netArch>() { ok = distillNet<netArch>(teacher, argv[2], opt); });
+    return ok ? 0 : 1;
+}
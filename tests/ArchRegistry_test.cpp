@@ -0,0 +1,108 @@
+#include <vector>
+#include <gtest/gtest.h>
+#include "ArchRegistry.h"
+#include "TrainingTaskGA.h"
+#include "TrainingTaskRES.h"
+
+// Objects made from the registry must behave exactly as the ones of the
+// same architecture made statically.
+
+//==================================================================
+static constexpr std::array<int, 3> REG_SMALL_ARCH {SIM_BRAINSTATE_N, 8, SIM_BRAINACTION_N};
+static constexpr std::array<int, 4> REG_NET_ARCH {SIM_BRAINSTATE_N, 12, 12, SIM_BRAINACTION_N};
+using TestArchs = ArchRegistry<float, REG_SMALL_ARCH, REG_NET_ARCH>;
+static constexpr size_t REG_ITERATIONS_N = 3;
+
+template<typename NeuralNet>
+static std::vector<float> getNetParams(const NeuralNet& net)
+{
+    std::vector<float> params(net.GetTotalParameterCount());
+    net.CopyParametersTo(params.data());
+    return params;
+}
+
+TEST(ArchRegistryTest, Dispatch)
+{
+    ArchDesc arch;
+    ASSERT_TRUE(ParseArch("10x12x12x3", arch));
+    EXPECT_EQ(arch, MakeArchDesc<REG_NET_ARCH>());
+    EXPECT_EQ(ArchToString(arch), "10x12x12x3");
+    EXPECT_FALSE(ParseArch("10x", arch));
+    EXPECT_FALSE(ParseArch("10", arch));
+    EXPECT_FALSE(ParseArch("10x0x3", arch));
+
+    EXPECT_EQ(TestArchs::GetArchs().size(), 2u);
+    EXPECT_TRUE(TestArchs::Has(MakeArchDesc<REG_SMALL_ARCH>()));
+    EXPECT_FALSE(TestArchs::Has({SIM_BRAINSTATE_N, 9, SIM_BRAINACTION_N}));
+
+    size_t paramsN = 0;
+    EXPECT_TRUE(TestArchs::Dispatch(MakeArchDesc<REG_SMALL_ARCH>(), [&]<NetArch auto netArch>() {
+        paramsN = SimpleNeuralNet<float, netArch>::CalcTotalParameters();
+    }));
+    EXPECT_EQ(paramsN, (SimpleNeuralNet<float, REG_SMALL_ARCH>::CalcTotalParameters()));
+    EXPECT_FALSE(TestArchs::Dispatch({SIM_BRAINSTATE_N, SIM_BRAINACTION_N}, []<NetArch auto>() {}));
+    EXPECT_EQ(TestArchs::MakeNet({SIM_BRAINSTATE_N, SIM_BRAINACTION_N}, 1234), nullptr);
+}
+
+TEST(ArchRegistryTest, NeuralNet)
+{
+    auto pNet = TestArchs::MakeNet(MakeArchDesc<REG_NET_ARCH>(), 1234);
+    ASSERT_NE(pNet, nullptr);
+    EXPECT_EQ(pNet->GetArch(), MakeArchDesc<REG_NET_ARCH>());
+
+    SimpleNeuralNet<float, REG_NET_ARCH> net;
+    net.InitializeRandomParameters(1234);
+    EXPECT_EQ(getNetParams(*pNet), getNetParams(net));
+
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    for (int i = 0; i < 100; ++i)
+    {
+        SimpleNeuralNet<float, REG_NET_ARCH>::Inputs inputs;
+        for (auto& x : inputs)
+            x = dist(rng);
+
+        SimpleNeuralNet<float, REG_NET_ARCH>::Outputs outputs;
+        float anyOutputs[SIM_BRAINACTION_N];
+        net.FeedForward(inputs, outputs);
+        pNet->FeedForward(inputs.data(), anyOutputs);
+        for (int j = 0; j < SIM_BRAINACTION_N; ++j)
+            EXPECT_EQ(anyOutputs[j], outputs[j]);
+    }
+}
+
+TEST(ArchRegistryTest, TrainingTasks)
+{
+    // GA
+    auto pGA = TestArchs::MakeTask(MakeArchDesc<REG_NET_ARCH>(), [&]<NetArch auto netArch>() {
+        return std::make_unique<TrainingTaskGA<float, netArch>>(SimParams{}, REG_ITERATIONS_N, 16, 0.1, 0.3, 1234);
+    });
+    ASSERT_NE(pGA, nullptr);
+    TrainingTaskGA<float, REG_NET_ARCH> ga(SimParams{}, REG_ITERATIONS_N, 16, 0.1, 0.3, 1234);
+    while (!pGA->IsTrainingComplete())
+        pGA->RunIteration(true);
+    while (!ga.IsTrainingComplete())
+        ga.RunIteration();
+
+    EXPECT_EQ(pGA->GetCurrentGeneration(), REG_ITERATIONS_N);
+    EXPECT_EQ(pGA->GetBestScore(), ga.GetBestScore());
+    EXPECT_EQ(getNetParams(*pGA->GetBestNetwork()), getNetParams(ga.GetBestIndividualNetwork()));
+
+    // RES
+    TrainingTaskRESParams par;
+    par.maxGenerations = REG_ITERATIONS_N;
+    par.numPerturbations = 8;
+    auto pRES = TestArchs::MakeTask(MakeArchDesc<REG_SMALL_ARCH>(), [&]<NetArch auto netArch>() {
+        return std::make_unique<TrainingTaskRES<float, netArch>>(par, SimParams{});
+    });
+    ASSERT_NE(pRES, nullptr);
+    EXPECT_EQ(pRES->GetArch(), MakeArchDesc<REG_SMALL_ARCH>());
+    TrainingTaskRES<float, REG_SMALL_ARCH> res(par, SimParams{});
+    while (!pRES->IsTrainingComplete())
+        pRES->RunIteration(true);
+    while (!res.IsTrainingComplete())
+        res.RunIteration();
+
+    EXPECT_EQ(pRES->GetBestScore(), res.GetBestScore());
+    EXPECT_EQ(getNetParams(*pRES->GetBestNetwork()), getNetParams(res.GetCentralNetwork()));
+}
@@ -0,0 +1,186 @@
+#include <cstdio>
+#include <string>
+#include <gtest/gtest.h>
+#include "Checkpoint.h"
+#include "TrainingTaskGA.h"
+#include "TrainingTaskRES.h"
+
+// Training resumed from a checkpoint must match, bit for bit, the same
+// training run without interruption.
+
+//==================================================================
+static constexpr std::array<int, 4> CKPT_NET_ARCH {SIM_BRAINSTATE_N, 12, 12, SIM_BRAINACTION_N};
+static constexpr std::array<int, 3> CKPT_OTHER_NET_ARCH {SIM_BRAINSTATE_N, 8, SIM_BRAINACTION_N};
+static constexpr size_t CKPT_ITERATIONS_N = 6;
+static constexpr size_t CKPT_SAVE_AT_N = 3;
+
+template<typename NeuralNet>
+static std::vector<float> getNetParams(const NeuralNet& net)
+{
+    std::vector<float> params(NeuralNet::CalcTotalParameters());
+    net.CopyParametersTo(params.data());
+    return params;
+}
+
+TEST(CheckpointTest, GAResume)
+{
+    using TrainingTask = TrainingTaskGA<float, CKPT_NET_ARCH>;
+    const std::string path = "ckpt_test_ga.bin";
+
+    SimRunOptions ro;
+    ro.EARLY_TERMINATION = true;
+    const auto makeTask = [&]() {
+        auto pTask = std::make_unique<TrainingTask>(SimParams{}, CKPT_ITERATIONS_N, 32, 0.1, 0.3, 1234, ro);
+        pTask->SetCoarseFidelity(4, 2); // The phase switch falls in the resumed part
+        return pTask;
+    };
+
+    auto pStraight = makeTask();
+    for (size_t i = 0; i < CKPT_ITERATIONS_N; ++i)
+        pStraight->RunIteration();
+
+    {
+        auto pFirst = makeTask();
+        for (size_t i = 0; i < CKPT_SAVE_AT_N; ++i)
+            pFirst->RunIteration();
+        ASSERT_TRUE(pFirst->SaveCheckpoint(path));
+    }
+
+    auto pResumed = makeTask();
+    ASSERT_TRUE(pResumed->LoadCheckpoint(path));
+    EXPECT_EQ(pResumed->GetCurrentGeneration(), CKPT_SAVE_AT_N);
+    while (!pResumed->IsTrainingComplete())
+        pResumed->RunIteration();
+
+    EXPECT_EQ(pResumed->GetBestScore(), pStraight->GetBestScore());
+    EXPECT_EQ(pResumed->IsCoarsePhase(), pStraight->IsCoarsePhase());
+    EXPECT_EQ(getNetParams(pResumed->GetBestIndividualNetwork()),
+              getNetParams(pStraight->GetBestIndividualNetwork()));
+
+    // The best network can be loaded alone
+    TrainingTask::NeuralNet net;
+    ASSERT_TRUE(Checkpoint::LoadNetworkFromFile(path, net));
+
+    // Not with another population size
+    TrainingTask other(SimParams{}, CKPT_ITERATIONS_N, 16, 0.1, 0.3, 1234, ro);
+    EXPECT_FALSE(other.LoadCheckpoint(path));
+
+    std::remove(path.c_str());
+}
+
+// Warm started, with parameters past the random ones' range: resumed
+// without the initial network, the mutations keep the same limit
+TEST(CheckpointTest, GAWarmStartResume)
+{
+    using TrainingTask = TrainingTaskGA<float, CKPT_OTHER_NET_ARCH>;
+    const std::string path = "ckpt_test_ga_warm.bin";
+
+    TrainingTask::NeuralNet initialNet;
+    initialNet.InitializeRandomParameters(1234);
+    auto initialParams = getNetParams(initialNet);
+    for (auto& p : initialParams)
+        p *= 5.0f;
+    initialNet.SetParametersFrom(initialParams.data());
+
+    SimRunOptions ro;
+    ro.EARLY_TERMINATION = true;
+    const auto makeTask = [&]() {
+        return std::make_unique<TrainingTask>(SimParams{}, CKPT_ITERATIONS_N, 32, 0.5, 0.3, 1234, ro);
+    };
+
+    auto pStraight = makeTask();
+    pStraight->SetInitialNetwork(initialNet);
+    for (size_t i = 0; i < CKPT_ITERATIONS_N; ++i)
+        pStraight->RunIteration();
+
+    {
+        auto pFirst = makeTask();
+        pFirst->SetInitialNetwork(initialNet);
+        for (size_t i = 0; i < CKPT_SAVE_AT_N; ++i)
+            pFirst->RunIteration();
+        ASSERT_TRUE(pFirst->SaveCheckpoint(path));
+    }
+
+    auto pResumed = makeTask();
+    ASSERT_TRUE(pResumed->LoadCheckpoint(path));
+    while (!pResumed->IsTrainingComplete())
+        pResumed->RunIteration();
+
+    EXPECT_EQ(pResumed->GetBestScore(), pStraight->GetBestScore());
+    EXPECT_EQ(getNetParams(pResumed->GetBestIndividualNetwork()),
+              getNetParams(pStraight->GetBestIndividualNetwork()));
+
+    std::remove(path.c_str());
+}
+
+TEST(CheckpointTest, RESResume)
+{
+    using TrainingTask = TrainingTaskRES<float, CKPT_NET_ARCH>;
+    const std::string path = "ckpt_test_res.bin";
+
+    TrainingTask::Params par;
+    par.maxGenerations = CKPT_ITERATIONS_N;
+    par.numPerturbations = 8;
+
+    TrainingTask straight(par, SimParams{});
+    for (size_t i = 0; i < CKPT_ITERATIONS_N; ++i)
+        straight.RunIteration();
+
+    {
+        TrainingTask first(par, SimParams{});
+        for (size_t i = 0; i < CKPT_SAVE_AT_N; ++i)
+            first.RunIteration();
+        ASSERT_TRUE(first.SaveCheckpoint(path));
+    }
+
+    TrainingTask resumed(par, SimParams{});
+    ASSERT_TRUE(resumed.LoadCheckpoint(path));
+    while (!resumed.IsTrainingComplete())
+        resumed.RunIteration();
+
+    EXPECT_EQ(resumed.GetBestScore(), straight.GetBestScore());
+    EXPECT_EQ(getNetParams(resumed.GetCentralNetwork()),
+              getNetParams(straight.GetCentralNetwork()));
+
+    // Networks of another architecture are rejected
+    SimpleNeuralNet<float, CKPT_OTHER_NET_ARCH> otherNet;
+    EXPECT_FALSE(Checkpoint::LoadNetworkFromFile(path, otherNet));
+
+    // And of other activations
+    SimpleNeuralNet<float, CKPT_NET_ARCH, Activation::Layers<Activation::ReLU, Activation::ReLU, Activation::Tanh>> tanhNet;
+    EXPECT_FALSE(Checkpoint::LoadNetworkFromFile(path, tanhNet));
+
+    std::remove(path.c_str());
+}
+
+TEST(CheckpointTest, GAHalfStorageResume)
+{
+    using TrainingTask = TrainingTaskGA<float, CKPT_NET_ARCH, Float16>;
+    const std::string path = "ckpt_test_ga_f16.bin";
+
+    TrainingTask straight(SimParams{}, CKPT_ITERATIONS_N, 32, 0.1, 0.3, 1234);
+    for (size_t i = 0; i < CKPT_ITERATIONS_N; ++i)
+        straight.RunIteration();
+
+    {
+        TrainingTask first(SimParams{}, CKPT_ITERATIONS_N, 32, 0.1, 0.3, 1234);
+        for (size_t i = 0; i < CKPT_SAVE_AT_N; ++i)
+            first.RunIteration();
+        ASSERT_TRUE(first.SaveCheckpoint(path));
+    }
+
+    TrainingTask resumed(SimParams{}, CKPT_ITERATIONS_N, 32, 0.1, 0.3, 1234);
+    ASSERT_TRUE(resumed.LoadCheckpoint(path));
+    while (!resumed.IsTrainingComplete())
+        resumed.RunIteration();
+
+    EXPECT_EQ(resumed.GetBestScore(), straight.GetBestScore());
+    EXPECT_EQ(getNetParams(resumed.GetBestIndividualNetwork()),
+              getNetParams(straight.GetBestIndividualNetwork()));
+
+    // Not with parameters stored in another type of the same size
+    TrainingTaskGA<float, CKPT_NET_ARCH, BFloat16> other(SimParams{}, CKPT_ITERATIONS_N, 32, 0.1, 0.3, 1234);
+    EXPECT_FALSE(other.LoadCheckpoint(path));
+
+    std::remove(path.c_str());
+}
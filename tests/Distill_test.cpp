@@ -0,0 +1,163 @@
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "TrainingTaskDistill.h"
+#include "TrainingTaskGA.h"
+#include "TrainingTaskRES.h"
+
+//==================================================================
+static constexpr std::array<int, 4> DST_GRAD_ARCH {SIM_BRAINSTATE_N, 6, 5, SIM_BRAINACTION_N};
+static constexpr std::array<int, 3> DST_STUDENT_ARCH {SIM_BRAINSTATE_N, 8, SIM_BRAINACTION_N};
+
+//==================================================================
+// Backward pass against finite differences, with smooth activations
+TEST(DistillTest, backwardGradients)
+{
+    using Net = SimpleNeuralNet<double, DST_GRAD_ARCH,
+                                Activation::Layers<Activation::Tanh, Activation::LeakyReLU, Activation::Sigmoid>>;
+    SimpleNeuralNet<float, DST_GRAD_ARCH> initNet;
+    initNet.InitializeRandomParameters(1234);
+    std::vector<float> initParams(Net::CalcTotalParameters());
+    initNet.CopyParametersTo(initParams.data());
+    std::vector<double> params(initParams.begin(), initParams.end());
+
+    std::mt19937 rng(1);
+    std::normal_distribution<double> dist(0.0, 1.0);
+    Net::Inputs inputs;
+    for (auto& x : inputs)
+        x = dist(rng);
+    for (auto& p : params)
+        p += 0.1 * dist(rng); // Biases too
+
+    // Loss: <outputs, weights>
+    const Net::Outputs weights(0.7, -1.3, 0.4);
+    const auto calcLoss = [&](const std::vector<double>& ps) {
+        Net::Outputs outputs;
+        Net::FeedForward(ps.data(), inputs, outputs);
+        return outputs.dot(weights);
+    };
+
+    std::array<double, Net::TRACE_SIZE> trace;
+    Net::Outputs outputs;
+    Net::FeedForwardTrace(params.data(), inputs, trace.data(), outputs);
+    Net::Outputs expected;
+    Net::FeedForward(params.data(), inputs, expected);
+    EXPECT_EQ(outputs, expected);
+
+    std::vector<double> grads(params.size(), 0.0);
+    Net::Backward(params.data(), inputs, trace.data(), weights, grads.data());
+    for (size_t i = 0; i < params.size(); ++i)
+    {
+        const double h = 1e-6;
+        auto ps = params;
+        ps[i] += h;
+        const auto lossUp = calcLoss(ps);
+        ps[i] -= 2 * h;
+        const auto numGrad = (lossUp - calcLoss(ps)) / (2 * h);
+        EXPECT_NEAR(grads[i], numGrad, 1e-6 * (1 + std::abs(numGrad))) << "parameter " << i;
+    }
+}
+
+// Trained on scaled states, the folded network is the same on states
+TEST(DistillTest, foldInputsScaling)
+{
+    using Net = SimpleNeuralNet<float, DST_STUDENT_ARCH>;
+    std::vector<PolicySample> samples(100);
+    std::mt19937 rng(1);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    for (auto& s : samples)
+        for (int i = 0; i < SIM_BRAINSTATE_N; ++i)
+            s.state[i] = i == SIM_BRAINSTATE_LANDER_STATE_LANDED ? 0.0f : 100.0f * (float)i + 50.0f * dist(rng);
+
+    const auto scaling = CalcInputsScaling(samples);
+    EXPECT_EQ(scaling.invStd[SIM_BRAINSTATE_LANDER_STATE_LANDED], 1.0f);
+
+    Net net;
+    net.InitializeRandomParameters(1234);
+    std::vector<float> params(Net::CalcTotalParameters());
+    net.CopyParametersTo(params.data());
+    auto folded = params;
+    FoldInputsScaling<Net>(folded.data(), scaling);
+    for (const auto& s : samples)
+    {
+        Net::Outputs outputs;
+        Net::Outputs expected;
+        Net::FeedForward(folded.data(), s.state, outputs);
+        Net::FeedForward(params.data(), scaling.Apply(s.state), expected);
+        for (int i = 0; i < SIM_BRAINACTION_N; ++i)
+            EXPECT_NEAR(outputs[i], expected[i], 1e-4f * (1.0f + std::abs(expected[i])));
+    }
+}
+
+// A small network learns to land like the controller
+TEST(DistillTest, distillController)
+{
+    TrainingTaskDistillParams par;
+    par.roundsN = 3;
+    par.scenariosN = 100;
+    TrainingTaskDistill<float, DST_STUDENT_ARCH> task(par, SimParams{}, GetFixedBrainActions);
+    while (!task.IsTrainingComplete())
+        task.RunIteration();
+    EXPECT_EQ(task.GetCurrentRound(), 3u);
+    EXPECT_GE(task.GetLastStats().accuracy, 0.9);
+
+    const SimRolloutContext ctx(SimParams{});
+    const ScenarioBank scenarios(ctx.sp, 1134, 100);
+    const auto student = task.GetStudentNetwork();
+    const auto res = MeasurePolicyAgreement(ctx, scenarios, GetFixedBrainActions,
+                                            [&](const PolicyState& s, PolicyActions& a) { student.FeedForward(s, a); });
+    EXPECT_GE(res.statesAgreeRate, 0.9);
+    EXPECT_NEAR(res.landedRateB, res.landedRateA, 0.1);
+}
+
+// Plain SGD fits the controller too
+TEST(DistillTest, trainWithSgd)
+{
+    const SimRolloutContext ctx(SimParams{});
+    const ScenarioBank scenarios(ctx.sp, 2000000, 100);
+    std::vector<PolicySample> samples;
+    CollectPolicySamples(ctx, scenarios, GetFixedBrainActions, GetFixedBrainActions, samples);
+
+    using Net = SimpleNeuralNet<float, DST_STUDENT_ARCH>;
+    std::vector<float> params(Net::CalcTotalParameters());
+    Net net;
+    net.InitializeRandomParameters(1234);
+    net.CopyParametersTo(params.data());
+    // Outputs at the threshold (see TrainingTaskDistill)
+    Eigen::Map<Eigen::Matrix<float, SIM_BRAINACTION_N, 9>>(params.data() + Net::CalcLayerOffset(1)).col(8).setConstant(0.5f);
+
+    SupervisedParams par;
+    par.epochsN = 20;
+    par.learningRate = 0.02;
+    SgdOptimizer<float> optimizer(params.size());
+    std::mt19937 rng(par.seed);
+    const auto stats = TrainOnSamples<Net>(params.data(), samples, CalcInputsScaling(samples), par, optimizer, rng);
+    EXPECT_GE(stats.accuracy, 0.9);
+}
+
+// Trainers started from a clone of the controller are ahead of random ones
+TEST(DistillTest, warmStart)
+{
+    TrainingTaskDistillParams par;
+    par.roundsN = 2;
+    par.scenariosN = 100;
+    const auto clone = CloneFixedBrain<float, DST_STUDENT_ARCH>(par);
+
+    SimRunOptions ro;
+    ro.EARLY_TERMINATION = true;
+    TrainingTaskRESParams resPar;
+    resPar.maxGenerations = 1;
+    TrainingTaskRES<float, DST_STUDENT_ARCH> coldRES(resPar, SimParams{}, ro);
+    TrainingTaskRES<float, DST_STUDENT_ARCH> warmRES(resPar, SimParams{}, ro);
+    warmRES.SetInitialNetwork(clone);
+    EXPECT_GT(warmRES.GetBestScore(), coldRES.GetBestScore() + 5.0);
+
+    // The clone is in the population, and mutations stay around it
+    TrainingTaskGA<float, DST_STUDENT_ARCH> coldGA(SimParams{}, 1, 20, 0.1, 0.01, 1234, ro);
+    TrainingTaskGA<float, DST_STUDENT_ARCH> warmGA(SimParams{}, 1, 20, 0.1, 0.01, 1234, ro);
+    warmGA.SetInitialNetwork(clone);
+    coldGA.RunIteration(false);
+    warmGA.RunIteration(false);
+    EXPECT_GE(warmGA.GetBestScore(), warmRES.GetBestScore());
+    EXPECT_GT(warmGA.GetBestScore(), coldGA.GetBestScore() + 5.0);
+}
@@ -0,0 +1,180 @@
+#include <random>
+#include <gtest/gtest.h>
+#include "FixedBrain.h"
+#include "ScenarioBank.h"
+#include "SimRollout.h"
+#include "SimpleNeuralNet.h"
+
+//==================================================================
+static constexpr std::array<int, 4> ET_NET_ARCH {SIM_BRAINSTATE_N, 12, 12, SIM_BRAINACTION_N};
+
+using ETBrainState = Eigen::Vector<float, SIM_BRAINSTATE_N>;
+using ETBrainActions = Eigen::Vector<float, SIM_BRAINACTION_N>;
+
+struct ETEndState
+{
+    double score = 0;
+    Vector2 pos {0.0f, 0.0f};
+    Vector2 vel {0.0f, 0.0f};
+    bool isLanded = false;
+    bool isCrashed = false;
+    size_t brainStepsN = 0;
+};
+
+static ETEndState runSim(const SimScenario& sc, const SimRunOptions& ro, const auto& brain)
+{
+    ETEndState st;
+    Simulation sim(SimParams{}, sc, ro);
+    while (!sim.IsSimulationComplete() && sim.GetElapsedTimeS() < Simulation::MAX_TIME_S)
+    {
+        sim.AnimateSim([&](const ETBrainState& in, ETBrainActions& out) {
+            ++st.brainStepsN;
+            brain(in, out);
+        });
+    }
+    st.score = sim.CalculateScore();
+    st.pos = sim.mLander.mPos;
+    st.vel = sim.mLander.mVel;
+    st.isLanded = sim.mLander.mStateIsLanded;
+    st.isCrashed = sim.mLander.mStateIsCrashed;
+    return st;
+}
+
+static ETEndState runRollout(const SimScenario& sc, const SimRunOptions& ro, const auto& brain)
+{
+    ETEndState st;
+    const SimRolloutContext ctx(SimParams{}, ro);
+    SimRollout sim(ctx, sc);
+    while (!sim.IsSimulationComplete() && !sim.IsTimeOut())
+    {
+        sim.AnimateSim([&](const ETBrainState& in, ETBrainActions& out) {
+            ++st.brainStepsN;
+            brain(in, out);
+        });
+    }
+    st.score = sim.CalculateScore();
+    st.isLanded = sim.IsLanded();
+    st.isCrashed = sim.IsCrashed();
+    return st;
+}
+
+// Runs the brain on the scenarios, with and without early termination,
+// and expects the same ends. Returns the brain steps of both.
+static std::pair<size_t, size_t> expectSameEnds(const ScenarioBank& scenarios, int actionRepeat, const auto& brain)
+{
+    SimRunOptions fullRo;
+    fullRo.ACTION_REPEAT = actionRepeat;
+    auto earlyRo = fullRo;
+    earlyRo.EARLY_TERMINATION = true;
+
+    std::pair<size_t, size_t> brainStepsN {0, 0};
+    for (size_t i = 0; i < scenarios.GetSize(); ++i)
+    {
+        const auto& sc = scenarios.GetScenario(i);
+        const auto full = runSim(sc, fullRo, brain);
+        const auto early = runSim(sc, earlyRo, brain);
+        EXPECT_EQ(early.score, full.score) << "seed " << sc.seed;
+        EXPECT_EQ(early.pos.x, full.pos.x) << "seed " << sc.seed;
+        EXPECT_EQ(early.pos.y, full.pos.y) << "seed " << sc.seed;
+        EXPECT_EQ(early.vel.x, full.vel.x) << "seed " << sc.seed;
+        EXPECT_EQ(early.vel.y, full.vel.y) << "seed " << sc.seed;
+        EXPECT_EQ(early.isLanded, full.isLanded) << "seed " << sc.seed;
+        EXPECT_EQ(early.isCrashed, full.isCrashed) << "seed " << sc.seed;
+
+        // The rollouts too, against the full Simulation
+        const auto fullRollout = runRollout(sc, fullRo, brain);
+        const auto earlyRollout = runRollout(sc, earlyRo, brain);
+        EXPECT_EQ(fullRollout.score, full.score) << "seed " << sc.seed;
+        EXPECT_EQ(earlyRollout.score, full.score) << "seed " << sc.seed;
+        EXPECT_EQ(earlyRollout.isLanded, full.isLanded) << "seed " << sc.seed;
+        EXPECT_EQ(earlyRollout.isCrashed, full.isCrashed) << "seed " << sc.seed;
+
+        brainStepsN.first += full.brainStepsN;
+        brainStepsN.second += early.brainStepsN;
+    }
+    return brainStepsN;
+}
+
+//==================================================================
+// The ballistic fall is the same as the steps of the lander without
+// thrust, to the last bit, up to the contact height or the timeout
+TEST(EarlyTerminationTest, ballisticEndMatchesSteps)
+{
+    const SimParams sp;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> xDist(-sp.SCREEN_WIDTH * 0.7f, sp.SCREEN_WIDTH * 0.7f);
+    std::uniform_real_distribution<float> yDist(0.0f, sp.SCREEN_HEIGHT);
+    std::uniform_real_distribution<float> vDist(-8.0f, 8.0f);
+    std::uniform_int_distribution<int> stepsDist(0, 400);
+    for (int i = 0; i < 1000; ++i)
+    {
+        Lander lander(sp, Vector2{xDist(rng), yDist(rng)});
+        lander.mVel = {vDist(rng), vDist(rng)};
+        lander.mFuel = 0;
+        const auto contactY = yDist(rng) * 0.5f;
+        const int64_t maxStepsN = i == 0 ? 0 : stepsDist(rng);
+
+        auto pos = lander.mPos;
+        auto vel = lander.mVel;
+        int64_t fallStepsN = 0;
+        const auto isContact = fallBallistic(sp, contactY, pos, vel, [&]() {
+            return fallStepsN < maxStepsN ? (++fallStepsN, true) : false;
+        });
+
+        int64_t stepsN = 0;
+        while (stepsN < maxStepsN && !(stepsN && lander.mPos.y <= contactY))
+        {
+            lander.AnimLander();
+            ++stepsN;
+        }
+        EXPECT_EQ(fallStepsN, stepsN);
+        EXPECT_EQ(isContact, stepsN > 0 && lander.mPos.y <= contactY);
+        EXPECT_EQ(pos.x, lander.mPos.x);
+        EXPECT_EQ(pos.y, lander.mPos.y);
+        EXPECT_EQ(vel.x, lander.mVel.x);
+        EXPECT_EQ(vel.y, lander.mVel.y);
+    }
+}
+
+//==================================================================
+// Greedy thrust: the fuel runs out soon, and most of the run is a fall
+TEST(EarlyTerminationTest, sameEndsOutOfFuel)
+{
+    const ScenarioBank scenarios(SimParams{}, 1134, 30);
+    const auto upBrain = [](const ETBrainState&, ETBrainActions& out) { out = {1.0f, 0.0f, 0.0f}; };
+    const auto sideBrain = [](const ETBrainState& in, ETBrainActions& out) {
+        out = {1.0f, 0.0f, 0.0f};
+        out[in[SIM_BRAINSTATE_LANDER_X] < in[SIM_BRAINSTATE_PAD_X] ? SIM_BRAINACTION_RIGHT : SIM_BRAINACTION_LEFT] = 1.0f;
+    };
+    for (const int actionRepeat : {1, 4})
+    {
+        const auto upStepsN = expectSameEnds(scenarios, actionRepeat, upBrain);
+        EXPECT_LT(upStepsN.second, upStepsN.first / 2);
+        const auto sideStepsN = expectSameEnds(scenarios, actionRepeat, sideBrain);
+        EXPECT_LT(sideStepsN.second, sideStepsN.first / 2);
+    }
+}
+
+// Brains that land, crash, hover, or run to the timeout
+TEST(EarlyTerminationTest, sameEndsAnyBrain)
+{
+    const ScenarioBank scenarios(SimParams{}, 1134, 30);
+    for (const int actionRepeat : {1, 3})
+    {
+        expectSameEnds(scenarios, actionRepeat, [](const ETBrainState& in, ETBrainActions& out) {
+            GetFixedBrainActions(in, out);
+        });
+        // Hovers until the fuel runs out
+        expectSameEnds(scenarios, actionRepeat, [](const ETBrainState& in, ETBrainActions& out) {
+            out = {in[SIM_BRAINSTATE_LANDER_VY] < 0.0f ? 1.0f : 0.0f, 0.0f, 0.0f};
+        });
+        for (uint32_t seed = 1; seed <= 10; ++seed)
+        {
+            SimpleNeuralNet<float, ET_NET_ARCH> net;
+            net.InitializeRandomParameters(seed);
+            expectSameEnds(scenarios, actionRepeat, [&](const ETBrainState& in, ETBrainActions& out) {
+                net.FeedForward(in, out);
+            });
+        }
+    }
+}
@@ -1,5 +1,9 @@
 #define BENCHMARK_FIXITURE
 #include "fixitures.h"
+#include "NetPruning.h"
+#include "PolicyTree.h"
+#include "QuantizedNeuralNet.h"
+#include "GenController10x12x12x3.h"
 
 BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x3dp1, std::array<int, 2>{10, 3})(benchmark::State& st) {
     this->initInputsAndParams(1234, 0.0f, 1.0f);
@@ -29,6 +33,20 @@ BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x3cur, std::array<int, 2>{10, 3})(
     }
 }
 
+BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x3columns, std::array<int, 2>{10, 3})(benchmark::State& st) {
+    this->initInputsAndParams(1234, 0.0f, 1.0f);
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(this->template FeedForward_kernel<TinyGemv::ColumnsKernel>());
+    }
+}
+
+BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x3eigen, std::array<int, 2>{10, 3})(benchmark::State& st) {
+    this->initInputsAndParams(1234, 0.0f, 1.0f);
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(this->template FeedForward_kernel<TinyGemv::EigenKernel>());
+    }
+}
+
 ////////////////////////////
 
 
@@ -59,3 +77,296 @@ BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x20x30x40x30x20x10cur, std::array<
         this->FeedForward_cur();
     }
 }
+
+BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x20x30x40x30x20x10columns, std::array<int, 7>{10,20,30,40,30,20,10})(benchmark::State& st) {
+    this->initInputsAndParams(1234, 0.0f, 1.0f);
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(this->template FeedForward_kernel<TinyGemv::ColumnsKernel>());
+    }
+}
+
+BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x20x30x40x30x20x10eigen, std::array<int, 7>{10,20,30,40,30,20,10})(benchmark::State& st) {
+    this->initInputsAndParams(1234, 0.0f, 1.0f);
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(this->template FeedForward_kernel<TinyGemv::EigenKernel>());
+    }
+}
+
+////////////////////////////
+
+// The landers' network (cur picks a kernel per layer, see TinyGemv.h)
+
+BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x12x12x3dp1, std::array<int, 4>{10, 12, 12, 3})(benchmark::State& st) {
+    this->initInputsAndParams(1234, 0.0f, 1.0f);
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(this->FeedForward_dp1());
+    }
+}
+
+BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x12x12x3tc1, std::array<int, 4>{10, 12, 12, 3})(benchmark::State& st) {
+    this->initInputsAndParams(1234, 0.0f, 1.0f);
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(this->FeedForward_tc1());
+    }
+}
+
+BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x12x12x3dp2, std::array<int, 4>{10, 12, 12, 3})(benchmark::State& st) {
+    this->initInputsAndParams(1234, 0.0f, 1.0f);
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(this->FeedForward_dp2());
+    }
+}
+
+BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x12x12x3cur, std::array<int, 4>{10, 12, 12, 3})(benchmark::State& st) {
+    this->initInputsAndParams(1234, 0.0f, 1.0f);
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(this->FeedForward_cur());
+    }
+}
+
+BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x12x12x3columns, std::array<int, 4>{10, 12, 12, 3})(benchmark::State& st) {
+    this->initInputsAndParams(1234, 0.0f, 1.0f);
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(this->template FeedForward_kernel<TinyGemv::ColumnsKernel>());
+    }
+}
+
+BENCHMARK_TEMPLATE_F(FeedForwardBenchmarck, 10x12x12x3eigen, std::array<int, 4>{10, 12, 12, 3})(benchmark::State& st) {
+    this->initInputsAndParams(1234, 0.0f, 1.0f);
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(this->template FeedForward_kernel<TinyGemv::EigenKernel>());
+    }
+}
+
+////////////////////////////
+
+// Float and int8 inference of a lander controller, on varied states
+static constexpr std::array<int, 4> QNN_BENCH_NET_ARCH {10, 12, 12, 3};
+using QNNBenchNet = SimpleNeuralNet<float, QNN_BENCH_NET_ARCH>;
+
+static std::vector<QNNBenchNet::Inputs> makeBenchInputs()
+{
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> dist(0.0f, 100.0f);
+    std::vector<QNNBenchNet::Inputs> inputs(1024);
+    for (auto& in : inputs)
+        for (auto& x : in)
+            x = dist(rng);
+    return inputs;
+}
+
+static void BM_FeedForwardFloat10x12x12x3(benchmark::State& st)
+{
+    QNNBenchNet net;
+    net.InitializeRandomParameters(1234);
+    const auto inputs = makeBenchInputs();
+    size_t i = 0;
+    for (auto _ : st)
+    {
+        QNNBenchNet::Outputs outputs;
+        net.FeedForward(inputs[i++ % inputs.size()], outputs);
+        benchmark::DoNotOptimize(outputs);
+    }
+}
+BENCHMARK(BM_FeedForwardFloat10x12x12x3);
+
+static void BM_FeedForwardInt8_10x12x12x3(benchmark::State& st)
+{
+    QNNBenchNet net;
+    net.InitializeRandomParameters(1234);
+    const auto inputs = makeBenchInputs();
+    QuantizedNeuralNet<QNN_BENCH_NET_ARCH> qnet;
+    qnet.Quantize(net, inputs.data(), inputs.size());
+    size_t i = 0;
+    for (auto _ : st)
+    {
+        QNNBenchNet::Outputs outputs;
+        qnet.FeedForward(inputs[i++ % inputs.size()], outputs);
+        benchmark::DoNotOptimize(outputs);
+    }
+}
+BENCHMARK(BM_FeedForwardInt8_10x12x12x3);
+
+// Controller generated from a network (see NetCodeGen), as a reference
+// for the kernels above
+static void BM_FeedForwardGenerated10x12x12x3(benchmark::State& st)
+{
+    const auto inputs = makeBenchInputs();
+    size_t i = 0;
+    for (auto _ : st)
+    {
+        float outputs[GenController10x12x12x3::OUTPUTS_N];
+        GenController10x12x12x3::FeedForward(inputs[i++ % inputs.size()].data(), outputs);
+        benchmark::DoNotOptimize(outputs);
+    }
+}
+BENCHMARK(BM_FeedForwardGenerated10x12x12x3);
+
+////////////////////////////
+
+// Activation policies (see Activations.h), on 256 values
+template<typename Act>
+static void BM_Activation(benchmark::State& st)
+{
+    using Values = Eigen::Array<float, 256, 1>;
+    const Values xs = Values::LinSpaced(256, -8.0f, 8.0f);
+    Values ys;
+    for (auto _ : st)
+    {
+        ys = Act::Apply(xs);
+        benchmark::DoNotOptimize(ys.data());
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_Activation<Activation::ReLU>);
+BENCHMARK(BM_Activation<Activation::LeakyReLU>);
+BENCHMARK(BM_Activation<Activation::Tanh>);
+BENCHMARK(BM_Activation<Activation::Sigmoid>);
+BENCHMARK(BM_Activation<Activation::FastTanh>);
+BENCHMARK(BM_Activation<Activation::FastSigmoid>);
+
+// libm, one call per value, for reference
+static void BM_ActivationTanhLibm(benchmark::State& st)
+{
+    using Values = Eigen::Array<float, 256, 1>;
+    const Values xs = Values::LinSpaced(256, -8.0f, 8.0f);
+    Values ys;
+    for (auto _ : st)
+    {
+        for (int i = 0; i < 256; ++i)
+            ys[i] = std::tanh(xs[i]);
+        benchmark::DoNotOptimize(ys.data());
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_ActivationTanhLibm);
+
+// The lander controller, with a squashing function on the outputs
+template<typename Act>
+static void BM_FeedForwardOutputs10x12x12x3(benchmark::State& st)
+{
+    using Net = SimpleNeuralNet<float, QNN_BENCH_NET_ARCH, Activation::Layers<Activation::ReLU, Activation::ReLU, Act>>;
+    Net net;
+    net.InitializeRandomParameters(1234);
+    const auto inputs = makeBenchInputs();
+    size_t i = 0;
+    for (auto _ : st)
+    {
+        typename Net::Outputs outputs;
+        net.FeedForward(inputs[i++ % inputs.size()], outputs);
+        benchmark::DoNotOptimize(outputs);
+    }
+}
+BENCHMARK(BM_FeedForwardOutputs10x12x12x3<Activation::ReLU>);
+BENCHMARK(BM_FeedForwardOutputs10x12x12x3<Activation::Tanh>);
+BENCHMARK(BM_FeedForwardOutputs10x12x12x3<Activation::FastTanh>);
+BENCHMARK(BM_FeedForwardOutputs10x12x12x3<Activation::Sigmoid>);
+BENCHMARK(BM_FeedForwardOutputs10x12x12x3<Activation::FastSigmoid>);
+
+////////////////////////////
+
+// An over-provisioned controller, pruned (see NetPruning.h)
+static constexpr std::array<int, 4> PRN_BENCH_NET_ARCH {10, 24, 24, 3};
+using PrnBenchNet = SimpleNeuralNet<float, PRN_BENCH_NET_ARCH>;
+
+static void BM_FeedForwardPrunedDense10x24x24x3(benchmark::State& st)
+{
+    PrnBenchNet net;
+    net.InitializeRandomParameters(1234);
+    const auto inputs = makeBenchInputs();
+    size_t i = 0;
+    for (auto _ : st)
+    {
+        PrnBenchNet::Outputs outputs;
+        net.FeedForward(inputs[i++ % inputs.size()], outputs);
+        benchmark::DoNotOptimize(outputs);
+    }
+}
+BENCHMARK(BM_FeedForwardPrunedDense10x24x24x3);
+
+// Half of the neurons removed, compacted to 10x12x12x3
+static void BM_FeedForwardPrunedCompact10x24x24x3(benchmark::State& st)
+{
+    PrnBenchNet net;
+    net.InitializeRandomParameters(1234);
+    const auto inputs = makeBenchInputs();
+    NetPruning::PruneNeurons(net, inputs.data(), inputs.size(), 0.5);
+    QNNBenchNet compactNet;
+    NetPruning::CompactNet(net, compactNet);
+    size_t i = 0;
+    for (auto _ : st)
+    {
+        QNNBenchNet::Outputs outputs;
+        compactNet.FeedForward(inputs[i++ % inputs.size()], outputs);
+        benchmark::DoNotOptimize(outputs);
+    }
+}
+BENCHMARK(BM_FeedForwardPrunedCompact10x24x24x3);
+
+// Arg: percentage of the weights left, pruned by blocks, or by weights
+template<bool byBlocks>
+static void BM_FeedForwardPrunedSparse10x24x24x3(benchmark::State& st)
+{
+    PrnBenchNet net;
+    net.InitializeRandomParameters(1234);
+    if constexpr (byBlocks)
+        NetPruning::PruneWeightBlocks(net, 1.0 - (double)st.range(0) / 100);
+    else
+        NetPruning::PruneWeights(net, 1.0 - (double)st.range(0) / 100);
+    const SparseNeuralNet<float, PRN_BENCH_NET_ARCH> sparseNet(net);
+    const auto inputs = makeBenchInputs();
+    size_t i = 0;
+    for (auto _ : st)
+    {
+        PrnBenchNet::Outputs outputs;
+        sparseNet.FeedForward(inputs[i++ % inputs.size()], outputs);
+        benchmark::DoNotOptimize(outputs);
+    }
+}
+BENCHMARK(BM_FeedForwardPrunedSparse10x24x24x3<true>)->Arg(70)->Arg(50)->Arg(30)->Arg(10);
+BENCHMARK(BM_FeedForwardPrunedSparse10x24x24x3<false>)->Arg(50)->Arg(10);
+
+////////////////////////////
+
+// The lander controller, and its policy distilled into a tree (see
+// PolicyTree.h), on the states met in flight
+struct PolicyTreeBench
+{
+    QNNBenchNet               net;
+    PolicyTree                tree;
+    std::vector<PolicySample> samples;
+
+    PolicyTreeBench()
+    {
+        net.InitializeRandomParameters(1234);
+        const auto netPolicy = [&](const PolicyState& s, PolicyActions& a) { net.FeedForward(s, a); };
+        const SimRolloutContext ctx(SimParams{});
+        CollectPolicySamples(ctx, ScenarioBank(ctx.sp, 1134, 30), netPolicy, netPolicy, samples);
+        tree.Build(samples);
+    }
+};
+
+static void BM_PolicyNet10x12x12x3(benchmark::State& st)
+{
+    const PolicyTreeBench bench;
+    size_t i = 0;
+    for (auto _ : st)
+    {
+        QNNBenchNet::Outputs outputs;
+        bench.net.FeedForward(bench.samples[i++ % bench.samples.size()].state, outputs);
+        benchmark::DoNotOptimize(outputs);
+    }
+}
+BENCHMARK(BM_PolicyNet10x12x12x3);
+
+static void BM_PolicyTree10x12x12x3(benchmark::State& st)
+{
+    const PolicyTreeBench bench;
+    size_t i = 0;
+    for (auto _ : st)
+    {
+        const auto actions = bench.tree.GetActions(bench.samples[i++ % bench.samples.size()].state.data());
+        benchmark::DoNotOptimize(actions);
+    }
+}
+BENCHMARK(BM_PolicyTree10x12x12x3);
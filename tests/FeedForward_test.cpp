@@ -1,6 +1,9 @@
 #include <cstddef>
 #include <gtest/gtest.h>
 #include "fixitures.h"
+#include "QuantizedNeuralNet.h"
+#include "TrainingTaskGA.h"
+#include "GenController10x12x12x3.h"
 
 class FeedForwardTest10x3 : public FeedForwardTest<std::array<int, 2>{10, 3}> {};
 TEST_F(FeedForwardTest10x3, basicTest)
@@ -11,12 +14,16 @@ TEST_F(FeedForwardTest10x3, basicTest)
     auto outputs_tc1 = this->FeedForward_tc1();
     auto outputs_dp2 = this->FeedForward_dp2();
     auto outputs_cur = this->FeedForward_cur();
+    auto outputs_columns = this->FeedForward_kernel<TinyGemv::ColumnsKernel>();
+    auto outputs_eigen = this->FeedForward_kernel<TinyGemv::EigenKernel>();
 
     for (size_t i = 0; i < outputs_dp1.size(); i++)
     {
         EXPECT_FLOAT_EQ(outputs_dp1[i], outputs_tc1[i]);
         EXPECT_FLOAT_EQ(outputs_dp1[i], outputs_dp2[i]);
         EXPECT_FLOAT_EQ(outputs_dp1[i], outputs_cur[i]);
+        EXPECT_FLOAT_EQ(outputs_dp1[i], outputs_columns[i]);
+        EXPECT_FLOAT_EQ(outputs_dp1[i], outputs_eigen[i]);
     }
 }
 
@@ -30,11 +37,238 @@ TEST_F(FeedForwardTest10x3x4x6x30x20x4x50, basicTest)
     auto outputs_tc1 = this->FeedForward_tc1();
     auto outputs_dp2 = this->FeedForward_dp2();
     auto outputs_cur = this->FeedForward_cur();
+    auto outputs_columns = this->FeedForward_kernel<TinyGemv::ColumnsKernel>();
+    auto outputs_eigen = this->FeedForward_kernel<TinyGemv::EigenKernel>();
 
     for (size_t i = 0; i < outputs_dp1.size(); i++)
     {
         EXPECT_FLOAT_EQ(outputs_dp1[i], outputs_tc1[i]);
         EXPECT_FLOAT_EQ(outputs_dp1[i], outputs_dp2[i]);
         EXPECT_FLOAT_EQ(outputs_dp1[i], outputs_cur[i]);
+        EXPECT_FLOAT_EQ(outputs_dp1[i], outputs_columns[i]);
+        EXPECT_FLOAT_EQ(outputs_dp1[i], outputs_eigen[i]);
     }
 }
+
+// Single output layer, for DotKernel
+class FeedForwardTest37x1 : public FeedForwardTest<std::array<int, 2>{37, 1}> {};
+TEST_F(FeedForwardTest37x1, basicTest)
+{
+    this->initInputsAndParams(4321, 0.5f, 1.0f);
+
+    auto outputs_dp1 = this->FeedForward_dp1();
+    auto outputs_tc1 = this->FeedForward_tc1();
+    auto outputs_dp2 = this->FeedForward_dp2();
+    auto outputs_cur = this->FeedForward_cur();
+    auto outputs_dot = this->FeedForward_kernel<TinyGemv::DotKernel>();
+    auto outputs_columns = this->FeedForward_kernel<TinyGemv::ColumnsKernel>();
+    auto outputs_eigen = this->FeedForward_kernel<TinyGemv::EigenKernel>();
+
+    EXPECT_GT(outputs_dp1[0], 0.0f); // Not clamped by ReLU
+    EXPECT_FLOAT_EQ(outputs_dp1[0], outputs_tc1[0]);
+    EXPECT_FLOAT_EQ(outputs_dp1[0], outputs_dp2[0]);
+    EXPECT_FLOAT_EQ(outputs_dp1[0], outputs_cur[0]);
+    EXPECT_FLOAT_EQ(outputs_dp1[0], outputs_dot[0]);
+    EXPECT_FLOAT_EQ(outputs_dp1[0], outputs_columns[0]);
+    EXPECT_FLOAT_EQ(outputs_dp1[0], outputs_eigen[0]);
+}
+
+//==================================================================
+// Int8 inference of a trained controller: the thresholded actions must
+// match the float network on the states it actually meets
+static constexpr std::array<int, 4> QNN_NET_ARCH {SIM_BRAINSTATE_N, 12, 12, SIM_BRAINACTION_N};
+using QNNFloatNet = SimpleNeuralNet<float, QNN_NET_ARCH>;
+
+static std::vector<QNNFloatNet::Inputs> collectStates(const QNNFloatNet& net, uint64_t seed0, uint64_t scenariosN)
+{
+    std::vector<QNNFloatNet::Inputs> states;
+    for (uint64_t seed = seed0; seed < seed0 + scenariosN; ++seed)
+    {
+        Simulation sim(SimParams{}, seed);
+        while (!sim.IsSimulationComplete() && sim.GetElapsedTimeS() < Simulation::MAX_TIME_S)
+        {
+            sim.AnimateSim([&](const QNNFloatNet::Inputs& inputs, QNNFloatNet::Outputs& outputs) {
+                states.push_back(inputs);
+                net.FeedForward(inputs, outputs);
+            });
+        }
+    }
+    return states;
+}
+
+TEST(QuantizedFeedForwardTest, actionsMatchFloat)
+{
+    SimRunOptions ro;
+    ro.EARLY_TERMINATION = true;
+    TrainingTaskGA<float, QNN_NET_ARCH> task(SimParams{}, 20, 64, 0.1, 0.3, 1234, ro);
+    while (!task.IsTrainingComplete())
+        task.RunIteration();
+    const auto& net = task.GetBestIndividualNetwork();
+
+    // Calibrate and test on different scenarios
+    const auto calibStates = collectStates(net, 1000, 20);
+    const auto testStates = collectStates(net, 5000, 100);
+
+    QuantizedNeuralNet<QNN_NET_ARCH> qnet;
+    qnet.Quantize(net, calibStates.data(), calibStates.size());
+
+    size_t agreeN = 0;
+    size_t firedN = 0;
+    for (const auto& inputs : testStates)
+    {
+        QNNFloatNet::Outputs floatOuts;
+        QNNFloatNet::Outputs quantOuts;
+        net.FeedForward(inputs, floatOuts);
+        qnet.FeedForward(inputs, quantOuts);
+        for (int i = 0; i < SIM_BRAINACTION_N; ++i)
+        {
+            agreeN += (floatOuts[i] > 0.5f) == (quantOuts[i] > 0.5f);
+            firedN += floatOuts[i] > 0.5f;
+        }
+    }
+    const auto actionsN = (double)(testStates.size() * SIM_BRAINACTION_N);
+    // Not a trivial controller
+    EXPECT_GT((double)firedN / actionsN, 0.02);
+    EXPECT_LT((double)firedN / actionsN, 0.98);
+    EXPECT_GE((double)agreeN / actionsN, 0.98);
+
+    // Closed loop, the runs can drift apart, but end the same way
+    size_t sameN = 0;
+    const size_t scenariosN = 100;
+    for (uint64_t seed = 5000; seed < 5000 + scenariosN; ++seed)
+    {
+        Simulation floatSim(SimParams{}, seed);
+        Simulation quantSim(SimParams{}, seed);
+        while (!floatSim.IsSimulationComplete() && floatSim.GetElapsedTimeS() < Simulation::MAX_TIME_S)
+            floatSim.AnimateSim([&](const auto& in, auto& out) { net.FeedForward(in, out); });
+        while (!quantSim.IsSimulationComplete() && quantSim.GetElapsedTimeS() < Simulation::MAX_TIME_S)
+            quantSim.AnimateSim([&](const auto& in, auto& out) { qnet.FeedForward(in, out); });
+
+        sameN += floatSim.mLander.mStateIsLanded == quantSim.mLander.mStateIsLanded &&
+                 floatSim.mLander.mStateIsCrashed == quantSim.mLander.mStateIsCrashed;
+    }
+    EXPECT_GE(sameN, scenariosN * 95 / 100);
+}
+
+//==================================================================
+// Generated controller (see NetCodeGen): same function as the network it
+// was generated from, up to the order of the sums
+// The network is loaded from the checkpoint file the controller was
+// generated from, not rebuilt from the generated arrays, so that wrong
+// arrays can't go unnoticed
+TEST(GeneratedFeedForwardTest, matchesSimpleNeuralNet)
+{
+    namespace gen = GenController10x12x12x3;
+    using Net = SimpleNeuralNet<float, std::array<int, 4>{10, 12, 12, 3}>;
+
+    Net net;
+    ASSERT_TRUE(Checkpoint::LoadNetworkFromFile(NNL_TEST_NETWORK_FILE, net)); // See make_test_network.cpp
+
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    for (int i = 0; i < 1000; ++i)
+    {
+        Net::Inputs inputs;
+        for (auto& x : inputs)
+            x = dist(rng);
+
+        Net::Outputs outputs;
+        float genOutputs[gen::OUTPUTS_N];
+        net.FeedForward(inputs, outputs);
+        gen::FeedForward(inputs.data(), genOutputs);
+        for (int j = 0; j < gen::OUTPUTS_N; ++j)
+            EXPECT_NEAR(genOutputs[j], outputs[j], 1e-5f * (1.0f + std::abs(outputs[j])));
+    }
+}
+
+//==================================================================
+// Activation policies (see Activations.h)
+TEST(ActivationTest, fastApproximationsAccuracy)
+{
+    using namespace Activation;
+    constexpr int N = 40001;
+    const Eigen::ArrayXf xs = Eigen::ArrayXf::LinSpaced(N, -20.0f, 20.0f);
+    const Eigen::ArrayXf fastTanhs = FastTanh::Apply(xs);
+    const Eigen::ArrayXf fastSigmoids = FastSigmoid::Apply(xs);
+    const Eigen::ArrayXf tanhs = Tanh::Apply(xs);
+    const Eigen::ArrayXf sigmoids = Sigmoid::Apply(xs);
+
+    double maxTanhErr = 0;
+    double maxSigmoidErr = 0;
+    for (int i = 0; i < N; ++i)
+    {
+        const float x = xs[i];
+        const double refTanh = std::tanh((double)x);
+        const double refSigmoid = 1.0 / (1.0 + std::exp(-(double)x));
+
+        // Scalars and arrays
+        EXPECT_NEAR(FastTanh::Apply(x), fastTanhs[i], 1e-6f);
+        EXPECT_NEAR(FastSigmoid::Apply(x), fastSigmoids[i], 1e-6f);
+        EXPECT_NEAR(Tanh::Apply(x), tanhs[i], 1e-6f);
+        EXPECT_NEAR(Sigmoid::Apply(x), sigmoids[i], 1e-6f);
+
+        EXPECT_LE(std::abs(fastTanhs[i]), 1.0f);
+        EXPECT_GE(fastSigmoids[i], 0.0f);
+        EXPECT_LE(fastSigmoids[i], 1.0f);
+        maxTanhErr = std::max(maxTanhErr, std::abs(fastTanhs[i] - refTanh));
+        maxSigmoidErr = std::max(maxSigmoidErr, std::abs(fastSigmoids[i] - refSigmoid));
+    }
+    // As documented in Activations.h
+    EXPECT_LE(maxTanhErr, 1.0e-4);
+    EXPECT_LE(maxSigmoidErr, 5.0e-5);
+    EXPECT_EQ(FastTanh::Apply(0.0f), 0.0f);
+}
+
+TEST(ActivationTest, perLayerActivations)
+{
+    using namespace Activation;
+    static constexpr std::array<int, 4> arch {10, 12, 12, 3};
+    static constexpr std::array<int, 3> archDot {10, 12, 1}; // Single output (DotKernel)
+    using LinearNet = SimpleNeuralNet<float, arch, Layers<ReLU, ReLU, Identity>>;
+    using TanhNet = SimpleNeuralNet<float, arch, Layers<ReLU, ReLU, FastTanh>>;
+    using LinearDotNet = SimpleNeuralNet<float, archDot, Layers<LeakyReLU, Identity>>;
+    using SigmoidDotNet = SimpleNeuralNet<float, archDot, Layers<LeakyReLU, Sigmoid>>;
+    static_assert(std::is_same_v<TanhNet::LayerActivation<1>, ReLU>);
+    static_assert(std::is_same_v<SimpleNeuralNet<float, arch>::LayerActivation<2>, ReLU>);
+
+    LinearNet linearNet;
+    linearNet.InitializeRandomParameters(1234);
+    std::vector<float> params(LinearNet::CalcTotalParameters());
+    linearNet.CopyParametersTo(params.data());
+    TanhNet tanhNet;
+    tanhNet.SetParametersFrom(params.data());
+
+    LinearDotNet linearDotNet;
+    linearDotNet.InitializeRandomParameters(5678);
+    std::vector<float> paramsDot(LinearDotNet::CalcTotalParameters());
+    linearDotNet.CopyParametersTo(paramsDot.data());
+    SigmoidDotNet sigmoidDotNet;
+    sigmoidDotNet.SetParametersFrom(paramsDot.data());
+
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> dist(0.0f, 2.0f);
+    bool hasNegative = false;
+    for (int i = 0; i < 100; ++i)
+    {
+        LinearNet::Inputs inputs;
+        for (auto& x : inputs)
+            x = dist(rng);
+
+        LinearNet::Outputs linearOutputs;
+        TanhNet::Outputs tanhOutputs;
+        linearNet.FeedForward(inputs, linearOutputs);
+        tanhNet.FeedForward(inputs, tanhOutputs);
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_NEAR(tanhOutputs[j], std::tanh(linearOutputs[j]), 1.0e-4f);
+            hasNegative = hasNegative || linearOutputs[j] < 0.0f;
+        }
+
+        LinearDotNet::Outputs linearDotOutputs;
+        SigmoidDotNet::Outputs sigmoidDotOutputs;
+        linearDotNet.FeedForward(inputs, linearDotOutputs);
+        sigmoidDotNet.FeedForward(inputs, sigmoidDotOutputs);
+        EXPECT_NEAR(sigmoidDotOutputs[0], 1.0f / (1.0f + std::exp(-linearDotOutputs[0])), 1.0e-6f);
+    }
+    EXPECT_TRUE(hasNegative); // Not ReLU on the outputs
+}
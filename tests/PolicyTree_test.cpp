@@ -0,0 +1,124 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "FixedBrain.h"
+#include "PolicyTree.h"
+#include "SimpleNeuralNet.h"
+
+//==================================================================
+static constexpr std::array<int, 3> PTREE_SMALL_ARCH {SIM_BRAINSTATE_N, 8, SIM_BRAINACTION_N};
+static constexpr std::array<int, 4> PTREE_NET_ARCH {SIM_BRAINSTATE_N, 12, 12, SIM_BRAINACTION_N};
+
+// Multiples of 10, so that all the splits fall between two values
+static std::vector<PolicySample> makeRandomStates(uint32_t seed, size_t n)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> dist(-10, 10);
+    std::vector<PolicySample> samples(n);
+    for (auto& s : samples)
+        for (auto& x : s.state)
+            x = 10.0f * (float)dist(rng);
+    return samples;
+}
+
+// Up when falling fast, left and right towards the pad
+static uint8_t calcPiecewiseActions(const PolicyState& s)
+{
+    const auto padDx = s[SIM_BRAINSTATE_PAD_X] - s[SIM_BRAINSTATE_LANDER_X];
+    return (s[SIM_BRAINSTATE_LANDER_VY] > 30.0f ? 1 << SIM_BRAINACTION_UP : 0) |
+           (padDx < -20.0f ? 1 << SIM_BRAINACTION_LEFT : 0) |
+           (padDx > 20.0f ? 1 << SIM_BRAINACTION_RIGHT : 0);
+}
+
+//==================================================================
+// A policy of a few splits is fit exactly, and the tree is kept minimal
+TEST(PolicyTreeTest, fitPiecewise)
+{
+    auto samples = makeRandomStates(1, 20000);
+    for (auto& s : samples)
+        s.actions = calcPiecewiseActions(s.state);
+
+    PolicyTree tree;
+    tree.Build(samples);
+    EXPECT_EQ(tree.GetLeavesN(), 6u);
+    EXPECT_EQ(tree.CalcDepth(), 3);
+
+    for (const auto& s : makeRandomStates(2, 1000))
+        EXPECT_EQ(tree.GetActions(s.state.data()), calcPiecewiseActions(s.state));
+
+    // Leaves limit
+    tree.Build(samples, {.maxLeavesN = 3});
+    EXPECT_LE(tree.GetLeavesN(), 3u);
+}
+
+TEST(PolicyTreeTest, saveLoad)
+{
+    auto samples = makeRandomStates(1, 5000);
+    for (auto& s : samples)
+        s.actions = (uint8_t)((s.state[0] > 0) | (s.state[1] * s.state[2] > 0) << 1);
+
+    PolicyTree tree;
+    tree.Build(samples);
+    const std::string path = "policy_tree_test.bin";
+    ASSERT_TRUE(tree.SaveToFile(path));
+
+    PolicyTree loaded;
+    ASSERT_TRUE(loaded.LoadFromFile(path));
+    EXPECT_EQ(loaded.GetNodesN(), tree.GetNodesN());
+    for (const auto& s : makeRandomStates(2, 1000))
+        EXPECT_EQ(loaded.GetActions(s.state.data()), tree.GetActions(s.state.data()));
+
+    // Not a tree
+    SimpleNeuralNet<float, PTREE_SMALL_ARCH> net;
+    net.InitializeRandomParameters(1234);
+    ASSERT_TRUE(Checkpoint::SaveNetworkToFile(path, net));
+    EXPECT_FALSE(loaded.LoadFromFile(path));
+    std::remove(path.c_str());
+}
+
+// Distilled from a network, on the states met when flying
+TEST(PolicyTreeTest, distillNetwork)
+{
+    SimpleNeuralNet<float, PTREE_NET_ARCH> net;
+    net.InitializeRandomParameters(1234);
+    const auto netPolicy = [&](const PolicyState& s, PolicyActions& a) { net.FeedForward(s, a); };
+
+    PolicyTree tree;
+    const auto treePolicy = [&](const PolicyState& s, PolicyActions& a) { tree.FeedForward(s, a); };
+
+    const SimRolloutContext ctx(SimParams{});
+    const ScenarioBank scenarios(ctx.sp, 1134, 30);
+    std::vector<PolicySample> samples;
+    CollectPolicySamples(ctx, scenarios, netPolicy, netPolicy, samples);
+    tree.Build(samples);
+    CollectPolicySamples(ctx, scenarios, treePolicy, netPolicy, samples);
+    tree.Build(samples);
+
+    const ScenarioBank evalScenarios(ctx.sp, 100000, 30);
+    const auto res = MeasurePolicyAgreement(ctx, evalScenarios, netPolicy, treePolicy);
+    EXPECT_GT(res.statesN, 0u);
+    EXPECT_GE(res.statesAgreeRate, 0.95);
+    EXPECT_GE(res.sameOutcomeRate, 0.8);
+}
+
+// Distilled from a controller that lands: it lands the same way
+TEST(PolicyTreeTest, distillController)
+{
+    PolicyTree tree;
+    const auto treePolicy = [&](const PolicyState& s, PolicyActions& a) { tree.FeedForward(s, a); };
+
+    const SimRolloutContext ctx(SimParams{});
+    const ScenarioBank scenarios(ctx.sp, 1134, 100);
+    std::vector<PolicySample> samples;
+    CollectPolicySamples(ctx, scenarios, GetFixedBrainActions, GetFixedBrainActions, samples);
+    tree.Build(samples);
+
+    const ScenarioBank evalScenarios(ctx.sp, 100000, 100);
+    const auto res = MeasurePolicyAgreement(ctx, evalScenarios, GetFixedBrainActions, treePolicy);
+    EXPECT_GE(res.statesAgreeRate, 0.99);
+    EXPECT_GE(res.landedRateA, 0.3);
+    EXPECT_NEAR(res.landedRateA, res.landedRateB, 0.03);
+    EXPECT_GE(res.sameOutcomeRate, 0.95);
+}
@@ -0,0 +1,128 @@
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "NetPruning.h"
+#include "TrainingTaskGA.h"
+
+//==================================================================
+static constexpr std::array<int, 4> PRN_WIDE_ARCH {SIM_BRAINSTATE_N, 24, 24, SIM_BRAINACTION_N};
+static constexpr std::array<int, 4> PRN_NARROW_ARCH {SIM_BRAINSTATE_N, 12, 12, SIM_BRAINACTION_N};
+static constexpr std::array<int, 4> PRN_TINY_ARCH {SIM_BRAINSTATE_N, 8, 8, SIM_BRAINACTION_N};
+using PrnWideNet = SimpleNeuralNet<float, PRN_WIDE_ARCH>;
+using PrnNarrowNet = SimpleNeuralNet<float, PRN_NARROW_ARCH>;
+
+static std::vector<PrnWideNet::Inputs> makeInputs(uint32_t seed, size_t n)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<PrnWideNet::Inputs> inputs(n);
+    for (auto& in : inputs)
+        for (auto& x : in)
+            x = dist(rng);
+    return inputs;
+}
+
+template<typename NetA, typename NetB>
+static void expectSameOutputs(const NetA& a, const NetB& b, const std::vector<PrnWideNet::Inputs>& inputs)
+{
+    for (const auto& in : inputs)
+    {
+        PrnWideNet::Outputs outA;
+        PrnWideNet::Outputs outB;
+        a.FeedForward(in, outA);
+        b.FeedForward(in, outB);
+        for (int i = 0; i < SIM_BRAINACTION_N; ++i)
+            EXPECT_NEAR(outA[i], outB[i], 1e-4f * (1.0f + std::abs(outA[i])));
+    }
+}
+
+//==================================================================
+// Structured pruning, then compaction to the smaller architecture
+TEST(PruningTest, compactNeurons)
+{
+    PrnWideNet net;
+    net.InitializeRandomParameters(1234);
+    const auto calibInputs = makeInputs(1, 500);
+    const auto testInputs = makeInputs(2, 200);
+
+    // Nothing to rank the neurons by
+    EXPECT_EQ(NetPruning::PruneNeurons(net, calibInputs.data(), 0, 0.5), 0u);
+    EXPECT_EQ(NetPruning::CalcLiveArch(net), MakeArchDesc<PRN_WIDE_ARCH>());
+
+    EXPECT_EQ(NetPruning::PruneNeurons(net, calibInputs.data(), calibInputs.size(), 0.5), 24u);
+    EXPECT_EQ(NetPruning::CalcLiveArch(net), MakeArchDesc<PRN_NARROW_ARCH>());
+
+    using Archs = ArchRegistry<float, PRN_TINY_ARCH, PRN_WIDE_ARCH, PRN_NARROW_ARCH>;
+    ArchDesc fitArch;
+    ASSERT_TRUE(Archs::FindFit(NetPruning::CalcLiveArch(net), fitArch));
+    EXPECT_EQ(fitArch, MakeArchDesc<PRN_NARROW_ARCH>());
+
+    PrnNarrowNet narrow;
+    ASSERT_TRUE(NetPruning::CompactNet(net, narrow));
+    expectSameOutputs(net, narrow, testInputs);
+
+    SimpleNeuralNet<float, PRN_TINY_ARCH> tiny;
+    EXPECT_FALSE(NetPruning::CompactNet(net, tiny));
+
+    // Into a wider one, the extra neurons do nothing
+    PrnWideNet wide;
+    ASSERT_TRUE(NetPruning::CompactNet(net, wide));
+    expectSameOutputs(net, wide, testInputs);
+}
+
+// Neurons without inputs are folded exactly, whatever the activation
+TEST(PruningTest, foldConstantNeurons)
+{
+    using Net = SimpleNeuralNet<float, PRN_NARROW_ARCH, Activation::Layers<Activation::FastTanh>>;
+    Net net;
+    net.InitializeRandomParameters(1234);
+
+    std::vector<float> params(Net::CalcTotalParameters());
+    net.CopyParametersTo(params.data());
+    const auto first = NetPruning::GetLayer<PRN_NARROW_ARCH>(params, 0);
+    for (int n : {2, 5, 7})
+    {
+        for (int c = 0; c < first.I; ++c)
+            first.W(n, c) = 0.0f;
+        first.B(n) = 0.3f * (float)n;
+    }
+    net.SetParametersFrom(params.data());
+    const auto before = net;
+
+    EXPECT_EQ(NetPruning::FoldConstantNeurons(net), 3u);
+    EXPECT_EQ(NetPruning::CalcLiveArch(net), (ArchDesc{SIM_BRAINSTATE_N, 9, 12, SIM_BRAINACTION_N}));
+    expectSameOutputs(before, net, makeInputs(2, 200));
+}
+
+// Magnitude pruning, run sparse
+TEST(PruningTest, sparseWeights)
+{
+    const size_t weightsN = SIM_BRAINSTATE_N * 24 + 24 * 24 + 24 * SIM_BRAINACTION_N;
+    const auto testInputs = makeInputs(2, 200);
+
+    // By blocks, the layers run sparse
+    PrnWideNet net;
+    net.InitializeRandomParameters(1234);
+    const auto zerosN = NetPruning::PruneWeightBlocks(net, 0.8);
+    EXPECT_GE(zerosN, weightsN / 2);
+    SparseNeuralNet<float, PRN_WIDE_ARCH> sparse(net);
+    EXPECT_EQ(sparse.GetNonZeroWeightsN(), weightsN - zerosN);
+    for (size_t l = 0; l < PrnWideNet::LAYERS_N; ++l)
+        EXPECT_TRUE(sparse.IsLayerSparse(l));
+    expectSameOutputs(net, sparse, testInputs);
+
+    // By weights, the zeros are scattered across the blocks
+    net.InitializeRandomParameters(1234);
+    EXPECT_EQ(NetPruning::PruneWeights(net, 0.5), (size_t)(SIM_BRAINSTATE_N * 12 + 24 * 12 + 12 * SIM_BRAINACTION_N));
+    sparse.Build(net);
+    EXPECT_EQ(sparse.GetNonZeroWeightsN(), weightsN / 2);
+    expectSameOutputs(net, sparse, testInputs);
+
+    // Not pruned, dense
+    PrnWideNet denseNet;
+    denseNet.InitializeRandomParameters(1234);
+    sparse.Build(denseNet);
+    for (size_t l = 0; l < PrnWideNet::LAYERS_N; ++l)
+        EXPECT_FALSE(sparse.IsLayerSparse(l));
+    expectSameOutputs(denseNet, sparse, testInputs);
+}
@@ -0,0 +1,188 @@
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "Simulation.h"
+
+//==================================================================
+static constexpr size_t RS_SEGMENTS_N = 16;
+
+// The terrain as a polyline of all its segments, the flat ends included
+struct RSPolyline
+{
+    std::vector<Vector2> points;
+
+    explicit RSPolyline(std::vector<Vector2> pts) : points(std::move(pts)) {}
+
+    template<size_t POINTS_N>
+    explicit RSPolyline(const Vector2 (&pts)[POINTS_N])
+    {
+        const auto FAR_X = 1e6f;
+        points.push_back({pts[0].x - FAR_X, pts[0].y});
+        points.insert(points.end(), std::begin(pts), std::end(pts));
+        points.push_back({pts[POINTS_N - 1].x + FAR_X, pts[POINTS_N - 1].y});
+    }
+
+    double CalcHeightAt(double x) const
+    {
+        for (size_t i=1; i < points.size(); ++i)
+        {
+            const auto& p0 = points[i - 1];
+            const auto& p1 = points[i];
+            if (x <= p1.x || i == points.size() - 1)
+                return p0.y + (x - p0.x) * (p1.y - p0.y) / (p1.x - p0.x);
+        }
+        return points.back().y;
+    }
+
+    // Brute force: the nearest of the intersections with all the segments
+    double CastRay(const Vector2& o, const Vector2& d, double maxDist) const
+    {
+        if (o.y <= CalcHeightAt(o.x))
+            return 0;
+
+        const auto cross = [](double ax, double ay, double bx, double by) { return ax*by - ay*bx; };
+        double best = maxDist;
+        for (size_t i=1; i < points.size(); ++i)
+        {
+            const auto& p0 = points[i - 1];
+            const auto& p1 = points[i];
+            const double ex = p1.x - p0.x;
+            const double ey = p1.y - p0.y;
+            const double denom = cross(d.x, d.y, ex, ey);
+            if (denom == 0) // Parallel, it's hit at the ends, if at all
+                continue;
+            const double ox = p0.x - o.x;
+            const double oy = p0.y - o.y;
+            const double t = cross(ox, oy, ex, ey) / denom;
+            const double s = cross(ox, oy, d.x, d.y) / denom;
+            if (t >= 0 && s >= 0 && s <= 1)
+                best = std::min(best, t);
+        }
+        return best;
+    }
+};
+
+static void expectSameRay(const TerrainProfile<RS_SEGMENTS_N>& profile, const RSPolyline& poly,
+                          const Vector2& o, const Vector2& d, float maxDist)
+{
+    const auto expected = poly.CastRay(o, d, maxDist);
+    EXPECT_NEAR(profile.CastRay(o, d, maxDist), expected, 1e-3 * (1 + expected))
+        << "origin " << o.x << "," << o.y << " dir " << d.x << "," << d.y << " maxDist " << maxDist;
+}
+
+static Vector2 makeDir(float angle) { return {std::cos(angle), std::sin(angle)}; }
+
+// Rugged terrain, so that the rays cross several segments
+static void makeRuggedTerrain(uint32_t seed, Vector2 (&pts)[RS_SEGMENTS_N + 1])
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> heightDist(0.0f, 300.0f);
+    for (size_t i=0; i <= RS_SEGMENTS_N; ++i)
+        pts[i] = {-400.0f + 50.0f * (float)i, heightDist(rng)};
+}
+
+//==================================================================
+// Random rays, from anywhere, in any direction
+TEST(RaySensorsTest, castRayMatchesBruteForce)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> xDist(-600.0f, 600.0f);
+    std::uniform_real_distribution<float> yDist(-50.0f, 600.0f);
+    std::uniform_real_distribution<float> angleDist(0.0f, 2 * PI);
+    std::uniform_real_distribution<float> maxDistDist(1.0f, 1500.0f);
+    for (uint32_t seed = 1; seed <= 20; ++seed)
+    {
+        Vector2 pts[RS_SEGMENTS_N + 1];
+        makeRuggedTerrain(seed, pts);
+        TerrainProfile<RS_SEGMENTS_N> profile;
+        profile.Build(pts);
+        const RSPolyline poly(pts);
+        for (int i=0; i < 500; ++i)
+            expectSameRay(profile, poly, {xDist(rng), yDist(rng)}, makeDir(angleDist(rng)), maxDistDist(rng));
+    }
+}
+
+// The cases at the edges of the walk
+TEST(RaySensorsTest, castRayEdgeCases)
+{
+    Vector2 pts[RS_SEGMENTS_N + 1];
+    makeRuggedTerrain(7, pts);
+    TerrainProfile<RS_SEGMENTS_N> profile;
+    profile.Build(pts);
+    const RSPolyline poly(pts);
+    const auto maxDist = 1000.0f;
+
+    // Starting below the terrain, or on it
+    for (size_t i=0; i < RS_SEGMENTS_N; ++i)
+    {
+        const Vector2 mid {(pts[i].x + pts[i + 1].x) / 2, (pts[i].y + pts[i + 1].y) / 2};
+        EXPECT_EQ(profile.CastRay({mid.x, mid.y - 20.0f}, makeDir(PI * 0.25f), maxDist), 0.0f);
+        EXPECT_EQ(profile.CastRay({mid.x, mid.y - 20.0f}, makeDir(-PI * 0.5f), maxDist), 0.0f);
+        EXPECT_EQ(profile.CastRay({mid.x, profile.GetHeightAt(mid.x)}, makeDir(PI * 0.5f), maxDist), 0.0f);
+    }
+    EXPECT_EQ(profile.CastRay({pts[0].x - 100.0f, pts[0].y - 1.0f}, makeDir(PI), maxDist), 0.0f);
+
+    // Parallel to a segment, above it, both ways
+    for (size_t i=0; i < RS_SEGMENTS_N; ++i)
+    {
+        const auto dx = pts[i + 1].x - pts[i].x;
+        const auto dy = pts[i + 1].y - pts[i].y;
+        const auto len = std::sqrt(dx*dx + dy*dy);
+        const Vector2 o {pts[i].x + dx * 0.5f, pts[i].y + dy * 0.5f + 5.0f};
+        expectSameRay(profile, poly, o, {dx / len, dy / len}, maxDist);
+        expectSameRay(profile, poly, o, {-dx / len, -dy / len}, maxDist);
+    }
+    // Along the flat ends
+    expectSameRay(profile, poly, {pts[0].x - 200.0f, pts[0].y + 1.0f}, {1.0f, 0.0f}, maxDist);
+    expectSameRay(profile, poly, {pts[RS_SEGMENTS_N].x + 200.0f, pts[RS_SEGMENTS_N].y + 1.0f}, {-1.0f, 0.0f}, maxDist);
+
+    // Missing: up, level above everything, away from the terrain, or
+    // short of it
+    EXPECT_EQ(profile.CastRay({0.0f, 400.0f}, makeDir(PI * 0.5f), maxDist), maxDist);
+    EXPECT_EQ(profile.CastRay({0.0f, 400.0f}, {1.0f, 0.0f}, maxDist), maxDist);
+    EXPECT_EQ(profile.CastRay({0.0f, 400.0f}, {-1.0f, 0.0f}, maxDist), maxDist);
+    EXPECT_EQ(profile.CastRay({0.0f, 400.0f}, makeDir(PI * 1.4f), 10.0f), 10.0f);
+    EXPECT_EQ(profile.CastRay({pts[0].x - 200.0f, pts[0].y + 1.0f}, {-1.0f, 0.0f}, maxDist), maxDist);
+
+    // Hitting exactly at maxDist, and just beyond it
+    for (const auto angle : {PI * 1.2f, PI * 1.5f, PI * 1.9f})
+    {
+        const Vector2 o {10.0f, 350.0f};
+        const auto d = makeDir(angle);
+        const auto hitDist = (float)poly.CastRay(o, d, 1e6);
+        EXPECT_NEAR(profile.CastRay(o, d, hitDist), hitDist, 1e-3 * (1 + hitDist));
+        EXPECT_EQ(profile.CastRay(o, d, hitDist * 0.99f), hitDist * 0.99f);
+        EXPECT_NEAR(profile.CastRay(o, d, hitDist * 1.01f), hitDist, 1e-3 * (1 + hitDist));
+    }
+}
+
+// The sensors of a lander, over the terrain and the pad of scenarios
+TEST(RaySensorsTest, sensorsMatchBruteForce)
+{
+    constexpr int RAYS_N = 7;
+    using Sensors = SimRaySensors<RAYS_N>;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> xDist(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> yDist(0.0f, 600.0f);
+    for (uint64_t seed = 1; seed <= 20; ++seed)
+    {
+        const Simulation sim(SimParams{}, seed);
+        const auto& pad = sim.mLandingPad;
+        const RSPolyline poly(sim.mTerrain.mPoints);
+        const RSPolyline padLine({{pad.mPos.x - pad.mPadWidth/2, pad.mPos.y}, {pad.mPos.x + pad.mPadWidth/2, pad.mPos.y}});
+        for (int i=0; i < 100; ++i)
+        {
+            const Vector2 pos {xDist(rng), yDist(rng)};
+            float dists[RAYS_N];
+            Sensors::CalcDistances(sim.mTerrain.mProfile, pad.mPos, pad.mPadWidth, pos, dists);
+            for (int r=0; r < RAYS_N; ++r)
+            {
+                const auto& d = Sensors::DIRS[r];
+                auto expected = poly.CastRay(pos, d, Sensors::MAX_DIST);
+                if (pos.y > pad.mPos.y)
+                    expected = std::min(expected, padLine.CastRay(pos, d, Sensors::MAX_DIST));
+                EXPECT_NEAR(dists[r], expected, 1e-3 * (1 + expected)) << "seed " << seed << " ray " << r;
+            }
+        }
+    }
+}
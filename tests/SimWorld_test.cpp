@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include "FixedBrain.h"
+#include "SimWorld.h"
+#include "SimpleNeuralNet.h"
+
+//==================================================================
+static constexpr std::array<int, 4> SW_NET_ARCH {SIM_BRAINSTATE_N, 12, 12, SIM_BRAINACTION_N};
+
+using SWBrainState = Eigen::Vector<float, SIM_BRAINSTATE_N>;
+using SWBrainActions = Eigen::Vector<float, SIM_BRAINACTION_N>;
+
+// One lander and one pad: the same run as a Simulation, step by step
+static void expectSameAsSimulation(uint64_t seed, const auto& brain)
+{
+    Simulation sim(SimParams{}, seed);
+    SimWorld world(SimParams{}, seed, 1, 1);
+    ASSERT_EQ(world.mLandingPads[0].mPos.x, sim.mLandingPad.mPos.x);
+    ASSERT_EQ(world.mLanders[0].mPos.x, sim.mLander.mPos.x);
+    ASSERT_EQ(world.mLanders[0].mPos.y, sim.mLander.mPos.y);
+
+    while (!sim.IsSimulationComplete() && sim.GetElapsedTimeS() < Simulation::MAX_TIME_S)
+    {
+        ASSERT_FALSE(world.IsWorldComplete());
+        sim.AnimateSim([&](const SWBrainState& in, SWBrainActions& out) { brain(in, out); });
+        world.AnimateWorld([&](size_t, const SWBrainState& in, SWBrainActions& out) { brain(in, out); });
+
+        const auto& lander = world.mLanders[0];
+        ASSERT_EQ(lander.mPos.x, sim.mLander.mPos.x) << "seed " << seed << " time " << sim.GetElapsedTimeS();
+        ASSERT_EQ(lander.mPos.y, sim.mLander.mPos.y) << "seed " << seed << " time " << sim.GetElapsedTimeS();
+        ASSERT_EQ(lander.mFuel, sim.mLander.mFuel) << "seed " << seed << " time " << sim.GetElapsedTimeS();
+    }
+    EXPECT_TRUE(world.IsWorldComplete());
+    EXPECT_EQ(world.mLanders[0].mStateIsLanded, sim.mLander.mStateIsLanded);
+    EXPECT_EQ(world.mLanders[0].mStateIsCrashed, sim.mLander.mStateIsCrashed);
+    EXPECT_EQ(world.CalculateScore(0), sim.CalculateScore());
+}
+
+//==================================================================
+TEST(SimWorldTest, singleLanderMatchesSimulation)
+{
+    SimpleNeuralNet<float, SW_NET_ARCH> net;
+    net.InitializeRandomParameters(1234);
+    for (uint64_t seed = 1; seed <= 20; ++seed)
+    {
+        expectSameAsSimulation(seed, [](const SWBrainState& in, SWBrainActions& out) { GetFixedBrainActions(in, out); });
+        expectSameAsSimulation(seed, [&](const SWBrainState& in, SWBrainActions& out) { net.FeedForward(in, out); });
+    }
+}
+
+// Two landers flying into each other both crash, a third one is spared
+TEST(SimWorldTest, landersCollision)
+{
+    SimWorld world(SimParams{}, 1, 3, 1);
+    world.mLanders[0].mPos = {-100.0f, 400.0f};
+    world.mLanders[0].mVel = {3.0f, 0.0f};
+    world.mLanders[1].mPos = {100.0f, 400.0f};
+    world.mLanders[1].mVel = {-3.0f, 0.0f};
+    world.mLanders[2].mPos = {300.0f, 400.0f};
+    world.mLanders[2].mVel = {0.0f, 0.0f};
+
+    const auto noThrust = [](size_t, const SWBrainState&, SWBrainActions& out) { out.setZero(); };
+    size_t stepsN = 0;
+    while (!world.mLanders[0].mStateIsCrashed && stepsN < 100)
+    {
+        world.AnimateWorld(noThrust);
+        ++stepsN;
+    }
+    const auto& l0 = world.mLanders[0];
+    const auto& l1 = world.mLanders[1];
+    EXPECT_TRUE(l0.mStateIsCrashed);
+    EXPECT_TRUE(l1.mStateIsCrashed);
+    EXPECT_FALSE(world.mLanders[2].mStateIsCrashed);
+    // Crashed into each other, not into the terrain
+    EXPECT_LT(l1.mPos.x - l0.mPos.x, SimWorld::LANDER_RADIUS * 2);
+    EXPECT_GT(l0.mPos.y, world.mTerrain.mProfile.mMaxHeight);
+}
+
+// Start positions: above the terrain, on the screen and apart, for any
+// number of landers. The ones that don't fit are left out.
+TEST(SimWorldTest, startPositions)
+{
+    const SimParams sp;
+    for (const size_t landersN : {1, 19, 200, 300, 2000})
+    {
+        SimWorld world(sp, 1, landersN, 4);
+        const auto startedN = world.mLanders.size();
+        if (landersN <= 300)
+            EXPECT_EQ(startedN, landersN);
+        else
+            EXPECT_GE(startedN, 300u);
+
+        const auto terrainMaxY = world.mTerrain.mProfile.mMaxHeight;
+        for (const auto& lander : world.mLanders)
+        {
+            EXPECT_GT(lander.mPos.y - SimWorld::LANDER_RADIUS, terrainMaxY) << landersN << " landers";
+            EXPECT_LE(lander.mPos.y, sp.SCREEN_HEIGHT) << landersN << " landers";
+            EXPECT_LE(std::abs(lander.mPos.x), sp.SCREEN_WIDTH * 0.6f) << landersN << " landers";
+        }
+
+        const auto minDist = SimWorld::LANDER_RADIUS * 2;
+        for (size_t i=0; i < startedN; ++i)
+        {
+            for (size_t j=i + 1; j < startedN; ++j)
+            {
+                const auto dx = world.mLanders[i].mPos.x - world.mLanders[j].mPos.x;
+                const auto dy = world.mLanders[i].mPos.y - world.mLanders[j].mPos.y;
+                EXPECT_GE(dx*dx + dy*dy, minDist * minDist) << landersN << " landers, " << i << " and " << j;
+            }
+        }
+
+        // Nobody crashes on the first step
+        world.AnimateWorld([](size_t, const SWBrainState&, SWBrainActions& out) { out.setZero(); });
+        for (const auto& lander : world.mLanders)
+            EXPECT_FALSE(lander.mStateIsCrashed) << landersN << " landers";
+    }
+}
@@ -0,0 +1,108 @@
+#include <benchmark/benchmark.h>
+#include "SimpleNeuralNet.h"
+#include "SimRollout.h"
+#include "ScenarioBank.h"
+
+// Rollouts of one network over a set of scenarios, with:
+// - Simulation: the full simulation class
+// - SimRollout: the compact state, with run-time parameters
+// - SimRolloutFixed: the compact state, with compile-time parameters
+// and the cost of adding raycast sensors to the brain inputs
+
+static constexpr std::array<int, 4> BENCH_NET_ARCH {SIM_BRAINSTATE_N, 12, 12, SIM_BRAINACTION_N};
+using BenchNet = SimpleNeuralNet<float, BENCH_NET_ARCH>;
+
+static constexpr int BENCH_RAYS_N = 16;
+static constexpr std::array<int, 4> BENCH_RAYS_NET_ARCH {SIM_BRAINSTATE_N + BENCH_RAYS_N, 12, 12, SIM_BRAINACTION_N};
+using BenchRaysNet = SimpleNeuralNet<float, BENCH_RAYS_NET_ARCH>;
+
+static constexpr size_t BENCH_SCENARIOS_N = 30;
+
+struct SimulationBenchmark : public benchmark::Fixture
+{
+    SimParams         sp;
+    ScenarioBank      bank {sp, 1134, BENCH_SCENARIOS_N};
+    SimRolloutContext ctx {sp};
+    BenchNet          net;
+    BenchRaysNet      raysNet;
+
+    SimulationBenchmark()
+    {
+        net.InitializeRandomParameters(1234);
+        raysNet.InitializeRandomParameters(1234);
+    }
+
+    // Simple hovering rule, so that the physics dominates the cost
+    static void ruleBrain(const BenchNet::Inputs& states, BenchNet::Outputs& actions)
+    {
+        actions[SIM_BRAINACTION_UP] = states[SIM_BRAINSTATE_LANDER_VY] < -1.0f ? 1.0f : 0.0f;
+        actions[SIM_BRAINACTION_LEFT] = states[SIM_BRAINSTATE_LANDER_X] > states[SIM_BRAINSTATE_PAD_X] ? 1.0f : 0.0f;
+        actions[SIM_BRAINACTION_RIGHT] = states[SIM_BRAINSTATE_LANDER_X] < states[SIM_BRAINSTATE_PAD_X] ? 1.0f : 0.0f;
+    }
+
+    template<typename RolloutT, int RAYS_N = 0, typename BrainFn>
+    double runRollouts(const BrainFn& brain, size_t& stepsN) const
+    {
+        double scoreSum = 0;
+        for (size_t i = 0; i < bank.GetSize(); ++i)
+        {
+            RolloutT sim(ctx, bank.GetScenario(i));
+            while (!sim.IsSimulationComplete() && !sim.IsTimeOut())
+            {
+                sim.template AnimateSim<RAYS_N>(brain);
+                ++stepsN;
+            }
+            scoreSum += sim.CalculateScore();
+        }
+        return scoreSum;
+    }
+
+    template<typename BrainFn>
+    double runSimulations(const BrainFn& brain, size_t& stepsN) const
+    {
+        double scoreSum = 0;
+        for (size_t i = 0; i < bank.GetSize(); ++i)
+        {
+            Simulation sim(sp, bank.GetScenario(i));
+            while (!sim.IsSimulationComplete() && sim.GetElapsedTimeS() < Simulation::MAX_TIME_S)
+            {
+                sim.AnimateSim(brain);
+                ++stepsN;
+            }
+            scoreSum += sim.CalculateScore();
+        }
+        return scoreSum;
+    }
+
+    auto netBrain() const
+    {
+        return [this](const BenchNet::Inputs& states, BenchNet::Outputs& actions) {
+            net.FeedForward(states, actions);
+        };
+    }
+
+    auto raysNetBrain() const
+    {
+        return [this](const BenchRaysNet::Inputs& states, BenchRaysNet::Outputs& actions) {
+            raysNet.FeedForward(states, actions);
+        };
+    }
+};
+
+#define SIM_BENCHMARK(NAME, RUN_EXPR) \
+    BENCHMARK_F(SimulationBenchmark, NAME)(benchmark::State& st) { \
+        size_t stepsN = 0; \
+        for (auto _ : st) \
+            benchmark::DoNotOptimize(RUN_EXPR); \
+        st.counters["steps"] = benchmark::Counter((double)stepsN, benchmark::Counter::kIsRate); \
+    }
+
+SIM_BENCHMARK(RuleSimulation,      runSimulations(ruleBrain, stepsN))
+SIM_BENCHMARK(RuleSimRollout,      runRollouts<SimRollout>(ruleBrain, stepsN))
+SIM_BENCHMARK(RuleSimRolloutFixed, runRollouts<SimRolloutFixed<SimParams{}>>(ruleBrain, stepsN))
+
+SIM_BENCHMARK(NetSimulation,       runSimulations(netBrain(), stepsN))
+SIM_BENCHMARK(NetSimRollout,       runRollouts<SimRollout>(netBrain(), stepsN))
+SIM_BENCHMARK(NetSimRolloutFixed,  runRollouts<SimRolloutFixed<SimParams{}>>(netBrain(), stepsN))
+
+SIM_BENCHMARK(NetRaysSimRolloutFixed, (runRollouts<SimRolloutFixed<SimParams{}>, BENCH_RAYS_N>(raysNetBrain(), stepsN)))
@@ -0,0 +1,62 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <gtest/gtest.h>
+#include "TrainingTaskGA.h"
+#include "TrainingTaskRES.h"
+
+// Steady-state training iterations must not touch the heap: after a
+// few warm-up iterations, all the buffers should be in place.
+
+//==================================================================
+// Count of the heap allocations of the whole test program
+static std::atomic<size_t> gAllocationsN {0};
+
+void* operator new(size_t size)
+{
+    gAllocationsN += 1;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+//==================================================================
+static constexpr std::array<int, 4> ALLOCS_NET_ARCH {SIM_BRAINSTATE_N, 12, 12, SIM_BRAINACTION_N};
+static constexpr size_t WARMUP_ITERATIONS_N = 3;
+static constexpr size_t CHECKED_ITERATIONS_N = 5;
+
+template<typename TrainingTask>
+static size_t countIterationsAllocations(TrainingTask& task)
+{
+    for (size_t i = 0; i < WARMUP_ITERATIONS_N; ++i)
+        task.RunIteration();
+
+    const size_t startN = gAllocationsN;
+    for (size_t i = 0; i < CHECKED_ITERATIONS_N; ++i)
+        task.RunIteration();
+
+    return gAllocationsN - startN;
+}
+
+TEST(TrainingAllocsTest, GAIterations)
+{
+    SimRunOptions ro;
+    ro.EARLY_TERMINATION = true;
+    TrainingTaskGA<float, ALLOCS_NET_ARCH> task(SimParams{}, 100, 64, 0.1, 0.3, 1234, ro);
+    task.SetCoarseFidelity(4, 100); // Elites re-evaluation too
+
+    EXPECT_EQ(countIterationsAllocations(task), 0u);
+    EXPECT_TRUE(task.IsCoarsePhase());
+}
+
+TEST(TrainingAllocsTest, RESIterations)
+{
+    TrainingTaskRES<float, ALLOCS_NET_ARCH>::Params par;
+    par.maxGenerations = 100;
+    par.numPerturbations = 16;
+    TrainingTaskRES<float, ALLOCS_NET_ARCH> task(par, SimParams{});
+
+    EXPECT_EQ(countIterationsAllocations(task), 0u);
+}
@@ -5,6 +5,8 @@
 #include "dp1/SimpleNeuralNet.h"
 #include "dp2/SimpleNeuralNet.h"
 #include "tc1/TemplateFeedForward.hpp"
+#include "TinyGemv.h"
+#include <algorithm>
 #include <cstddef>
 #include <vector>
 
@@ -22,6 +24,14 @@ constexpr size_t CalcTotalParameters(auto architecture)
     return n;
 }
 
+constexpr size_t CalcLayerOffset(auto architecture, size_t layer)
+{
+    size_t n = 0;
+    for (size_t i = 1; i <= layer; ++i)
+        n += architecture[i - 1] * architecture[i] + architecture[i];
+    return n;
+}
+
 template<auto netArch>
 #ifdef BENCHMARK_FIXITURE
 class FeedForwardBenchmarck : public benchmark::Fixture
@@ -66,6 +76,7 @@ protected:
         setParams_tc1(params);
         setParams_dp2(params);
         setParams_cur(params);
+        setParams_kernel();
     }
 
     OutputArray FeedForward_dp1()
@@ -96,6 +107,27 @@ protected:
         return outputs;
     }
 
+    // All the layers with the same kernel (see TinyGemv.h)
+    template<template<typename, int, int> class Kernel>
+    OutputArray FeedForward_kernel()
+    {
+        constexpr size_t LAYERS_N = netArch.size() - 1;
+        constexpr int MAX_LAYER_N = *std::max_element(netArch.begin(), netArch.end());
+        std::array<float, MAX_LAYER_N> buffs[2];
+        OutputArray output;
+        const float* pIn = m_dp1Inputs.data();
+        [&]<size_t... Ls>(std::index_sequence<Ls...>) {
+            ([&] {
+                float* pOut = Ls + 1 == LAYERS_N ? output.data() : buffs[Ls % 2].data();
+                Kernel<float, netArch[Ls], netArch[Ls + 1]>::Run(
+                    m_kernelParams.data() + CalcLayerOffset(netArch, Ls), pIn, pOut,
+                    [](const auto& x) { return x.max(0.0f); });
+                pIn = pOut;
+            }(), ...);
+        }(std::make_index_sequence<LAYERS_N>{});
+        return output;
+    }
+
 private:
     void setInputs_dp1(const InputArray& inputs)
     {
@@ -154,6 +186,11 @@ private:
         m_curNet.foreachParameters([&](int, int, int, float& param) { param = params[paramIdx++]; });
     }
 
+    void setParams_kernel()
+    {
+        m_curNet.CopyParametersTo(m_kernelParams.data());
+    }
+
 private:
     dp1::SimpleNeuralNet m_dp1Net = std::vector<int>(netArch.begin(), netArch.end());
     InputArray m_dp1Inputs;
@@ -167,6 +204,8 @@ private:
 
     ::SimpleNeuralNet<float, netArch> m_curNet;
     ::SimpleNeuralNet<float, netArch>::Inputs m_curInputs;
+
+    alignas(64) ParamArray m_kernelParams; // Flat, as in SimpleNeuralNet
 };
 
 #endif // FIXITURES_H
@@ -0,0 +1,27 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Checkpoint.h"
+
+// Writes the network file of the controller generated for the tests and
+// benchmarks (see NetCodeGen)
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        printf("Usage: make_test_network <network file>\n");
+        return 1;
+    }
+
+    static constexpr std::array<int, 4> NET_ARCH {10, 12, 12, 3};
+    SimpleNeuralNet<float, NET_ARCH> net;
+    // All the parameters random, biases included (they start at zero
+    // with InitializeRandomParameters), so that misplaced ones show
+    std::vector<float> params(net.CalcTotalParameters());
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> dist(0.0f, 0.5f);
+    for (auto& p : params)
+        p = dist(rng);
+    net.SetParametersFrom(params.data());
+    return Checkpoint::SaveNetworkToFile(argv[1], net) ? 0 : 1;
+}